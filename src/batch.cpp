@@ -0,0 +1,271 @@
+/** \file
+ * \brief Runs whole games between computer players, many at once
+ *
+ * This is its own programme, 'mewl-batch', linked against the game logic but
+ * no user interface. Every seat is a computer player, so a game runs straight
+ * through from the colony ship landing to the final scoreboard as fast as the
+ * logic can go, with no display and no controllers. Games are spread across
+ * threads by a WorkPool, and each one's result is written as a row of CSV,
+ * in order of game number, as soon as it and every game before it have
+ * finished; so the output is the same however many threads there are, and
+ * large runs can still be analysed (or abandoned) part way through.
+ *
+ * Every game gets its own Random stream, seeded from the base seed and its
+ * number, so the same seed and options always give the same games, however
+ * many threads played them and in whatever order. Searching computer players
+ * are held to a number of playouts, rather than a time, for the same reason,
+ * and search on the thread playing their game. */
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include "game.hpp"
+#include "gamelogic.hpp"
+#include "planner.hpp"
+#include "platform.hpp"
+#include "workpool.hpp"
+
+/// Gives up on a game that hasn't ended after this many ticks, as a bug
+static const uint32_t max_ticks = 1000000;
+
+static const char* const rating_names[] = { "none", "failfood",
+	"failenergy", "lowfood", "lowenergy", "lowboth", "lowore",
+	"endrealbad", "endbad", "endsurvive", "endok", "endgood",
+	"endrealgood", "endawesome" };
+static const char* const difficulty_names[] =
+	{ "beginner", "standard", "tournament" };
+
+struct BatchOptions {
+	int games;
+	int threads;
+	int difficulty; ///< -1 to take turns with each
+	bool mixed; ///< Random species, rather than all Mechtrons
+	PlayerSetup::Strategy strategies[PLAYERS];
+	uint32_t playouts; ///< Per search
+	uint64_t seed;
+};
+
+/// Over every game, for the summary
+struct BatchTotals {
+	uint64_t playouts;
+	double seconds;
+};
+
+/** Play one game to the end, returning its row of output. */
+static std::string play(const BatchOptions& options, int index,
+	BatchTotals& totals) {
+
+	const uint64_t seed = options.seed + index;
+	Random rng(seed);
+	GameSetup setup;
+	setup.difficulty = static_cast<Difficulty::Type>(
+		options.difficulty >= 0 ? options.difficulty
+		: index % (Difficulty::LAST + 1));
+	for(int p = 0; p < PLAYERS; p++) {
+		setup.playersetup[p].computerPlayer();
+		setup.playersetup[p].strategy = options.strategies[p];
+		setup.playersetup[p].species = options.mixed
+			? static_cast<Species::Type>(rng.uniform(
+				Species::FIRST, Species::LAST))
+			: Species::COMPUTER;
+	}
+
+	Game* game = new Game(setup, rng.next());
+	GameStageState state;
+	Planner planner(0, 0, options.playouts, NULL);
+	GameLogicJumps jumps(&game, NULL, NULL, &planner);
+	GameLogic* logic = GameLogic::getNewGameState(&jumps, state);
+	uint32_t ticks;
+	for(ticks = 0; !jumps.isFinished() && ticks < max_ticks; ticks++) {
+		GameLogic* next = logic->simulate(setup, game);
+		if(next) { delete logic; logic = next; }
+	}
+	delete logic;
+	if(!jumps.isFinished())
+		{ warn("Game %d (seed %llu) never finished", index,
+			(unsigned long long) seed); }
+
+	// The final scoreboard's state is still there to be read
+	char row[256];
+	int len = snprintf(row, sizeof(row), "%d,%llu,%s,", index,
+		(unsigned long long) seed, difficulty_names[setup.difficulty]);
+	for(int p = 0; p < PLAYERS; p++) {
+		len += snprintf(row + len, sizeof(row) - len, "%d,",
+			setup.playersetup[p].species);
+	}
+	for(int p = 0; p < PLAYERS; p++) {
+		len += snprintf(row + len, sizeof(row) - len, "%s,",
+			setup.playersetup[p].strategy == PlayerSetup::SEARCH
+			? "search" : "rules");
+	}
+	len += snprintf(row + len, sizeof(row) - len, "%d,%s,", game->month,
+		jumps.isFinished()
+		? rating_names[state.scoreboard.message] : "unfinished");
+	uint32_t colony = 0;
+	for(int p = 0; p < PLAYERS; p++) {
+		uint32_t score = game->players[p].money
+			+ state.scoreboard.landvalue[p]
+			+ state.scoreboard.goodsvalue[p];
+		colony += score;
+		len += snprintf(row + len, sizeof(row) - len, "%u,", score);
+	}
+	snprintf(row + len, sizeof(row) - len, "%u\n", colony);
+	delete game;
+	totals.playouts = planner.getPlayouts();
+	totals.seconds = planner.getSeconds();
+	return row;
+}
+
+int main(int argc, char** argv) {
+	const char* outfile = NULL;
+	BatchOptions options;
+	options.games = 1000;
+	options.threads = 0;
+	options.difficulty = -1;
+	options.mixed = true;
+	for(int p = 0; p < PLAYERS; p++)
+		{ options.strategies[p] = PlayerSetup::RULES; }
+	options.playouts = 64;
+	options.seed = 0;
+	bool seeded = false;
+	for(int a = 1; a < argc; a++) {
+		const char* arg = argv[a];
+		if(!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+			puts("Usage: mewl-batch [-n GAMES] [-j THREADS] "
+				"[-d DIFFICULTY] [-s SEED] [-m MIX] "
+				"[-a AIS] [-p PLAYOUTS] [-o FILE]\n");
+			puts("  -n --games      : how many to play "
+				"(default 1000)");
+			puts("  -j --threads    : how many at once "
+				"(default one per processor)");
+			puts("  -d --difficulty : beginner, standard, "
+				"tournament, or all (default; in turn)");
+			puts("  -s --seed       : base seed; game N uses "
+				"SEED+N (default random)");
+			puts("  -m --mix        : species, 'random' (default) "
+				"or 'computer' for all Mechtrons");
+			puts("  -a --ai         : each seat's strategy, 'r' "
+				"for rules or 's' for search");
+			puts("                    (default rrrr)");
+			puts("  -p --playouts   : per search decision "
+				"(default 64)");
+			puts("  -o --output     : write one row per game, in "
+				"order, to FILE as CSV");
+			puts("                    (default stdout)");
+			return 0;
+		} else if(a + 1 >= argc) {
+			warn("Unknown or incomplete option %s", arg);
+			return EXIT_FAILURE;
+		} else if(!strcmp(arg, "-n") || !strcmp(arg, "--games")) {
+			options.games = atoi(argv[++a]);
+		} else if(!strcmp(arg, "-j") || !strcmp(arg, "--threads")) {
+			options.threads = atoi(argv[++a]);
+		} else if(!strcmp(arg, "-d") || !strcmp(arg, "--difficulty")) {
+			const char* name = argv[++a];
+			options.difficulty = -2;
+			if(!strcmp(name, "all")) { options.difficulty = -1; }
+			for(int d = Difficulty::FIRST; d <= Difficulty::LAST;
+				d++) {
+
+				if(!strcmp(name, difficulty_names[d]))
+					{ options.difficulty = d; }
+			}
+			if(options.difficulty == -2) {
+				warn("Unknown difficulty %s", name);
+				return EXIT_FAILURE;
+			}
+		} else if(!strcmp(arg, "-s") || !strcmp(arg, "--seed")) {
+			options.seed = strtoull(argv[++a], NULL, 0);
+			seeded = true;
+		} else if(!strcmp(arg, "-m") || !strcmp(arg, "--mix")) {
+			const char* mix = argv[++a];
+			if(!strcmp(mix, "random")) { options.mixed = true; }
+			else if(!strcmp(mix, "computer"))
+				{ options.mixed = false; }
+			else {
+				warn("Unknown mix %s", mix);
+				return EXIT_FAILURE;
+			}
+		} else if(!strcmp(arg, "-a") || !strcmp(arg, "--ai")) {
+			const char* ais = argv[++a];
+			if(strspn(ais, "rs") != PLAYERS || ais[PLAYERS]) {
+				warn("Need %d of 'r' or 's', not %s", PLAYERS,
+					ais);
+				return EXIT_FAILURE;
+			}
+			for(int p = 0; p < PLAYERS; p++) {
+				options.strategies[p] = ais[p] == 's'
+					? PlayerSetup::SEARCH
+					: PlayerSetup::RULES;
+			}
+		} else if(!strcmp(arg, "-p") || !strcmp(arg, "--playouts")) {
+			options.playouts = atoi(argv[++a]);
+			if(!options.playouts) {
+				warn("Need at least one playout");
+				return EXIT_FAILURE;
+			}
+		} else if(!strcmp(arg, "-o") || !strcmp(arg, "--output")) {
+			outfile = argv[++a];
+		} else {
+			warn("Unknown option %s", arg);
+			return EXIT_FAILURE;
+		}
+	}
+
+	platform_init();
+	// Only for the threads; there is no video, audio or input
+	if(SDL_Init(0) < 0)
+		{ warn("Unable to initialise SDL: %s", SDL_GetError()); die(); }
+	if(!seeded) { options.seed = random_seed(); }
+	FILE* out = outfile ? fopen(outfile, "w") : stdout;
+	if(!out) { warn("Unable to write %s", outfile); die(); }
+	fputs("game,seed,difficulty,species0,species1,species2,species3,"
+		"ai0,ai1,ai2,ai3,months,rating,score0,score1,score2,score3,"
+		"colony\n", out);
+
+	SDL_mutex* lock = SDL_CreateMutex();
+	if(!lock) { warn("Unable to create lock: %s", SDL_GetError()); die(); }
+	WorkPool pool(options.threads);
+	BatchTotals totals = { 0, 0 };
+	// Rows finished out of turn wait here for the ones before them
+	std::vector<std::string> rows(options.games > 0 ? options.games : 0);
+	int written = 0;
+	uint64_t start = platform_microseconds();
+	pool.run(options.games, [&](int index, int worker) {
+		BatchTotals game;
+		std::string row = play(options, index, game);
+		SDL_LockMutex(lock);
+		rows[index].swap(row);
+		for(; written < options.games && !rows[written].empty();
+			written++) {
+			fputs(rows[written].c_str(), out);
+			std::string().swap(rows[written]);
+		}
+		totals.playouts += game.playouts;
+		totals.seconds += game.seconds;
+		SDL_UnlockMutex(lock);
+	});
+	double seconds = (platform_microseconds() - start) / 1e6;
+	SDL_DestroyMutex(lock);
+
+	int status = EXIT_SUCCESS;
+	if(out != stdout && fclose(out) != 0) {
+		warn("Unable to finish writing %s", outfile);
+		status = EXIT_FAILURE;
+	}
+	warn("%d games on %d threads in %.2fs (%.0f games/s); base seed %llu",
+		options.games, pool.size(), seconds,
+		seconds > 0 ? options.games / seconds : 0,
+		(unsigned long long) options.seed);
+	if(totals.playouts) {
+		warn("%llu playouts (%.0f/s per thread)",
+			(unsigned long long) totals.playouts,
+			totals.seconds > 0 ? totals.playouts / totals.seconds
+			: 0);
+	}
+	SDL_Quit();
+	return status;
+}
+
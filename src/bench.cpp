@@ -0,0 +1,457 @@
+/** \file
+ * \brief Microbenchmarks for the simulation and rendering hot paths
+ *
+ * This is its own programme, linked against everything except main.cpp; see
+ * 'make bench'. It runs under SDL's dummy video and audio drivers, so needs no
+ * display, but does need to be run from the top of the tree to find data/.
+ *
+ * Each benchmark is run in batches, growing the batch until it takes long
+ * enough to time, and the fastest batch is reported as nanoseconds per
+ * operation. The fastest, rather than the mean, because anything else the
+ * machine is doing only ever makes us slower. Results are written as CSV, and
+ * can be compared against a previous run's CSV to catch regressions. */
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include "computer.hpp"
+#include "factory.hpp"
+#include "game.hpp"
+#include "market.hpp"
+#include "platform.hpp"
+#include "playerevent.hpp"
+#include "production.hpp"
+#include "ui.hpp"
+#include "ui_sprite.hpp"
+#include "ui_sprite_pointer.hpp"
+#include "zobrist.hpp"
+
+struct BenchResult {
+	std::string name;
+	double nsperop;
+	uint64_t iterations; ///< In the fastest batch
+};
+
+static std::vector<BenchResult> results;
+static const char* filter = NULL;
+static const uint64_t batch_us = 10000; ///< Shortest batch worth timing
+static const int batches = 5;
+/* Somewhere for results to go so the optimiser can't throw the work away. */
+static volatile int sink;
+
+/** Run body() over and over, and record how long one call takes. */
+template <typename F> static void bench(const char* name, F body) {
+	if(filter && !strstr(name, filter)) { return; }
+	body(); // Warm up caches, and any lazy initialisation
+	uint64_t n = 1, elapsed = 0;
+	for(;;) { // Find a batch size that takes long enough to time
+		uint64_t start = platform_microseconds();
+		for(uint64_t i = 0; i < n; i++) { body(); }
+		elapsed = platform_microseconds() - start;
+		if(elapsed >= batch_us) { break; }
+		n *= 2;
+	}
+	uint64_t best = elapsed;
+	for(int b = 1; b < batches; b++) {
+		uint64_t start = platform_microseconds();
+		for(uint64_t i = 0; i < n; i++) { body(); }
+		elapsed = platform_microseconds() - start;
+		if(elapsed < best) { best = elapsed; }
+	}
+	BenchResult r = { name, (best * 1000.0) / n, n };
+	printf("%-32s %14.1f ns/op %10llu ops\n", name, r.nsperop,
+		(unsigned long long) n);
+	results.push_back(r);
+}
+
+/* Simulation ---------------------------------------------------------------*/
+
+static void bench_simulation() {
+	GameSetup setup;
+	setup.difficulty = Difficulty::STANDARD;
+
+	bench("Game::Game", [&]() {
+		Game game(setup);
+		sink += game.terrain.tile(0, 0).mountains();
+	});
+
+	/* A game part-way through, with most of the land taken and working, so
+	 * that the counting and events have something to chew on. */
+	Game game(setup);
+	for(uint8_t y = 0; y < game.terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < game.terrain.getSizeX(); x++) {
+			if(x == game.terrain.getCityX() && y ==
+				game.terrain.getCityY()) { continue; }
+			if(random_uniform(0, 3) == 0) { continue; }
+			game.terrain.setOwnership(x, y,
+				random_uniform(0, PLAYERS - 1),
+				static_cast<Resource::Type>(
+				random_uniform(Resource::NONE,
+				Resource::CRYSTAL)));
+		}
+	}
+
+	Stock all, mining;
+	all.food = all.energy = all.ore = all.crystal = all.workers = 1;
+	mining.ore = mining.crystal = 1;
+	bench("countTilesOfType", [&]() {
+		sink += countTilesOfType(game, -1, all);
+		sink += countTilesOfType(game, 2, mining);
+	});
+
+	bench("PlayerEvent::precondition", [&]() {
+		for(int e = PlayerEvent::MINIMUM; e <= PlayerEvent::MAXIMUM;
+			e++) { for(int p = 0; p < PLAYERS; p++) {
+			sink += PlayerEvent::precondition(
+				static_cast<PlayerEvent::Type>(e), p, game);
+		}}
+	});
+
+	bench("PlayerEvent::eligible/choose", [&]() {
+		for(int p = 0; p < PLAYERS; p++) {
+			PlayerEvent::Type event = PlayerEvent::CARE_PACKAGE;
+			PlayerEvent::choose(PlayerEvent::eligible(p, game),
+				game.rng, event);
+			sink += event;
+		}
+	});
+
+	bench("PlayerEvent::changes", [&]() {
+		for(int e = PlayerEvent::MINIMUM; e <= PlayerEvent::MAXIMUM;
+			e++) { for(int p = 0; p < PLAYERS; p++) {
+			int32_t money = 0;
+			uint16_t each = 0;
+			Stock s = PlayerEvent::changes(
+				static_cast<PlayerEvent::Type>(e), p, game,
+				&money, &each);
+			sink += s.food + money + each;
+		}}
+	});
+
+	/* A month's production, for the one game and for a batch in lockstep
+	 * (the batch's time is for all of them). */
+	Production::Grid<1> grid;
+	uint8_t produced[Production::PLOTS][1];
+	int16_t energy[PLAYERS][1];
+	Production::load(grid, 0, game, game.rng);
+	bench("Production::compute", [&]() {
+		Production::compute(grid, produced, energy);
+		sink += produced[0][0];
+	});
+	static Production::Grid<Production::LANES> grids;
+	static uint8_t batchproduced[Production::PLOTS][Production::LANES];
+	static int16_t batchenergy[PLAYERS][Production::LANES];
+	for(int l = 0; l < Production::LANES; l++)
+		{ Production::load(grids, l, game, game.rng); }
+	bench("Production::compute/batch", [&]() {
+		Production::compute(grids, batchproduced, batchenergy);
+		sink += batchproduced[0][0];
+	});
+
+	/* A whole auction between computers, two selling and two buying, as
+	 * looking ahead would play it out. */
+	GameSetup computers;
+	for(int p = 0; p < PLAYERS; p++)
+		{ computers.playersetup[p].computerPlayer(); }
+	GameStageState auction;
+	for(int p = 0; p < PLAYERS; p++) {
+		game.players[p].stock.food = 10;
+		auction.preauction.surplus[p] = p < 2 ? 8 : -6;
+		auction.auctiondeclare.buyer[p] = p >= 2;
+	}
+	Market::Book book;
+	Market::open(book, game, computers, auction, Resource::FOOD,
+		game.prices.food, game.prices.food + 35);
+	bench("Market::run", [&]() {
+		Market::Book copy = book;
+		sink += Market::run(copy, 100000);
+	});
+
+	/* The whole state's hash, as a lockstep peer checks it each tick. */
+	bench("Zobrist::hash", [&]() {
+		sink += Zobrist::hash(game, GameStage::AUCTION, auction);
+	});
+
+	/* What every plot still free would go for at a land auction, as a
+	 * computer would weigh up which to hope for. */
+	int32_t value[PLAYERS];
+	for(int p = 0; p < PLAYERS; p++) { value[p] = 0; }
+	Market::openLand(book, game, value, 160, 1000);
+	bench("Market::landOutcome/all plots", [&]() {
+		for(uint8_t y = 0; y < game.terrain.getSizeY(); y++) {
+			for(uint8_t x = 0; x < game.terrain.getSizeX(); x++) {
+				if(game.terrain.tile(x, y).owned())
+					{ continue; }
+				for(int p = 0; p < PLAYERS; p++) {
+					value[p] = Computer::valueLand(game, p,
+						x, y);
+				}
+				int32_t price;
+				sink += Market::landOutcome(book, value, price);
+				sink += price;
+			}
+		}
+	});
+
+	bench("random_uniform", []() { sink += random_uniform(0, 99); });
+	bench("random_normal", []() { sink += random_normal(-50, 50, 20); });
+}
+
+/* Rendering ----------------------------------------------------------------*/
+
+static SDL_Surface* load_texture(const char* file) {
+	SDL_Surface* s = IMG_Load(file);
+	if(!s) { warn("Unable to load %s: %s", file, IMG_GetError()); die(); }
+	return s;
+}
+
+/** The resource-level drawing primitives, with just enough of the resources
+ *  set up by hand to drive them, on an off-screen target like the screen (so
+ *  that present() only forgets what was drawn). */
+static void bench_rendering() {
+	if(SDL_InitSubSystem(SDL_INIT_VIDEO) < 0
+		|| !SDL_SetVideoMode(640, 480, 0, 0)) {
+		warn("Unable to set video mode: %s", SDL_GetError());
+		die();
+	}
+	if(TTF_Init() < 0) {
+		warn("Unable to initialise TTF: %s", TTF_GetError());
+		die();
+	}
+
+	UserInterfaceSpriteResources resources;
+	resources.ttflock = SDL_CreateMutex();
+	resources.font_small = TTF_OpenFont("data/mainfont.ttf", 16);
+	if(!resources.ttflock || !resources.font_small)
+		{ warn("Unable to load font: %s", TTF_GetError()); die(); }
+	SDL_Surface* centre    = load_texture("data/pointer-centre.png");
+	SDL_Surface* north     = load_texture("data/pointer-north.png");
+	SDL_Surface* northeast = load_texture("data/pointer-northeast.png");
+	UserInterfaceSpriteTarget* target =
+		UserInterfaceSpriteTarget::offscreen(640, 480,
+		SDL_GetVideoSurface()->format);
+	if(!target) { die(); }
+	using namespace UserInterfaceSpriteConstants;
+
+	// One recolour of each of the three, and six rotations
+	bench("UserInterfaceSpritePointer", [&]() {
+		UserInterfaceSpritePointer pointer(col_player[0], centre, north,
+			northeast);
+	});
+
+	bench("renderText", [&]() {
+		SDL_Surface* s = resources.renderText(resources.font_small,
+			"Press a button to join the game", col_text_white);
+		SDL_FreeSurface(s);
+	});
+
+	bench("displayTextLine", [&]() {
+		resources.displayTextLine(*target, resources.font_small,
+			"Press a button to join the game", col_text_white,
+			black, 384);
+		target->present();
+	});
+
+	const size_t counts[] = { 4, 16, 64 };
+	for(size_t c = 0; c < sizeof(counts) / sizeof(*counts); c++) {
+		std::vector<UserInterfaceSpriteSprite*> sprites;
+		for(size_t i = 0; i < counts[c]; i++) {
+			sprites.push_back(
+				new UserInterfaceSpriteSprite(centre));
+			sprites.back()->move(random_uniform(-16, 640),
+				random_uniform(-16, 480));
+		}
+		char name[32];
+		snprintf(name, sizeof name, "display+eraseSprites/%u",
+			(unsigned) counts[c]);
+		bench(name, [&]() {
+			resources.displaySprites(*target, sprites);
+			resources.eraseSprites(*target, sprites);
+			target->present();
+		});
+		for_each(sprites.begin(), sprites.end(), delete_functor());
+	}
+
+	// As the last, with a quarter-size copy kept up with what they change
+	UserInterfaceSpriteTarget* thumbnail =
+		UserInterfaceSpriteTarget::thumbnail(*target, 4);
+	if(!thumbnail) { die(); }
+	std::vector<UserInterfaceSpriteSprite*> sprites;
+	for(size_t i = 0; i < 16; i++) {
+		sprites.push_back(new UserInterfaceSpriteSprite(centre));
+		sprites.back()->move(random_uniform(-16, 640),
+			random_uniform(-16, 480));
+	}
+	bench("display+eraseSprites+follow/16", [&]() {
+		resources.displaySprites(*target, sprites);
+		resources.eraseSprites(*target, sprites);
+		thumbnail->follow(*target);
+		thumbnail->present();
+		target->present();
+	});
+	for_each(sprites.begin(), sprites.end(), delete_functor());
+	delete thumbnail;
+
+	delete target;
+	SDL_FreeSurface(centre);
+	SDL_FreeSurface(north);
+	SDL_FreeSurface(northeast);
+	TTF_CloseFont(resources.font_small);
+	SDL_DestroyMutex(resources.ttflock);
+	TTF_Quit();
+	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
+
+/** Drive the real user interface through every stage, for a few frames each,
+ *  as main would; one operation is one whole pass. Computer seats all round,
+ *  as they need no controllers. */
+static void bench_stages() {
+	const int frames = 10;
+	UserInterface* userintf =
+		FACTORY_FOR(UserInterface).create("UserInterface" USERINTF);
+	if(!userintf || !userintf->init(false)) {
+		warn("Unable to initialise user interface");
+		die();
+	}
+	GameSetup setup;
+	GameStageState state;
+	Game game(setup);
+	state.species.defined = true;
+
+	bench("stage sequence", [&]() {
+		for(int s = GameStage::FIRST; s <= GameStage::LAST; s++) {
+			GameStage::Type stage =
+				static_cast<GameStage::Type>(s);
+			if(s < GameStage::LAST) { userintf->anticipate(
+				GameStage::mask(static_cast<GameStage::Type>(
+				s + 1))); }
+			for(int f = 0; f < frames; f++) {
+				state.species.player = f % PLAYERS;
+				userintf->render(stage, setup,
+					s > GameStage::SPECIES ? &game : NULL,
+					state, 1);
+			}
+		}
+	});
+
+	delete userintf;
+}
+
+/* Baselines ----------------------------------------------------------------*/
+
+static bool write_results(const char* filename) {
+	FILE* out = fopen(filename, "w");
+	if(!out) {
+		warn("Unable to write results to %s", filename);
+		return false;
+	}
+	fputs("benchmark,ns_per_op,iterations\n", out);
+	for(std::vector<BenchResult>::const_iterator r = results.begin();
+		r != results.end(); ++r) {
+		fprintf(out, "%s,%.1f,%llu\n", r->name.c_str(), r->nsperop,
+			(unsigned long long) r->iterations);
+	}
+	fclose(out);
+	return true;
+}
+
+/** Compare against a CSV written by a previous run. Returns the number of
+ *  benchmarks which got slower by more than the tolerance (a percentage). */
+static int compare_results(const char* filename, double tolerance) {
+	FILE* in = fopen(filename, "r");
+	if(!in) {
+		warn("Unable to read baseline %s", filename);
+		return -1;
+	}
+	std::vector<BenchResult> baseline;
+	char line[256];
+	while(fgets(line, sizeof line, in)) {
+		char* comma = strchr(line, ',');
+		if(!comma) { continue; }
+		*comma = '\0';
+		BenchResult r = { line, atof(comma + 1), 0 };
+		if(r.nsperop > 0) { baseline.push_back(r); } // skips header
+	}
+	fclose(in);
+
+	int regressions = 0;
+	printf("\nAgainst %s (tolerance %.0f%%):\n", filename, tolerance);
+	for(std::vector<BenchResult>::const_iterator r = results.begin();
+		r != results.end(); ++r) {
+		std::vector<BenchResult>::const_iterator b;
+		for(b = baseline.begin(); b != baseline.end(); ++b)
+			{ if(b->name == r->name) { break; } }
+		if(b == baseline.end()) {
+			printf("%-32s %14s\n", r->name.c_str(), "new");
+			continue;
+		}
+		double change = ((r->nsperop / b->nsperop) - 1) * 100;
+		bool worse = change > tolerance;
+		printf("%-32s %+13.1f%%%s\n", r->name.c_str(), change,
+			worse ? "  REGRESSION" : "");
+		if(worse) { regressions++; }
+	}
+	return regressions;
+}
+
+int main(int argc, char** argv) {
+	const char* outfile = NULL;
+	const char* basefile = NULL;
+	double tolerance = 10;
+	for(int a = 1; a < argc; a++) {
+		const char* arg = argv[a];
+		if(!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+			puts("Usage: mewl-bench [-o FILE] [-b FILE] "
+				"[-r PERCENT] [-f NAME]\n");
+			puts("  -o --output    : write results to FILE as CSV");
+			puts("  -b --baseline  : compare with a CSV from an "
+				"earlier run; fail if slower");
+			puts("  -r --tolerance : how much slower counts as a "
+				"regression (default 10%)");
+			puts("  -f --filter    : only run benchmarks with NAME "
+				"in their name");
+			puts("\nRun from the top of the tree, so data/ can be "
+				"found.");
+			return 0;
+		} else if(a + 1 >= argc) {
+			warn("Unknown or incomplete option %s", arg);
+			return EXIT_FAILURE;
+		} else if(!strcmp(arg, "-o") || !strcmp(arg, "--output")) {
+			outfile = argv[++a];
+		} else if(!strcmp(arg, "-b") || !strcmp(arg, "--baseline")) {
+			basefile = argv[++a];
+		} else if(!strcmp(arg, "-r") || !strcmp(arg, "--tolerance")) {
+			tolerance = atof(argv[++a]);
+		} else if(!strcmp(arg, "-f") || !strcmp(arg, "--filter")) {
+			filter = argv[++a];
+		} else {
+			warn("Unknown option %s", arg);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Headless unless told otherwise
+	if(!getenv("SDL_VIDEODRIVER")) { SDL_putenv("SDL_VIDEODRIVER=dummy"); }
+	if(!getenv("SDL_AUDIODRIVER")) { SDL_putenv("SDL_AUDIODRIVER=dummy"); }
+	platform_init();
+	if(SDL_Init(0) < 0)
+		{ warn("Unable to initialise SDL: %s", SDL_GetError()); die(); }
+#ifdef IMG_INIT_PNG
+	IMG_Init(IMG_INIT_PNG);
+#endif
+
+	bench_simulation();
+	bench_rendering();
+	bench_stages();
+
+	int status = EXIT_SUCCESS;
+	if(outfile && !write_results(outfile)) { status = EXIT_FAILURE; }
+	if(basefile && compare_results(basefile, tolerance) != 0)
+		{ status = EXIT_FAILURE; }
+	SDL_Quit();
+	return status;
+}
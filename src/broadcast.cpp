@@ -0,0 +1,357 @@
+#include <type_traits>
+#include <string.h>
+#include "broadcast.hpp"
+#include "platform.hpp"
+#include "stagefields.hpp"
+
+/* A message is a header, then a body: a whole image for a keyframe, or for a
+ * delta, runs of changed bytes, each an offset, a length, and the bytes. */
+enum Kind { KEYFRAME = 1, DELTA = 2 };
+static const size_t HEADER_BYTES = 9; ///< Kind, tick, image size, body size
+static const size_t RUN_MAX = 255;
+/// Unchanged bytes worth sending to save a run header; a run's is three
+static const size_t RUN_GAP = 3;
+
+/** Bytes a field takes in an image: enums and flags are one. */
+template <typename T> static size_t width() {
+	return std::is_enum<T>::value || std::is_same<T, bool>::value
+		? 1 : sizeof(T);
+}
+
+/* Everything goes out little-endian, a byte at a time, whatever we are. */
+static void put(std::vector<uint8_t>& out, uint64_t value, size_t bytes) {
+	for(size_t i = 0; i < bytes; i++) { out.push_back(value >> (8 * i)); }
+}
+static uint64_t get(const uint8_t* in, size_t bytes) {
+	uint64_t value = 0;
+	for(size_t i = bytes; i > 0; i--) { value = (value << 8) | in[i - 1]; }
+	return value;
+}
+
+/* The Game's fields, but for the map, which is done tile by tile. */
+template <typename G, typename Visitor>
+static void walkGame(G& game, Visitor& visit) {
+	visit(game.difficulty);
+	visit(game.month);
+	visit(game.playerevents);
+	StageFields::each(game.turnorder, visit);
+	for(int p = 0; p < PLAYERS; p++) {
+		visit(game.players[p].money);
+		for(int r = Resource::NONE; r <= Resource::CRYSTAL; r++) {
+			visit(game.players[p].stock[
+				static_cast<Resource::Type>(r)]);
+		}
+	}
+	for(int r = Resource::NONE; r <= Resource::CRYSTAL; r++) {
+		visit(game.store[static_cast<Resource::Type>(r)]);
+		visit(game.prices[static_cast<Resource::Type>(r)]);
+	}
+}
+
+/** Writes the image of a tick. */
+class Writer {
+	std::vector<uint8_t>& out;
+public:
+	explicit Writer(std::vector<uint8_t>& out) : out(out) {}
+	template <typename T> void operator()(const T& value)
+		{ put(out, (uint64_t) value, width<T>()); }
+	void write(const GameSetup& setup, const Game* game,
+		GameStage::Type stage, const GameStageState& state);
+};
+
+void Writer::write(const GameSetup& setup, const Game* game,
+	GameStage::Type stage, const GameStageState& state) {
+
+	out.clear();
+	(*this)(setup.difficulty);
+	for(int p = 0; p < PLAYERS; p++) {
+		const PlayerSetup& player = setup.playersetup[p];
+		(*this)(player.computer);
+		(*this)(player.species);
+		(*this)(player.controller ? player.controller->getDirection()
+			: DIR_CENTRE);
+	}
+	(*this)(stage);
+	(*this)(game != NULL);
+	if(game) {
+		walkGame(*game, *this);
+		const Terrain& terrain = game->terrain;
+		for(uint8_t y = 0; y < terrain.getSizeY(); y++) {
+			for(uint8_t x = 0; x < terrain.getSizeX(); x++) {
+				const Tile& tile = terrain.tile(x, y);
+				(*this)(tile.mountains());
+				(*this)(tile.crystal());
+				(*this)((uint8_t) (tile.owned()
+					? 1 + tile.owner() : 0));
+				(*this)(tile.owned() ? tile.equipment()
+					: Resource::NONE);
+			}
+		}
+	}
+	StageFields::walk(stage, state, *this);
+}
+
+/** Reads a tick back from its image. If it runs out, what is left is left
+ *  alone, and it's no good. */
+class Reader {
+	const uint8_t* next;
+	const uint8_t* end;
+	bool good;
+public:
+	explicit Reader(const std::vector<uint8_t>& in) : next(in.data()),
+		end(in.data() + in.size()), good(true) {}
+	template <typename T> void operator()(T& value) {
+		if((size_t) (end - next) < width<T>()) { good = false; return; }
+		value = static_cast<T>(get(next, width<T>()));
+		next += width<T>();
+	}
+	template <typename T> T take() { T value = T(); (*this)(value);
+		return value; }
+	bool read(GameSetup& setup, Game*& game, GameStage::Type& stage,
+		GameStageState& state, RemoteController* seats[PLAYERS]);
+};
+
+bool Reader::read(GameSetup& setup, Game*& game, GameStage::Type& stage,
+	GameStageState& state, RemoteController* seats[PLAYERS]) {
+
+	(*this)(setup.difficulty);
+	for(int p = 0; p < PLAYERS; p++) {
+		PlayerSetup& player = setup.playersetup[p];
+		if(take<bool>()) { player.computerPlayer(); }
+		else { player.humanPlayer(seats[p]); }
+		(*this)(player.species);
+		const Direction direction = take<Direction>();
+		seats[p]->apply(direction < DIR_CENTRE ? direction : DIR_CENTRE,
+			false);
+	}
+	stage = take<GameStage::Type>();
+	if(stage > GameStage::LAST) { return false; }
+	if(take<bool>()) {
+		// Whatever the map it generates, it gets overwritten (but for
+		// the river, which is always the city's column)
+		if(!game) { game = new Game(setup, 0); }
+		walkGame(*game, *this);
+		for(int p = 0; p < PLAYERS; p++)
+			{ game->players[p].setup = setup.playersetup[p]; }
+		Terrain& terrain = game->terrain;
+		for(uint8_t y = 0; y < terrain.getSizeY(); y++) {
+			for(uint8_t x = 0; x < terrain.getSizeX(); x++) {
+				terrain.setMountains(x, y, take<uint8_t>());
+				terrain.setCrystal(x, y, take<uint8_t>());
+				const int owner = take<uint8_t>() - 1;
+				const Resource::Type equipment =
+					take<Resource::Type>();
+				if(owner < 0 || owner >= PLAYERS)
+					{ terrain.setUnowned(x, y); }
+				else { terrain.setOwnership(x, y, owner,
+					equipment); }
+			}
+		}
+	} else if(game) {
+		delete game;
+		game = NULL;
+	}
+	StageFields::walk(stage, state, *this);
+	return good && next == end;
+}
+
+Broadcast::Broadcast() : listener(-1), tick(0), sincekey(0),
+	joined(false) {}
+
+Broadcast::~Broadcast() {
+	for(size_t s = 0; s < subscribers.size(); s++)
+		{ platform_close(subscribers[s].socket); }
+	if(listener >= 0) { platform_close(listener); }
+}
+
+bool Broadcast::listen(uint16_t port) {
+	listener = platform_listen(port);
+	if(listener < 0) { return false; }
+	trace("Broadcasting on port %u", port);
+	return true;
+}
+
+void Broadcast::accept() {
+	while(platform_ready(listener, 0)) {
+		Subscriber subscriber;
+		subscriber.socket = platform_accept(listener);
+		if(subscriber.socket < 0) { return; }
+		subscribers.push_back(subscriber);
+		joined = true;
+		trace("A spectator joined; %d watching",
+			(int) subscribers.size());
+	}
+}
+
+void Broadcast::keyframe() {
+	message.clear();
+	put(message, KEYFRAME, 1);
+	put(message, tick, 4);
+	put(message, image.size(), 2);
+	put(message, image.size(), 2);
+	message.insert(message.end(), image.begin(), image.end());
+	sincekey = 0;
+	joined = false;
+}
+
+/* Runs of what changed; close runs are joined, as a few unchanged bytes cost
+ * less than another run's header. If the image has grown, what's new has all
+ * changed; if it has shrunk, the size in the header says so. */
+void Broadcast::delta() {
+	message.clear();
+	put(message, DELTA, 1);
+	put(message, tick, 4);
+	put(message, image.size(), 2);
+	put(message, 0, 2); // Body size, once known
+	size_t i = 0;
+	while(i < image.size()) {
+		if(i < last.size() && image[i] == last[i]) { i++; continue; }
+		size_t end = i + 1, same = 0;
+		while(end < image.size() && end - i < RUN_MAX) {
+			if(end < last.size() && image[end] == last[end]) {
+				if(++same > RUN_GAP) { same--; break; }
+			} else {
+				same = 0;
+			}
+			end++;
+		}
+		end -= same;
+		put(message, i, 2);
+		put(message, end - i, 1);
+		message.insert(message.end(), image.begin() + i,
+			image.begin() + end);
+		i = end;
+	}
+	const size_t body = message.size() - HEADER_BYTES;
+	message[7] = body; message[8] = body >> 8;
+}
+
+void Broadcast::flush(Subscriber& subscriber) {
+	if(subscriber.pending.empty()) { return; }
+	int sent = platform_offer(subscriber.socket, subscriber.pending.data(),
+		subscriber.pending.size());
+	if(sent > 0) { subscriber.pending.erase(subscriber.pending.begin(),
+		subscriber.pending.begin() + sent); }
+	else if(sent < 0) { subscriber.socket = -1; }
+}
+
+void Broadcast::send(const GameSetup& setup, const Game* game,
+	GameStage::Type stage, const GameStageState& state) {
+
+	if(listener < 0) { return; }
+	accept();
+	if(subscribers.empty()) { tick++; return; }
+	last.swap(image);
+	Writer(image).write(setup, game, stage, state);
+	if(joined || ++sincekey >= KEY_INTERVAL) { keyframe(); }
+	else {
+		delta();
+		// A big enough change (a new stage) is cheaper sent whole
+		if(message.size() >= HEADER_BYTES + image.size())
+			{ keyframe(); }
+	}
+	tick++;
+
+	// Everyone gets the same bytes, as far as they'll take them now
+	for(size_t s = 0; s < subscribers.size(); ) {
+		Subscriber& subscriber = subscribers[s];
+		subscriber.pending.insert(subscriber.pending.end(),
+			message.begin(), message.end());
+		flush(subscriber);
+		if(subscriber.socket < 0
+		|| subscriber.pending.size() > BACKLOG) {
+			if(subscriber.socket >= 0)
+				{ platform_close(subscriber.socket); }
+			subscribers.erase(subscribers.begin() + s);
+			trace("A spectator left; %d watching",
+				(int) subscribers.size());
+		} else {
+			s++;
+		}
+	}
+}
+
+Spectator::Spectator() : socket(-1), read(0), keyed(false),
+	stage(GameStage::TITLE), tick(0), gone(false) {
+
+	for(int p = 0; p < PLAYERS; p++) { seats[p] = new RemoteController(p); }
+}
+
+Spectator::~Spectator() {
+	if(socket >= 0) { platform_close(socket); }
+	for(int p = 0; p < PLAYERS; p++) { delete seats[p]; }
+}
+
+bool Spectator::connect(const char* host, uint16_t port) {
+	socket = platform_connect(host, port);
+	return socket >= 0;
+}
+
+bool Spectator::next(GameSetup& setup, Game*& game, GameStageState& state) {
+	if(gone) { return false; }
+	// Take in whatever has arrived, keeping what's not yet applied
+	if(read) {
+		received.erase(received.begin(), received.begin() + read);
+		read = 0;
+	}
+	uint8_t buffer[4096];
+	int got;
+	while((got = platform_receive(socket, buffer, sizeof(buffer), 0)) > 0)
+		{ received.insert(received.end(), buffer, buffer + got); }
+
+	// Apply the next message, if it has all arrived
+	for(;;) {
+		const uint8_t* header = received.data() + read;
+		const size_t body = received.size() - read < HEADER_BYTES ? 0
+			: get(header + 7, 2);
+		if(received.size() - read < HEADER_BYTES + body) {
+			// Nothing more will, once the game hangs up
+			if(got < 0) {
+				warn("The game being watched has ended");
+				gone = true;
+			}
+			return false;
+		}
+		const Kind kind = static_cast<Kind>(header[0]);
+		const size_t size = get(header + 5, 2);
+		const uint8_t* in = header + HEADER_BYTES;
+		const uint8_t* end = in + body;
+		read += HEADER_BYTES + body;
+		if(kind == KEYFRAME && body == size) {
+			image.assign(in, end);
+			keyed = true;
+		} else if(kind == DELTA && keyed) {
+			image.resize(size);
+			while(in < end) {
+				const size_t offset = get(in, 2), run = in[2];
+				in += 3;
+				if(run > (size_t) (end - in)
+				|| offset + run > image.size()) { break; }
+				memcpy(image.data() + offset, in, run);
+				in += run;
+			}
+			if(in != end) { break; }
+		} else if(kind == DELTA) {
+			continue; // Joined between keyframes; wait for one
+		} else {
+			break;
+		}
+		tick = get(header + 1, 4);
+		if(!decode(setup, game, state)) { break; }
+		return true;
+	}
+	warn("The game being watched sent nonsense");
+	gone = true;
+	return false;
+}
+
+bool Spectator::decode(GameSetup& setup, Game*& game,
+	GameStageState& state) {
+
+	return Reader(image).read(setup, game, stage, state, seats);
+}
+
+GameStage::Type Spectator::getStage() const { return stage; }
+
+bool Spectator::isGone() const { return gone; }
+
@@ -0,0 +1,95 @@
+#ifndef BROADCAST_HPP_
+#define BROADCAST_HPP_
+#include <stdint.h>
+#include <vector>
+#include "game.hpp"
+#include "gamesetup.hpp"
+#include "lockstep.hpp"
+
+/** \file
+ * \brief Streaming a game as it is played, to any number of spectators
+ *
+ * After each tick, the game is written out as an image: the setup, the Game
+ * (if there is one yet) and the fields of the stage's state that its stage
+ * uses (see StageFields). Each tick's message to spectators is then either
+ * that image whole (a keyframe) or just the runs of bytes in it which differ
+ * from the last tick's (a delta), which is usually a few bytes; a countdown,
+ * a moving cursor, a bid. The message is put together once and the same bytes
+ * queued for every spectator, so that they cost little more than one.
+ *
+ * Keyframes go out every few seconds, and on the tick after anyone joins, as
+ * a spectator can only start from one. Sending never waits: a spectator who
+ * falls so far behind that minutes of messages are waiting for them is
+ * dropped, rather than holding up the game.
+ *
+ * Spectators rebuild the setup, Game and state from each image, and render it
+ * with the same user interface as the game itself. The seats' controllers are
+ * RemoteControllers, which show where each human player is pushing. */
+
+/** The game's end: takes spectators, and sends them each tick. */
+class Broadcast {
+public:
+	static const uint16_t PORT = 5121;
+	static const ticks_t KEY_INTERVAL = 5 * SECOND; ///< At most
+	/// Queued for a spectator, at most
+	static const size_t BACKLOG = 256 * 1024;
+private:
+	struct Subscriber {
+		int socket;
+		std::vector<uint8_t> pending; ///< Not yet sent
+	};
+	int listener;
+	std::vector<Subscriber> subscribers;
+	std::vector<uint8_t> image;
+	std::vector<uint8_t> last; ///< Image, as of the last tick sent
+	std::vector<uint8_t> message;
+	uint32_t tick;
+	ticks_t sincekey; ///< Ticks since the last keyframe
+	bool joined; ///< Someone new, who needs a keyframe
+
+	void accept();
+	void keyframe();
+	void delta();
+	void flush(Subscriber& subscriber);
+	Broadcast(const Broadcast&);
+	Broadcast& operator=(const Broadcast&);
+public:
+	Broadcast();
+	~Broadcast();
+	/** Take spectators on the port. */
+	bool listen(uint16_t port);
+	/** Send the tick just simulated to everyone watching. */
+	void send(const GameSetup& setup, const Game* game,
+		GameStage::Type stage, const GameStageState& state);
+};
+
+/** A spectator's end: rebuilds the game from what is sent, tick by tick. */
+class Spectator {
+	int socket;
+	std::vector<uint8_t> received; ///< Not yet applied
+	size_t read; ///< Of received, as far as has been applied
+	std::vector<uint8_t> image;
+	bool keyed; ///< Had a keyframe, so deltas make sense
+	GameStage::Type stage;
+	uint32_t tick;
+	bool gone;
+	RemoteController* seats[PLAYERS];
+
+	bool decode(GameSetup& setup, Game*& game, GameStageState& state);
+	Spectator(const Spectator&);
+	Spectator& operator=(const Spectator&);
+public:
+	Spectator();
+	~Spectator();
+	bool connect(const char* host, uint16_t port);
+	/** If the next tick has arrived, bring the setup, game and state up to
+	 *  it, and return true. The game is created and deleted here as it
+	 *  comes and goes, as by the logic. */
+	bool next(GameSetup& setup, Game*& game, GameStageState& state);
+	GameStage::Type getStage() const;
+	/** Has the game hung up, or sent nonsense? (It has been warn()ed.) */
+	bool isGone() const;
+};
+
+#endif
+
@@ -0,0 +1,140 @@
+#include "computer.hpp"
+
+/* Value a use for a plot at the store's prices, but favour whatever the player
+ * has none of yet: a colony of ore mines starves in the dark. */
+static int32_t rate_outfit(const Game& game, int player, const Tile& tile,
+	Resource::Type resource) {
+
+	Stock type;
+	type[resource] = 1;
+	int32_t value = tileYield(tile, resource) * game.prices[resource];
+	if(resource == Resource::FOOD || resource == Resource::ENERGY) {
+		if(!countTilesOfType(game, player, type)) { value *= 2; }
+	}
+	return value;
+}
+
+/* What depends on the level is written once for each, with the level as a
+ * template parameter so its rules are constants, as these are run over every
+ * plot in every rollout the planner makes; the public functions pick out the
+ * one for the game's level. */
+template <Difficulty::Type D> struct ChooseOutfit {
+	static Resource::Type run(const Game& game, int player, uint8_t x,
+		uint8_t y) {
+
+		const Tile& tile = game.terrain.tile(x, y);
+		const Resource::Type last = Difficulty::hasCrystal(D)
+			? Resource::CRYSTAL : Resource::ORE;
+		Resource::Type best = Resource::FOOD;
+		int32_t bestvalue = -1;
+		for(int r = Resource::FOOD; r <= last; r++) {
+			Resource::Type resource =
+				static_cast<Resource::Type>(r);
+			int32_t value =
+				rate_outfit(game, player, tile, resource);
+			if(value > bestvalue)
+				{ best = resource; bestvalue = value; }
+		}
+		return best;
+	}
+};
+
+template <Difficulty::Type D> struct Outfit {
+	static bool run(Game& game, int player, uint8_t x, uint8_t y,
+		Resource::Type resource) {
+
+		Player& self = game.players[player];
+		const Tile& tile = game.terrain.tile(x, y);
+		const bool infinite = Difficulty::hasInfiniteWorkers(D);
+		if(!tile.owned() || tile.owner() != player
+		|| tile.equipment() != Resource::NONE) { return false; }
+		if(!infinite && game.store.workers <= 0) { return false; }
+		int32_t cost = game.prices.workers
+			+ Resource::getOutfitCost(resource);
+		if((int32_t) self.money < cost) { return false; }
+		self.money -= cost;
+		if(!infinite) { game.store.workers--; }
+		game.terrain.setOwnership(x, y, player, resource);
+		return true;
+	}
+};
+
+template <Difficulty::Type D> struct Develop {
+	static bool run(Game& game, int player, uint8_t& x, uint8_t& y) {
+		bool any = false;
+		const uint8_t width = game.terrain.getSizeX();
+		const uint8_t height = game.terrain.getSizeY();
+		for(uint8_t ty = 0; ty < height; ty++) {
+			for(uint8_t tx = 0; tx < width; tx++) {
+				const Tile& tile = game.terrain.tile(tx, ty);
+				if(!tile.owned() || tile.owner() != player
+				|| tile.equipment() != Resource::NONE)
+					{ continue; }
+				const Resource::Type resource =
+					ChooseOutfit<D>::run(game, player,
+					tx, ty);
+				if(Outfit<D>::run(game, player, tx, ty,
+					resource))
+					{ x = tx; y = ty; any = true; }
+			}
+		}
+		return any;
+	}
+};
+
+Resource::Type Computer::chooseOutfit(const Game& game, int player,
+	uint8_t x, uint8_t y) {
+
+	return Difficulty::specialise<ChooseOutfit>(game.difficulty, game,
+		player, x, y);
+}
+
+int32_t Computer::rateLand(const Game& game, int player, uint8_t x, uint8_t y)
+{
+	return rate_outfit(game, player, game.terrain.tile(x, y),
+		chooseOutfit(game, player, x, y));
+}
+
+/* Half the earnings, since prices and the weather will surely turn. */
+int32_t Computer::valueLand(const Game& game, int player, uint8_t x,
+	uint8_t y) {
+
+	const Resource::Type outfit = chooseOutfit(game, player, x, y);
+	const int32_t months =
+		Difficulty::getGameDuration(game.difficulty) - game.month;
+	const int32_t value = rateLand(game, player, x, y) * months / 2
+		- game.prices.workers - Resource::getOutfitCost(outfit);
+	return value > 0 ? value : 0;
+}
+
+bool Computer::chooseLand(const Game& game, int player,
+	uint8_t& x, uint8_t& y) {
+
+	int32_t best = -1;
+	for(uint8_t ty = 0; ty < game.terrain.getSizeY(); ty++) {
+		for(uint8_t tx = 0; tx < game.terrain.getSizeX(); tx++) {
+			if(tx == game.terrain.getCityX()
+			&& ty == game.terrain.getCityY()) { continue; }
+			if(game.terrain.tile(tx, ty).owned()) { continue; }
+			int32_t rating = rateLand(game, player, tx, ty);
+			if(rating > best) { best = rating; x = tx; y = ty; }
+		}
+	}
+	return best >= 0;
+}
+
+bool Computer::outfit(Game& game, int player, uint8_t x, uint8_t y,
+	Resource::Type resource) {
+
+	return Difficulty::specialise<Outfit>(game.difficulty, game, player,
+		x, y, resource);
+}
+
+bool Computer::develop(Game& game, int player, uint8_t& x, uint8_t& y) {
+	return Difficulty::specialise<Develop>(game.difficulty, game, player,
+		x, y);
+}
+
+bool Computer::declareBuyer(const Game& game, int player,
+	Resource::Type resource, int32_t surplus) { return surplus < 0; }
+
@@ -0,0 +1,41 @@
+#ifndef COMPUTER_HPP_
+#define COMPUTER_HPP_
+#include <stdint.h>
+#include "game.hpp"
+
+/** \file
+ * \brief Decisions for computer players
+ *
+ * The logic asks these whenever a computer-controlled seat has a choice to
+ * make. They are plain rules of thumb, cheap enough to run millions of games
+ * with, and take everything they need from the Game, so they are safe to call
+ * from any thread that owns the Game. */
+
+namespace Computer {
+	/** What would this plot best be outfitted for, by this player? */
+	Resource::Type chooseOutfit(const Game& game, int player,
+		uint8_t x, uint8_t y);
+	/** How much does the player want the plot? Higher is better. */
+	int32_t rateLand(const Game& game, int player, uint8_t x, uint8_t y);
+	/** The most the player would pay for the plot at a land auction: what
+	 *  they expect it to earn over the rest of the game, less the cost of
+	 *  putting a worker on it. */
+	int32_t valueLand(const Game& game, int player, uint8_t x, uint8_t y);
+	/** Pick the most wanted unowned plot. False if there are none left. */
+	bool chooseLand(const Game& game, int player, uint8_t& x, uint8_t& y);
+	/** Buy a worker from the store and outfit the player's idle plot with
+	 *  it, if they can afford it and the store has one. */
+	bool outfit(Game& game, int player, uint8_t x, uint8_t y,
+		Resource::Type resource);
+	/** Take a development turn: buy workers for idle plots, as far as the
+	 *  money and the store's stock allow. Reports the last plot outfitted,
+	 *  returning false if there wasn't one. */
+	bool develop(Game& game, int player, uint8_t& x, uint8_t& y);
+	/** Should the player buy (else sell) in this auction, given how much
+	 *  they will have left over (negative for short) after this month? */
+	bool declareBuyer(const Game& game, int player, Resource::Type resource,
+		int32_t surplus);
+}
+
+#endif
+
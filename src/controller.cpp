@@ -2,12 +2,9 @@
 #include <typeinfo>
 #include "controller.hpp"
 #include "platform.hpp"
+#include "tracezone.hpp"
 #include "util.hpp"
 
-Controller::Controller() : fired(false) {}
-Controller::~Controller() {}
-bool Controller::hadButtonPress() { bool f = fired; fired = false; return f; }
-
 /// Turn -1, 0, 1 axes into a direction
 static Direction make_direction(int x, int y) {
 	switch(y) {
@@ -268,6 +265,7 @@ void ControlManager::populate() {
 }
 
 void ControlManager::feedEvent(SDL_Event& event) {
+	TRACE_ZONE("ControlManager::feedEvent");
 	// I wish STL for_each was useful.
 	std::vector<Controller*>* set;
 	switch(event.type) {
@@ -294,6 +292,3 @@ void ControlManager::feedEvent(SDL_Event& event) {
 	for(std::vector<Controller*>::iterator i = set->begin(); i < set->end();
 		++i) { (*i)->feedEvent(event); }
 }
-
-const std::vector<Controller*>& ControlManager::getControllers()
-	{ return controllers; }
@@ -3,7 +3,9 @@
 
 #include <vector>
 #include <utility> // (pair)
-#include <SDL.h>
+#ifndef NOSDL
+# include <SDL.h>
+#endif
 
 /** \file
  * \brief Abstract controller handling */
@@ -28,10 +30,10 @@ inline void operator--(Direction& d) {
  * control the game: mouse, keyboard, joystick, Wiimote... */
 class Controller {
 protected:
-	Controller();
+	Controller() : fired(false) {}
 	bool fired; ///< See hadButtonPress()
 public:
-	virtual ~Controller();
+	virtual ~Controller() {}
 	/** Have the controller describe itself. */
 	virtual const char* getDescription() = 0;
 	/** Is the controller capable of reporting a screen position right now?
@@ -51,11 +53,15 @@ public:
 	 * Button presses should latch a flag which this function clears so as
 	 * to avoid double or missed presses from polling. The base class does
 	 * this using a 'fired' boolean, which should be adaquate for most. */
-	virtual bool hadButtonPress();
+	virtual bool hadButtonPress()
+		{ bool f = fired; fired = false; return f; }
 
+#ifndef NOSDL
 	/** Process SDL event. For the ControlManager, which needs to pre-
-	 * filter them (e.g. KeyboardController only gets KEYDOWN/KEYUP). */
+	 * filter them (e.g. KeyboardController only gets KEYDOWN/KEYUP). Not
+	 * in builds without SDL (NOSDL), which have no devices to feed. */
 	virtual void feedEvent(SDL_Event& event) = 0;
+#endif
 	/** Should also overload operator== so that ControlManager can detect
 	 * duplicates. Two controllers for the same input are equal. */
 	virtual bool operator==(const Controller& other) { return false; }
@@ -80,10 +86,13 @@ public:
 	 * vector, and will avoid creating duplicates. Designed to allow for
 	 * late-connected devices. */
 	void populate();
+#ifndef NOSDL
 	/** Provide an SDL event so that controller states can be updated. */
 	void feedEvent(SDL_Event& event);
+#endif
 	/** Get const access to the set of controllers. */
-	const std::vector<Controller*>& getControllers();
+	const std::vector<Controller*>& getControllers()
+		{ return controllers; }
 };
 
 #endif
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include "resources.hpp"
+#include "util.hpp"
 
 /** \file
  * \brief Difficulty levels and their effects */
@@ -18,27 +19,132 @@ namespace Difficulty {
 	// Note that we define preinc/decrement for Difficulty below.
 	// Values must be contiguous! (Easy: don't specify any.)
 
-	uint8_t getGameDuration(Type self);
-	double getMoveTime(Type self); ///< seconds (full food, normal species)
-	double getDeclareTime(Type self); ///< seconds (set buyer/seller)
-	double getAuctionTime(Type self); ///< seconds (both land and trade)
-	double getLandGrabTime(Type self); ///< seconds (time per tile)
-	double getWampusTimeMultiplier(Type self); ///< >1 == longer
+	/** Everything that varies with the level, as one record of constants,
+	 *  so that a rule is a load from a table rather than a switch, and
+	 *  folds away entirely where the level is known at compile time. */
+	struct Rules {
+		uint8_t duration;   ///< Months
+		ticks_t movetime;   ///< Full food, normal species
+		/** Original MULE controls various auction values via Auction
+		 *  Time Units; this is one in fifteenths of a second. */
+		uint8_t atu;
+		ticks_t landgrab;   ///< Time per tile
+		uint8_t wampus;     ///< Wampus time, in sevenths; >7 == longer
+		int8_t playerfood, playerenergy; ///< Initial stock
+		int8_t storefood, storeenergy, storeore, storeworkers;
+		bool colonyrating, randomevents, landauctions;
+		bool criticalselling, sellpricelimit, fussyplacement;
+		bool infiniteworkers, crystal, collusion, computerbonus;
+		/// Spread of the land auction count; 0 for no auctions
+		double auctionspread;
+		/// Most production varies either way, and its spread
+		int8_t variation; double variationspread;
+	};
+
+	/* In original MULE, a full-food standard move is 101 PTU == 707 BTU ==
+	 * 707/15 seconds (PAL @ 60Hz) == 47.13... seconds. In beginner, 101
+	 * PTU is 909 BTU, which comes out as 60.6 seconds. The ATU is likewise
+	 * in the original's fifteenths, and becomes ticks at compile time.
+	 *
+	 * The original land grab values are 8, 4, and 3, giving fractions of
+	 * seconds approximately equal to 1/2, 1/4, and 1/5. We are /slightly/
+	 * more forgiving, as all the twitchy people are now kept occupied by
+	 * CounterStrike.
+	 *
+	 * The Wampus multiplier is the same ratio as the move time, as the
+	 * basis is the same: you get more Wampus time in Beginner, because
+	 * PTUs are longer.
+	 *
+	 * The store's workers are overridden as infinite for BEGINNER. */
+	constexpr Rules RULES[] = {
+		// BEGINNER
+		{ 6, 60 * SECOND, 50, SECOND / 2, 9,  8, 4,  16, 16, 0, 14,
+		  false, false, false, false, true, false, true, false,
+		  false, false,  0.0,  0, 0.0 },
+		// STANDARD
+		{ 12, 47 * SECOND, 30, SECOND / 3, 7,  4, 2,  8, 8, 8, 14,
+		  true, true, true, true, false, true, false, false,
+		  false, false,  0.5,  2, 0.5 },
+		// TOURNAMENT
+		{ 12, 47 * SECOND, 25, SECOND / 4, 7,  4, 2,  8, 8, 8, 14,
+		  true, true, true, true, false, true, false, true,
+		  true, true,  1.0,  3, 1.0 },
+	};
+
+	constexpr const Rules& rules(Type self) { return RULES[self]; }
+
+	constexpr uint8_t getGameDuration(Type self)
+		{ return rules(self).duration; }
+	/// ticks (full food, normal species)
+	constexpr ticks_t getMoveTime(Type self)
+		{ return rules(self).movetime; }
+	/// ticks (set buyer/seller)
+	constexpr ticks_t getDeclareTime(Type self)
+		{ return 30 * rules(self).atu * SECOND / 15; }
+	/// ticks (both land and trade)
+	constexpr ticks_t getAuctionTime(Type self)
+		{ return 70 * rules(self).atu * SECOND / 15; }
+	/// ticks (time per tile)
+	constexpr ticks_t getLandGrabTime(Type self)
+		{ return rules(self).landgrab; }
+	/// sevenths; >7 == longer
+	constexpr uint8_t getWampusTimeSevenths(Type self)
+		{ return rules(self).wampus; }
 	void initialPlayerStock(Type self, Stock& initialise);
 	void initialStoreStock(Type self, Stock& initialise);
 	void initialStorePrices(Type self, Stock& initialise);
-	bool hasColonyRating(Type self); ///< Can all lose overall?
-	bool hasRandomEvents(Type self);
-	bool hasLandAuctions(Type self);
-	bool hasCriticalSelling(Type self); ///< Can sell beyond critical level
-	bool hasSellPriceLimit(Type self); ///<Cannot sell at 'scroll up' prices
-	bool hasFussyPlacement(Type self); ///<Mules run off if you miss the hut
-	bool hasInfiniteWorkers(Type self); ///< ...and at a fixed price of $100
-	bool hasCrystal(Type self);
-	bool hasCollusion(Type self);
-	bool hasComputerBonus(Type self); ///< Computers start with +$200
-	uint8_t calcMaxLandAuctions(Type self); ///< Generate random
-	int8_t calcProductionVariation(Type self); ///< Generate random
+	/// Can all lose overall?
+	constexpr bool hasColonyRating(Type self)
+		{ return rules(self).colonyrating; }
+	constexpr bool hasRandomEvents(Type self)
+		{ return rules(self).randomevents; }
+	constexpr bool hasLandAuctions(Type self)
+		{ return rules(self).landauctions; }
+	/// Can sell beyond critical level
+	constexpr bool hasCriticalSelling(Type self)
+		{ return rules(self).criticalselling; }
+	/// Cannot sell at 'scroll up' prices
+	constexpr bool hasSellPriceLimit(Type self)
+		{ return rules(self).sellpricelimit; }
+	/// Mules run off if you miss the hut
+	constexpr bool hasFussyPlacement(Type self)
+		{ return rules(self).fussyplacement; }
+	/// ...and at a fixed price of $100
+	constexpr bool hasInfiniteWorkers(Type self)
+		{ return rules(self).infiniteworkers; }
+	constexpr bool hasCrystal(Type self) { return rules(self).crystal; }
+	constexpr bool hasCollusion(Type self) { return rules(self).collusion; }
+	/// Computers start with +$200
+	constexpr bool hasComputerBonus(Type self)
+		{ return rules(self).computerbonus; }
+	/// Generate random
+	inline uint8_t calcMaxLandAuctions(Type self, Random& rng) {
+		// This is 'max' insofar that land auctions are limited by
+		// unclaimed land.
+		return rules(self).landauctions
+			? rng.normal(-1, 4, rules(self).auctionspread) + 1 : 0;
+	}
+	/// Ditto
+	inline int8_t calcProductionVariation(Type self, Random& rng) {
+		const int8_t v = rules(self).variation;
+		return v ? rng.normal(-v, v, rules(self).variationspread) : 0;
+	}
+
+	/** Calls F<level>::run(args...), so that in each specialisation of F,
+	 *  every rule asked of the level is a constant. Code the simulation
+	 *  spends its time in can be written this way to get a build of its
+	 *  own for each level, with the rules that don't apply compiled out. */
+	template <template <Type> class F, typename... Args>
+	inline auto specialise(Type self, Args&&... args)
+		-> decltype(F<BEGINNER>::run(args...)) {
+
+		switch(self) {
+			case BEGINNER:   return F<BEGINNER>::run(args...);
+			case STANDARD:   return F<STANDARD>::run(args...);
+			case TOURNAMENT: break;
+		}
+		return F<TOURNAMENT>::run(args...);
+	}
 	
 	/* The Wampus is interesting. In the original MULE, the difficulty
 	 * affects the brightness of his cave light, and also (via PTU/BTU
@@ -0,0 +1,299 @@
+#include <string.h>
+#include <algorithm>
+#include "environment.hpp"
+#include "valuation.hpp"
+#include "zobrist.hpp"
+
+static_assert(MEWL_ENV_PLAYERS == PLAYERS, "Seats differ from the game's");
+static_assert(MEWL_ENV_WIDTH == TERRAIN_WIDTH
+	&& MEWL_ENV_HEIGHT == TERRAIN_HEIGHT, "Map differs from the game's");
+static_assert(MEWL_ENV_GOODS == Resource::CRYSTAL + 1,
+	"Goods differ from the game's");
+static_assert(MEWL_ENV_CENTRE == DIR_CENTRE, "Directions differ");
+
+void Environment::Seat::set(const mewl_env_action& action) {
+	direction = action.direction < DIR_CENTRE
+		? static_cast<Direction>(action.direction) : DIR_CENTRE;
+	// Latched, as a real controller's; the logic clears it when it looks
+	if(action.button) { fired = true; }
+}
+
+Environment::Environment(Difficulty::Type difficulty, uint32_t agents)
+	: game(NULL), jumps(new GameLogicJumps(&game, NULL, NULL)),
+	logic(NULL), tick(0) {
+
+	setup.difficulty = difficulty;
+	for(int p = 0; p < PLAYERS; p++) {
+		if(agents & (1u << p)) {
+			setup.playersetup[p].humanPlayer(&seats[p]);
+			setup.playersetup[p].species = Species::COMPUTER;
+		} else {
+			setup.playersetup[p].computerPlayer();
+			setup.playersetup[p].species = Species::COMPUTER;
+		}
+	}
+}
+
+Environment::~Environment() {
+	clear();
+	delete jumps;
+}
+
+void Environment::clear() {
+	delete logic;
+	logic = NULL;
+	delete game;
+	game = NULL;
+}
+
+void Environment::reset(uint64_t seed) {
+	clear();
+	// A fresh set of jumps, as the last game's will be finished
+	delete jumps;
+	jumps = new GameLogicJumps(&game, NULL, NULL);
+	for(int p = 0; p < PLAYERS; p++) { seats[p].hadButtonPress(); }
+	game = new Game(setup, seed);
+	logic = GameLogic::getNewGameState(jumps, state);
+	tick = 0;
+}
+
+bool Environment::step(const mewl_env_action actions[PLAYERS]) {
+	if(!logic || jumps->isFinished()) { return false; }
+	for(int p = 0; p < PLAYERS; p++) { seats[p].set(actions[p]); }
+	GameLogic* next = logic->simulate(setup, game);
+	if(next) { delete logic; logic = next; }
+	tick++;
+	return !jumps->isFinished();
+}
+
+bool Environment::isFinished() const
+	{ return !logic || jumps->isFinished(); }
+
+uint64_t Environment::hash() const {
+	if(!game) { return 0; }
+	return Zobrist::hash(*game, logic->getStage(), state);
+}
+
+/* Every field is written once, straight from where the game keeps it, in the
+ * order of the layout; nothing is built up elsewhere first. */
+void Environment::observe(mewl_env_observation& out) const {
+	memset(&out, 0, sizeof(out));
+	if(!game) { return; }
+	const GameStage::Type stage = logic->getStage();
+	out.tick = tick;
+	out.stage = stage;
+	out.month = game->month;
+	out.difficulty = game->difficulty;
+	out.finished = jumps->isFinished();
+	for(int p = 0; p < PLAYERS; p++) {
+		out.money[p] = game->players[p].money;
+		out.score[p] = Valuation::score(*game, p);
+		for(int r = Resource::NONE; r <= Resource::CRYSTAL; r++) {
+			out.stock[p][r] = game->players[p].stock[
+				static_cast<Resource::Type>(r)];
+		}
+	}
+	for(int r = Resource::NONE; r <= Resource::CRYSTAL; r++) {
+		const Resource::Type resource = static_cast<Resource::Type>(r);
+		out.store[r] = game->store[resource];
+		out.prices[r] = game->prices[resource];
+	}
+	for(uint8_t y = 0; y < TERRAIN_HEIGHT; y++) {
+		for(uint8_t x = 0; x < TERRAIN_WIDTH; x++) {
+			const Tile& tile = game->terrain.tile(x, y);
+			out.owner[y][x] = tile.owned() ? tile.owner() : PLAYERS;
+			out.equipment[y][x] = tile.owned()
+				? tile.equipment() : Resource::NONE;
+			out.mountains[y][x] = tile.mountains();
+			out.crystal[y][x] = tile.crystal();
+			out.river[y][x] = tile.river();
+			out.production[y][x] = state.product.production[x][y];
+		}
+	}
+
+	out.player = -1;
+	switch(stage) {
+		case GameStage::LANDGRAB:
+			out.x = state.landgrab.x;
+			out.y = state.landgrab.y;
+			break;
+		case GameStage::PREAUCTION:
+		case GameStage::AUCTIONDECLARE:
+		case GameStage::AUCTION:
+		case GameStage::LANDAUCTION:
+			out.x = state.landauction.x;
+			out.y = state.landauction.y;
+			out.resource = state.preauction.resource;
+			for(int p = 0; p < PLAYERS; p++) {
+				out.buyer[p] = state.auctiondeclare.buyer[p];
+				out.bid[p] = state.auction.bid[p];
+			}
+			out.millis = state.auctiondeclare.time * 1000 / SECOND;
+			break;
+		case GameStage::PREDEVELOP:
+			out.player = state.predevelop.player;
+			break;
+		case GameStage::DEVELOPHUMAN:
+			out.player = state.develophuman.player;
+			out.millis = state.develophuman.time * 1000 / SECOND;
+			break;
+		case GameStage::DEVELOPCOMP:
+			out.player = state.developcomp.player;
+			out.x = state.developcomp.x;
+			out.y = state.developcomp.y;
+			break;
+		case GameStage::POSTDEVELOP:
+			out.player = state.postdevelop.player;
+			break;
+		default: break;
+	}
+}
+
+Environments::Environments(Difficulty::Type difficulty, uint32_t agents,
+	int count, int threads) : seeds(count), pool(threads) {
+
+	environments.reserve(count);
+	for(int i = 0; i < count; i++) {
+		environments.push_back(new Environment(difficulty, agents));
+	}
+}
+
+Environments::~Environments() {
+	for(size_t i = 0; i < environments.size(); i++)
+		{ delete environments[i]; }
+}
+
+int Environments::size() const { return environments.size(); }
+
+void Environments::reset(uint64_t seed) {
+	const int count = size();
+	for(int i = 0; i < count; i++) { seeds[i] = seed + i; }
+	pool.run((count + CHUNK - 1) / CHUNK, [&](int chunk, int worker) {
+		const int end = std::min(count, (chunk + 1) * CHUNK);
+		for(int i = chunk * CHUNK; i < end; i++)
+			{ environments[i]->reset(seeds[i]); }
+	});
+}
+
+void Environments::step(const mewl_env_action actions[][PLAYERS],
+	uint8_t done[], mewl_env_observation out[]) {
+
+	const int count = size();
+	pool.run((count + CHUNK - 1) / CHUNK, [&](int chunk, int worker) {
+		const int end = std::min(count, (chunk + 1) * CHUNK);
+		for(int i = chunk * CHUNK; i < end; i++) {
+			Environment& environment = *environments[i];
+			done[i] = !environment.step(actions[i]);
+			if(done[i]) {
+				seeds[i] += count;
+				environment.reset(seeds[i]);
+			}
+			if(out) { environment.observe(out[i]); }
+		}
+	});
+}
+
+void Environments::observe(mewl_env_observation out[]) {
+	const int count = size();
+	pool.run((count + CHUNK - 1) / CHUNK, [&](int chunk, int worker) {
+		const int end = std::min(count, (chunk + 1) * CHUNK);
+		for(int i = chunk * CHUNK; i < end; i++)
+			{ environments[i]->observe(out[i]); }
+	});
+}
+
+/* The C interface ----------------------------------------------------------*/
+
+struct mewl_env {
+	Environment environment;
+	mewl_env(Difficulty::Type difficulty, uint32_t agents)
+		: environment(difficulty, agents) {}
+};
+
+mewl_env* mewl_env_create(int difficulty, unsigned agents) {
+	if(difficulty < Difficulty::FIRST || difficulty > Difficulty::LAST
+	|| agents >> PLAYERS) { return NULL; }
+	return new mewl_env(static_cast<Difficulty::Type>(difficulty), agents);
+}
+
+void mewl_env_destroy(mewl_env* env) { delete env; }
+
+void mewl_env_reset(mewl_env* env, uint64_t seed)
+	{ env->environment.reset(seed); }
+
+int mewl_env_step(mewl_env* env,
+	const mewl_env_action actions[MEWL_ENV_PLAYERS])
+	{ return env->environment.step(actions); }
+
+void mewl_env_observe(const mewl_env* env, mewl_env_observation* out)
+	{ env->environment.observe(*out); }
+
+uint64_t mewl_env_hash(const mewl_env* env)
+	{ return env->environment.hash(); }
+
+struct mewl_envs {
+	Environments environments;
+	mewl_envs(Difficulty::Type difficulty, uint32_t agents, int count,
+		int threads)
+		: environments(difficulty, agents, count, threads) {}
+};
+
+mewl_envs* mewl_envs_create(int difficulty, unsigned agents, int count,
+	int threads) {
+
+	if(difficulty < Difficulty::FIRST || difficulty > Difficulty::LAST
+	|| agents >> PLAYERS || count <= 0) { return NULL; }
+	return new mewl_envs(static_cast<Difficulty::Type>(difficulty),
+		agents, count, threads);
+}
+
+void mewl_envs_destroy(mewl_envs* envs) { delete envs; }
+
+int mewl_envs_size(const mewl_envs* envs)
+	{ return envs->environments.size(); }
+
+void mewl_envs_reset(mewl_envs* envs, uint64_t seed)
+	{ envs->environments.reset(seed); }
+
+void mewl_envs_step(mewl_envs* envs,
+	const mewl_env_action actions[][MEWL_ENV_PLAYERS], uint8_t done[],
+	mewl_env_observation out[])
+	{ envs->environments.step(actions, done, out); }
+
+void mewl_envs_observe(mewl_envs* envs, mewl_env_observation out[])
+	{ envs->environments.observe(out); }
+
+int mewl_env_serve(mewl_env* env, FILE* in, FILE* out) {
+	mewl_env_observation observation;
+	int command;
+	while((command = fgetc(in)) != EOF) {
+		switch(command) {
+			case 'r': {
+				uint8_t bytes[8];
+				if(fread(bytes, 1, 8, in) != 8) { return 1; }
+				uint64_t seed = 0;
+				for(int i = 7; i >= 0; i--)
+					{ seed = (seed << 8) | bytes[i]; }
+				env->environment.reset(seed);
+				} break;
+			case 's': {
+				mewl_env_action actions[MEWL_ENV_PLAYERS];
+				for(int p = 0; p < PLAYERS; p++) {
+					uint8_t bytes[2];
+					if(fread(bytes, 1, 2, in) != 2)
+						{ return 1; }
+					actions[p].direction = bytes[0];
+					actions[p].button = bytes[1];
+				}
+				env->environment.step(actions);
+				} break;
+			case 'o': break;
+			default: return 1;
+		}
+		env->environment.observe(observation);
+		if(fwrite(&observation, sizeof(observation), 1, out) != 1
+		|| fflush(out)) { return 1; }
+	}
+	return 0;
+}
+
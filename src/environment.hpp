@@ -0,0 +1,102 @@
+#ifndef ENVIRONMENT_HPP_
+#define ENVIRONMENT_HPP_
+#include <stdint.h>
+#include <vector>
+#include "game.hpp"
+#include "gamelogic.hpp"
+#include "mewl_env.h"
+#include "workpool.hpp"
+
+/** \file
+ * \brief The game as a learning environment, for training players */
+
+/** One game, driven a tick at a time by a trainer instead of a UI.
+ *
+ * The trainer's seats are human players as far as the logic knows, each with
+ * a Seat for a controller, which reports whatever direction and button press
+ * the trainer gave it for the tick; the logic reads them exactly as it would
+ * a joystick. The rest are computers, on rules of thumb (there is no planner).
+ *
+ * observe() writes the Game and stage state field by field into the caller's
+ * mewl_env_observation, with nothing in between. This is what the C interface
+ * in mewl_env.h wraps; it is built, with the logic, into a library with no
+ * SDL, and so no UI, controllers or threads. */
+class Environment {
+	/// A controller that reports what it's told
+	class Seat : public Controller {
+		Direction direction;
+	public:
+		Seat() : direction(DIR_CENTRE) {}
+		void set(const mewl_env_action& action);
+		const char* getDescription() { return "Trainer"; }
+		bool hasPosition() { return false; }
+		std::pair<double, double> getPosition()
+			{ return std::make_pair(0.5, 0.5); }
+		Direction getDirection() { return direction; }
+#ifndef NOSDL
+		void feedEvent(SDL_Event& event) {}
+#endif
+	};
+	GameSetup setup;
+	Seat seats[PLAYERS];
+	Game* game; ///< NULL until reset
+	GameStageState state;
+	GameLogicJumps* jumps;
+	GameLogic* logic;
+	uint32_t tick;
+	void clear();
+	// Owns the game and logic, so isn't to be copied
+	Environment(const Environment&);
+	Environment& operator=(const Environment&);
+public:
+	/** The trainer plays the seats in the agents mask, a bit each. */
+	Environment(Difficulty::Type difficulty, uint32_t agents);
+	~Environment();
+	/** Start a new game from the colony ship landing. */
+	void reset(uint64_t seed);
+	/** Run a tick with the seats' actions. False once it's over. */
+	bool step(const mewl_env_action actions[PLAYERS]);
+	void observe(mewl_env_observation& out) const;
+	bool isFinished() const;
+	/** The game and stage's Zobrist hash; zero before the first reset. */
+	uint64_t hash() const;
+};
+
+/** Many games, stepped together, for trainers which learn from thousands at
+ *  once.
+ *
+ * Every game steps once per call, its observation going straight into its
+ * slot of the caller's array. The games are dealt out in chunks of CHUNK,
+ * each stepped and observed in one pass, to the workers of a WorkPool; a
+ * chunk's worth of games and their inputs and outputs are contiguous, and a
+ * worker has a whole chunk to get through for each lock it takes.
+ *
+ * A game which finishes starts another straight away, so that every slot is
+ * always in play, and is flagged done for that step. Game n in slot i of
+ * count is seeded with seed + i + n * count, so the whole batch depends on
+ * nothing but the first seed and the actions, however many threads run it. */
+class Environments {
+	std::vector<Environment*> environments;
+	std::vector<uint64_t> seeds; ///< Each slot's current game's
+	WorkPool pool;
+	Environments(const Environments&);
+	Environments& operator=(const Environments&);
+public:
+	/// Games to a job; enough that taking one costs nothing much
+	static const int CHUNK = 64;
+	/** Zero or fewer threads means one per processor. */
+	Environments(Difficulty::Type difficulty, uint32_t agents, int count,
+		int threads);
+	~Environments();
+	int size() const;
+	void reset(uint64_t seed);
+	/** Step every game with its seats' actions; flag which finished (and
+	 *  so started over) in done, and observe them all into out, if not
+	 *  NULL. */
+	void step(const mewl_env_action actions[][PLAYERS], uint8_t done[],
+		mewl_env_observation out[]);
+	void observe(mewl_env_observation out[]);
+};
+
+#endif
+
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include "game.hpp"
 #include "util.hpp"
+#include "zobrist.hpp"
 
 /* The logic can reset a stage's state by using placement new:
  * http://www.parashift.com/c++-faq-lite/dtors.html#faq-11.10
@@ -24,7 +25,8 @@ GameStageState::Scoreboard::Scoreboard() : message(ScoreboardMessage::NONE) {
 	}
 }
 GameStageState::LandGrab::LandGrab() : x(0), y(0) {}
-GameStageState::LandAuction::LandAuction() : x(0), y(0) {}
+GameStageState::LandAuction::LandAuction() : x(0), y(0), left(0)
+	{ for(int i = 0; i < PLAYERS; ++i) { bid[i] = -1; } }
 GameStageState::PreAuction::PreAuction() : resource(Resource::NONE), store(0) {
 	for(int i = 0; i < PLAYERS; ++i) {
 		stock[     i] = 0;
@@ -59,15 +61,6 @@ GameStageState::Product::Product() {
 GameStageState::PostProduct::PostProduct() {}
 
 Tile::Tile() : m_mountains(0), m_crystal(0), m_river(false), m_owned(false) {}
-uint8_t& Tile::mountains() { return m_mountains; }
-uint8_t& Tile::crystal() { return m_crystal; }
-bool Tile::river() const { return m_river; }
-bool Tile::owned() const { return m_owned; }
-int Tile::owner() const { assert(m_owned); return m_owner; }
-const Resource::Type& Tile::equipment() const {
-	assert(m_owned);
-	return m_equipment;
-}
 void Tile::setUnowned() { m_owned = false; }
 void Tile::setOwnership(int owner, Resource::Type equipment) {
 	m_owned = true;
@@ -79,19 +72,52 @@ Terrain::Terrain() : width(TERRAIN_WIDTH), height(TERRAIN_HEIGHT),
 	cityx(4), cityy(2) {
 
 	tiles.resize(width * height);
+	for(int i = 0; i < PLAYERS; i++) { plots[i] = worked[i] = 0; }
+	zobrist = 0; // Which is the hash of a blank map
+}
+void Terrain::count(const Tile& tile, int delta) {
+	if(!tile.owned()) { return; }
+	plots[tile.owner()] += delta;
+	if(tile.equipment() != Resource::NONE)
+		{ worked[tile.owner()] += delta; }
+}
+void Terrain::setOwnership(uint8_t x, uint8_t y, int owner,
+	Resource::Type equipment) {
+
+	Tile& plot = tile(x, y);
+	const int index = x + y * width;
+	count(plot, -1);
+	zobrist ^= Zobrist::plot(index, plot);
+	plot.setOwnership(owner, equipment);
+	zobrist ^= Zobrist::plot(index, plot);
+	count(plot, +1);
 }
+void Terrain::setUnowned(uint8_t x, uint8_t y) {
+	Tile& plot = tile(x, y);
+	count(plot, -1);
+	zobrist ^= Zobrist::plot(x + y * width, plot);
+	plot.setUnowned();
+}
+void Terrain::setMountains(uint8_t x, uint8_t y, uint8_t mountains) {
+	Tile& plot = tile(x, y);
+	const int index = x + y * width;
+	zobrist ^= Zobrist::mountains(index, plot.m_mountains)
+		^ Zobrist::mountains(index, mountains);
+	plot.m_mountains = mountains;
+}
+void Terrain::setCrystal(uint8_t x, uint8_t y, uint8_t crystal) {
+	Tile& plot = tile(x, y);
+	const int index = x + y * width;
+	zobrist ^= Zobrist::crystal(index, plot.m_crystal)
+		^ Zobrist::crystal(index, crystal);
+	plot.m_crystal = crystal;
+}
+uint8_t Terrain::getPlots(int player) const { return plots[player]; }
+uint8_t Terrain::getWorked(int player) const { return worked[player]; }
 uint8_t Terrain::getSizeX() const { return width; }
 uint8_t Terrain::getSizeY() const { return height; }
 uint8_t Terrain::getCityX() const { return cityx; }
 uint8_t Terrain::getCityY() const { return cityy; }
-Tile& Terrain::tile(uint8_t x, uint8_t y) {
-	assert(x < width); assert(y < height);
-	return tiles[x + (y * width)];
-}
-const Tile& Terrain::tile(uint8_t x, uint8_t y) const {
-	// This should call the non-const version, rather than a tight loop
-	return const_cast<Terrain*>(this)->tile(x, y);
-}
 
 /* Oh, how I'd love to have closures for this sort of thing. */
 static void depositCrystalSafely(Terrain& t, int x, int y, int level) {
@@ -99,10 +125,14 @@ static void depositCrystalSafely(Terrain& t, int x, int y, int level) {
 	if(x >= t.getSizeX()) { return; }
 	if(y >= t.getSizeY()) { return; }
 	if(t.tile(x, y).crystal() < level) // Keep higher values
-		{ t.tile(x, y).crystal() = level; }
+		{ t.setCrystal(x, y, level); }
 }
 
-Game::Game(const GameSetup& setup) : difficulty(setup.difficulty), month(0) {
+Game::Game(const GameSetup& setup) : Game(setup, random_seed()) {}
+
+Game::Game(const GameSetup& setup, uint64_t seed) :
+	difficulty(setup.difficulty), month(0), rng(seed), playerevents(0) {
+
 	// Set up the players
 	for(int i = 0; i < PLAYERS; i++) {
 		players[i].setup = setup.playersetup[i];
@@ -112,6 +142,7 @@ Game::Game(const GameSetup& setup) : difficulty(setup.difficulty), month(0) {
 			Difficulty::hasComputerBonus(difficulty))
 			{ players[i].money += 200; }
 		Difficulty::initialPlayerStock(difficulty, players[i].stock);
+		turnorder[i] = i;
 	}
 	/* Generate terrain. Yay hardcoding! Genericising this is not on my
 	 * list of fun things to do at the moment, and without scaling or
@@ -121,30 +152,29 @@ Game::Game(const GameSetup& setup) : difficulty(setup.difficulty), month(0) {
 	const uint8_t river = terrain.getCityX();
 	for(uint8_t y = 0; y < h; y++) {
 		for(uint8_t x = 0; x < w; x++) {
-			Tile& tile = terrain.tile(x, y);
-			tile.mountains() = 0;
-			tile.crystal() = 0;
+			terrain.setMountains(x, y, 0);
+			terrain.setCrystal(x, y, 0);
 			/* No mutator for river, as things outside of this
 			 * shouldn't be able to change it. */
-			tile.m_river = (x == river);
-			tile.setUnowned();
+			terrain.tile(x, y).m_river = (x == river);
+			terrain.setUnowned(x, y);
 		}
 		/* Generate mountains. This isn't the same algorithm as the
 		 * original game, but generates the same distribution. */
-		uint8_t mountleft  = random_uniform(0, river - 1);
-		uint8_t mountright = random_uniform(river + 1, w - 1);
-		uint8_t mountains  = random_uniform(1, 3); // left side
-		terrain.tile(mountleft,  y).mountains() = mountains;
-		terrain.tile(mountright, y).mountains() = 4 - mountains;
+		uint8_t mountleft  = rng.uniform(0, river - 1);
+		uint8_t mountright = rng.uniform(river + 1, w - 1);
+		uint8_t mountains  = rng.uniform(1, 3); // left side
+		terrain.setMountains(mountleft,  y, mountains);
+		terrain.setMountains(mountright, y, 4 - mountains);
 	}
 	if(Difficulty::hasCrystal(difficulty)) {
 		/* Generate crystal deposits. True to the original game, even
 		 * though you can't mine there, they might land on the river or
 		 * town itself. */
 		for(int i = 1; i <= 4; i++) {
-			uint8_t x = random_uniform(0, w - 1);
-			uint8_t y = random_uniform(0, h - 1);
-			terrain.tile(x, y).crystal() = 3;
+			uint8_t x = rng.uniform(0, w - 1);
+			uint8_t y = rng.uniform(0, h - 1);
+			terrain.setCrystal(x, y, 3);
 			depositCrystalSafely(terrain, x-1, y  , 2);
 			depositCrystalSafely(terrain, x  , y-1, 2);
 			depositCrystalSafely(terrain, x+1, y  , 2);
@@ -191,3 +221,21 @@ uint8_t countTilesOfType(const Game& game, int player, const Stock& types) {
 	}
 	return count;
 }
+
+uint8_t tileYield(const Tile& tile, Resource::Type resource) {
+	switch(resource) {
+		case Resource::NONE:    return 0;
+		case Resource::FOOD:    return tile.river() ? 4
+		                             : tile.mountains() ? 1 : 2;
+		case Resource::ENERGY:  return tile.river() ? 2
+		                             : tile.mountains() ? 1 : 3;
+		case Resource::ORE:     return tile.river() ? 0
+		                             : tile.mountains() + 1;
+		case Resource::CRYSTAL: return tile.crystal();
+	}
+	return 0;
+}
+
+/* As the original: three a month for the first four, then four, then five. */
+int32_t foodRequirement(uint8_t month)
+	{ return 3 + (month > 0 ? (month - 1) / 4 : 0); }
@@ -1,11 +1,13 @@
 #ifndef GAME_HPP_
 #define GAME_HPP_
 
+#include <assert.h>
 #include <vector>
 #include "controller.hpp"
 #include "gamesetup.hpp"
 #include "playerevent.hpp"
 #include "resources.hpp"
+#include "util.hpp"
 
 /** \file
  * \brief State of the entire game programme */
@@ -18,7 +20,14 @@ const uint8_t TERRAIN_HEIGHT = 5;
 namespace GameStage { typedef enum { TITLE, COLOUR, SPECIES, SCOREBOARD,
 	LANDGRAB, LANDAUCTION, PREAUCTION, AUCTIONDECLARE, AUCTION, PREDEVELOP,
 	DEVELOPHUMAN, WAMPUS, DEVELOPCOMP, POSTDEVELOP, PREPRODUCT, PRODUCT,
-	POSTPRODUCT } Type; };
+	POSTPRODUCT } Type;
+	const Type FIRST = TITLE;
+	const Type LAST  = POSTPRODUCT;
+	const int COUNT  = LAST + 1; ///< For sizing per-stage tables
+	/** A set of stages, one bit each. */
+	typedef uint32_t Mask;
+	inline Mask mask(Type stage) { return 1u << stage; }
+};
 
 /** Production-time random events. Some of these need a location; some just a
  *  row, others nothing at all. The quake needs a mountain, but since the
@@ -71,6 +80,9 @@ public:
 	} landgrab;
 	struct LandAuction    { LandAuction();
 		uint8_t x; uint8_t y;
+		uint8_t left; ///< Auctions to go after this one
+		/// The most each computer will go; negative for the rules' say
+		int32_t bid[PLAYERS];
 	} landauction;
 	struct PreAuction     { PreAuction();
 		Resource::Type resource; ///< 'none' means 'land'; rest varied
@@ -83,8 +95,8 @@ public:
 	struct AuctionDeclare { AuctionDeclare();
 		// Preauction still valid, plus:
 		bool buyer[PLAYERS]; ///< else seller
-		double time;
-		double timemax;
+		ticks_t time;
+		ticks_t timemax;
 	} auctiondeclare;
 	struct Auction        { Auction();
 		// Preauction and auctiondeclare still valid (inc. time), plus:
@@ -105,8 +117,8 @@ public:
 		bool town; ///< else colony view
 		bool mule; ///< in tow?
 		Resource::Type muletype;
-		double time; ///< seconds remaining
-		double timemax; ///< 'normal' maximum time for player for scale
+		ticks_t time; ///< remaining
+		ticks_t timemax; ///< 'normal' maximum time for player for scale
 		// TODO wampus mountain, visibility
 	} develophuman;
 	struct Wampus         { Wampus();
@@ -128,10 +140,11 @@ public:
 	struct Product        { Product();
 		/** The type of production is the exploitation type.
 		 * The production in each square here does NOT include the
-		 * effects of the post-production event. The two which may
-		 * affect it are PEST and PIRATES, both of which are
-		 * deterministic. The UI must animate the production change
-		 * away, and the logic must remember not to count it. */
+		 * effects of the post-production event until that stage. The
+		 * two which may affect it are PEST and PIRATES, both of which
+		 * are deterministic. The logic takes the losses out of these
+		 * squares when the event happens; the UI must animate the
+		 * production change away. */
 		uint8_t production[TERRAIN_WIDTH][TERRAIN_HEIGHT];
 	} product;
 	struct PostProduct    { PostProduct();
@@ -159,14 +172,17 @@ class Tile {
 	Resource::Type m_equipment;
 public:
 	Tile();
-	uint8_t& mountains(); ///< Can be mutated by planetquakes
-	uint8_t& crystal(); ///< Can be mutated by meteor strikes
+	uint8_t mountains() const;
+	uint8_t crystal() const;
 	/*const*/ bool river() const;
 	/*const*/ bool owned() const;
 	/*const*/ int owner() const;
 	const Resource::Type& equipment() const;
+private:
+	// Through the Terrain, which keeps count
 	void setUnowned();
 	void setOwnership(int owner, Resource::Type equipment);
+	friend class Terrain;
 	friend class Game; // Let the terrain generator set the river
 };
 
@@ -178,6 +194,13 @@ class Terrain {
 	/* The river runs vertically through the city. Anything else may not
 	 * be drawn correctly by the UI. */
 	std::vector<Tile> tiles;
+	/* Kept up to date as plots change hands, so that valuing a player's
+	 * land needn't look over the map. */
+	uint8_t plots[PLAYERS];  ///< Owned by each player
+	uint8_t worked[PLAYERS]; ///< Of those, with a worker on
+	/// Of every plot, XORed with the change as each changes (see Zobrist)
+	uint64_t zobrist;
+	void count(const Tile& tile, int delta);
 public:
 	Terrain();
 	/** Don't mistake this and getCity as an indicator that changing the
@@ -190,8 +213,43 @@ public:
 	uint8_t getCityX() const; uint8_t getCityY() const;
 	Tile& tile(uint8_t x, uint8_t y);
 	const Tile& tile(uint8_t x, uint8_t y) const;
+	/** Give the plot to a player, outfitted for a resource, or NONE. */
+	void setOwnership(uint8_t x, uint8_t y, int owner,
+		Resource::Type equipment);
+	void setUnowned(uint8_t x, uint8_t y);
+	/// Planetquakes move mountains, and meteorites bring crystal
+	void setMountains(uint8_t x, uint8_t y, uint8_t mountains);
+	void setCrystal(uint8_t x, uint8_t y, uint8_t crystal);
+	/** How many plots the player owns, and how many of them are worked;
+	 *  without looking, as these are kept count of. */
+	uint8_t getPlots(int player) const;
+	uint8_t getWorked(int player) const;
+	/** The map's part of the game's hash, without looking, as for the
+	 *  counts. */
+	uint64_t getHash() const;
 };
 
+/* These are read for every plot, many times a tick in batches and searches,
+ * so are inline. */
+inline uint8_t Tile::mountains() const { return m_mountains; }
+inline uint8_t Tile::crystal() const { return m_crystal; }
+inline bool Tile::river() const { return m_river; }
+inline bool Tile::owned() const { return m_owned; }
+inline int Tile::owner() const { assert(m_owned); return m_owner; }
+inline const Resource::Type& Tile::equipment() const {
+	assert(m_owned);
+	return m_equipment;
+}
+inline uint64_t Terrain::getHash() const { return zobrist; }
+inline Tile& Terrain::tile(uint8_t x, uint8_t y) {
+	assert(x < width); assert(y < height);
+	return tiles[x + (y * width)];
+}
+inline const Tile& Terrain::tile(uint8_t x, uint8_t y) const {
+	// This should call the non-const version, rather than a tight loop
+	return const_cast<Terrain*>(this)->tile(x, y);
+}
+
 /** The state of one game in progress. This covers things like inventory; it
  *  does not cover the logic, although it does initialise itself sensibly. */
 class Game {
@@ -202,8 +260,18 @@ public: // Another fancypants struct
 	uint8_t month;
 	Stock store;
 	Stock prices; ///< (store)
+	/** All of the game's luck comes from here, and nowhere else, so that
+	 *  a game can be replayed from its seed (given the same inputs). */
+	Random rng;
+	/// Bit per PlayerEvent::Type; each can only happen once per game
+	uint32_t playerevents;
+	/// This month's development order, by player index; lowest score first
+	int turnorder[PLAYERS];
 
+	/** Start a game seeded from the calling thread's default stream. */
 	Game(const GameSetup& setup);
+	/** Start a game which will play out the same way every time. */
+	Game(const GameSetup& setup, uint64_t seed);
 };
 
 /* Utility functions which operate upon Games but are not part of manipulating
@@ -216,5 +284,12 @@ public: // Another fancypants struct
  *       p=-1, stock={all nonzero}     : count owned tiles, even idle ones */
 uint8_t countTilesOfType(const Game& game, int player, const Stock& types);
 
+/** Units of the resource a tile would produce each month if outfitted for it,
+ *  before any random variation or shortage of energy. */
+uint8_t tileYield(const Tile& tile, Resource::Type resource);
+
+/** Units of food each player needs to get through a month's development. */
+int32_t foodRequirement(uint8_t month);
+
 #endif
 
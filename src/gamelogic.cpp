@@ -4,13 +4,6 @@
 #include "gamelogic.hpp"
 #include "platform.hpp"
 
-// This be some serious voodoo, mon.
-#define STAGESTATE_RESET(FIELD, KLASS) \
-	state.FIELD.~KLASS(); \
-	new(&state.FIELD) GameStageState::KLASS();
-
-/** Clear up any stray button presses by throwing away the controller flag.
- *  Useful as a synchronisation point before players have to press buttons. */
 void clear_stray_presses(GameSetup& setup) {
 	for(int p = 0; p < PLAYERS; ++p) {
 		if(!setup.playersetup[p].computer) {
@@ -19,8 +12,9 @@ void clear_stray_presses(GameSetup& setup) {
 	}
 }
 
-GameLogicJumps::GameLogicJumps(Game** ptrgame, const UserInterface& ui)
-	: ptrgame(ptrgame), ui(ui) {}
+GameLogicJumps::GameLogicJumps(Game** ptrgame, const UserInterface* ui,
+	ControlManager* controlman, Planner* planner) : ptrgame(ptrgame),
+	ui(ui), controlman(controlman), planner(planner), finished(false) {}
 
 void GameLogicJumps::startTheGameAlready(const GameSetup& setup) {
 	*ptrgame = new Game(setup);
@@ -28,10 +22,24 @@ void GameLogicJumps::startTheGameAlready(const GameSetup& setup) {
 
 void GameLogicJumps::destroyTheGameAlready() {
 	delete *ptrgame;
+	*ptrgame = NULL;
+}
+
+GameLogic* GameLogicJumps::gameOver(GameStageState& state) {
+	if(!controlman) { finished = true; return NULL; }
+	destroyTheGameAlready();
+	return GameLogic::getTitleState(this, state, *controlman);
 }
 
+bool GameLogicJumps::isFinished() const { return finished; }
+
+Planner* GameLogicJumps::getPlanner() const { return planner; }
+
 class GameLogicSpecies : public GameLogic {
 	virtual GameStage::Type getStage() { return GameStage::SPECIES; }
+	// The game begins with the colony ship landing
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::POSTPRODUCT); }
 	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
 		// While computer player and < PLAYERS, set as COMP and player++
 		while((state.species.player < PLAYERS) &&
@@ -45,9 +53,8 @@ class GameLogicSpecies : public GameLogic {
 
 		// Have we finished here?
 		if(state.species.player >= PLAYERS) {
-			abort();
-			/*warn("return (next logic) required"); // TODO
-			die();*/
+			jumps->startTheGameAlready(setup);
+			return GameLogic::getNewGameState(jumps, state);
 		}
 
 		// If direction pressed, set PlayerSetup species, defined = true
@@ -90,6 +97,8 @@ class GameLogicColour : public GameLogic {
 	int time; // Ticks spent on the current colour
 	bool claimed[PLAYERS]; // Colour [i] has been claimed
 	virtual GameStage::Type getStage() { return GameStage::COLOUR; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::SPECIES); }
 	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
 		bool gone = false; // The current colour has been claimed
 		bool done = true; // Everybody who wants one has a colour
@@ -165,9 +174,11 @@ class GameLogicTitle : public GameLogic {
 	// 'Votes' for moving the difficulty. This is actually a kind-of
 	// workaround for not having a latching mechanism on left/right in the
 	// control abstraction. One player * 50 ticks (one half-sec) = change.
-	Sint16 diffvotes;
+	int16_t diffvotes;
 	
 	virtual GameStage::Type getStage() { return GameStage::TITLE; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::COLOUR); }
 	// TODO When a new controller tries to activate but there are no free
 	// player slots, either drop oldest or somehow poke UI to report it.
 	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
@@ -257,6 +268,8 @@ GameLogic::GameLogic(GameLogicJumps* jumps, GameStageState& state) :
 	jumps(jumps), state(state) {}
 
 GameLogic::~GameLogic() {}
+GameStage::Mask GameLogic::predictNextStages(const GameSetup& setup)
+	{ return 0; }
 GameLogic* GameLogic::getTitleState(GameLogicJumps* jumps,
 	GameStageState& state, ControlManager& controlman) {
 
@@ -7,19 +7,35 @@
 /** \file
  * \brief Game mechanic mutations of the game state */
 
+class GameLogic;
+class Planner;
 class UserInterface;
 /** A class for allowing the game logic to trigger some events affecting the
- *  rest of the code in a controlled fashion. Set up by main. */
+ *  rest of the code in a controlled fashion. Set up by main, or by anything
+ *  else running games, such as the batch runner, which has no UI and no
+ *  controllers; the logic must cope with those being NULL. Without a
+ *  planner, searching computer players fall back on rules of thumb. */
 class GameLogicJumps {
 private:
 	Game** ptrgame;
-	const UserInterface& ui;
+	const UserInterface* ui;
+	ControlManager* controlman;
+	Planner* planner;
+	bool finished;
 public:
-	GameLogicJumps(Game** ptrgame, const UserInterface& ui);
+	GameLogicJumps(Game** ptrgame, const UserInterface* ui,
+		ControlManager* controlman, Planner* planner = NULL);
 	/** Create a game, held at the pointer, using given setup. */
 	void startTheGameAlready(const GameSetup& setup);
 	/** Deconstruct the Game and zero the pointer. */
 	void destroyTheGameAlready();
+	/** The game is over. Returns the logic for what comes next: back to the
+	 *  title screen, if we have controllers to go there with. If not, the
+	 *  Game is left alone for inspection, isFinished() becomes true, and
+	 *  this returns NULL, so the final scoreboard just carries on. */
+	GameLogic* gameOver(GameStageState& state);
+	bool isFinished() const;
+	Planner* getPlanner() const;
 	/*  Pass through to UserInterface:: ... */
 	//bool isPlayerTouchingMountain();
 };
@@ -45,11 +61,38 @@ public:
 	 * should be deleted. Simulation may be skipped while the UI
 	 * transitions. */
 	virtual GameLogic* simulate(GameSetup& setup, Game* game) = 0;
+	/** Guess which stage(s) the logic returned by simulate() will be for,
+	 * given how things stand now, so the UI can get ready for them ahead
+	 * of time. Need not be exact; empty if there's no good guess. */
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup);
 
 	/** Get the initial game logic, for the title screen. */
 	static GameLogic* getTitleState(GameLogicJumps* jumps,
 		GameStageState& state, ControlManager& controlman);
+	/** Get the logic for the start of a game proper, once the Game has been
+	 *  created: the colony ship landing. */
+	static GameLogic* getNewGameState(GameLogicJumps* jumps,
+		GameStageState& state);
+	/** Get the logic to carry a game on from just after a computer
+	 *  player's decision, for the planner to play out: after the LANDGRAB,
+	 *  development; after DEVELOPCOMP, the next turn; after the
+	 *  LANDAUCTION, the bidding for its plot; after the AUCTIONDECLARE,
+	 *  the auction. NULL for anything else. */
+	static GameLogic* getResumeState(GameLogicJumps* jumps,
+		GameStageState& state, Game& game, GameStage::Type after);
 };
 
+/* For the logic implementations only ------------------------------------- */
+
+/* This be some serious voodoo, mon. Resets a stage's part of the state.
+ * (Placement new; see game.cpp.) */
+#define STAGESTATE_RESET(FIELD, KLASS) \
+	state.FIELD.~KLASS(); \
+	new(&state.FIELD) GameStageState::KLASS();
+
+/** Clear up any stray button presses by throwing away the controller flag.
+ *  Useful as a synchronisation point before players have to press buttons. */
+void clear_stray_presses(GameSetup& setup);
+
 #endif
 
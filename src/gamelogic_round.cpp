@@ -0,0 +1,1007 @@
+#include <new> // For STAGESTATE_RESET
+#include <assert.h>
+
+#include "computer.hpp"
+#include "gamelogic.hpp"
+#include "market.hpp"
+#include "planner.hpp"
+#include "platform.hpp"
+#include "production.hpp"
+#include "valuation.hpp"
+#include "zobrist.hpp"
+
+/* The logic for the game proper, from the colony ship landing, through each
+ * month's rounds, to the final scoreboard. See doc/stages.dot for the flow.
+ *
+ * A human's development turn is deliberately just its timer and the pub: there
+ * is no colony or town to walk about, so no outfitting workers by hand, and no
+ * wampus to hunt (its stage is never entered). Computers outfit through the
+ * rules or the Planner instead. Everything else in a month is here, so that
+ * whole games can be played, and those can drop in as stages of their own
+ * without the rest noticing.
+ *
+ * Stages which only show the players something wait for the humans to press
+ * their buttons. Computers never need to, so a game of nothing but computers
+ * goes through each such stage in a single tick, other than to let searching
+ * computers think (see Planner).
+ *
+ * Development goes in order of score, lowest first, as fixed at the end of the
+ * land grab in Game::turnorder; stages in it carry the index into that. */
+
+/// Auctions go in the original's order; crystal is skipped if there is none
+static const Resource::Type auction_goods[] =
+	{ Resource::ORE, Resource::CRYSTAL, Resource::FOOD, Resource::ENERGY };
+static const int AUCTION_GOODS =
+	sizeof(auction_goods) / sizeof(*auction_goods);
+static const int32_t STORE_MARGIN = 35; ///< Store sells at price + this
+static const double EVENT_CHANCE = 0.275; ///< Of a player event, per turn
+
+static bool any_humans(const GameSetup& setup) {
+	for(int p = 0; p < PLAYERS; p++)
+		{ if(!setup.playersetup[p].computer) { return true; } }
+	return false;
+}
+
+/** The next auction after the given index (-1 for the first), or -1. */
+static int next_good(const Game& game, int after) {
+	for(int g = after + 1; g < AUCTION_GOODS; g++) {
+		if(auction_goods[g] != Resource::CRYSTAL
+		|| Difficulty::hasCrystal(game.difficulty)) { return g; }
+	}
+	return -1;
+}
+
+/** Is the plot free for the taking (or buying)? */
+static bool claimable(const Game& game, uint8_t x, uint8_t y) {
+	return !game.terrain.tile(x, y).owned()
+		&& !(x == game.terrain.getCityX()
+		  && y == game.terrain.getCityY());
+}
+
+static void add_money(Player& player, int32_t amount) {
+	int64_t money = (int64_t) player.money + amount;
+	player.money = money < 0 ? 0 : (uint32_t) money;
+}
+
+/* These stages are reached from further down the file. */
+static GameLogic* new_scoreboard(GameLogicJumps* jumps,
+	GameStageState& state, Game& game);
+static GameLogic* new_predevelop(GameLogicJumps* jumps,
+	GameStageState& state, Game& game, int turn);
+static GameLogic* new_preauction(GameLogicJumps* jumps,
+	GameStageState& state, Game& game, int good);
+
+/** For stages which wait for the humans to have seen them. */
+class GameLogicShow : public GameLogic {
+	bool ready[PLAYERS];
+protected:
+	GameLogicShow(GameLogicJumps* jumps, GameStageState& state) :
+		GameLogic(jumps, state)
+		{ for(int p = 0; p < PLAYERS; p++) { ready[p] = false; } }
+	/** Have all the humans (or just the one given) pressed their button
+	 *  since we started? */
+	bool seen(GameSetup& setup, int only = -1) {
+		bool all = true;
+		for(int p = 0; p < PLAYERS; p++) {
+			if(setup.playersetup[p].computer
+			|| (only >= 0 && p != only)) { continue; }
+			if(!ready[p]) { ready[p] = setup.playersetup[p]
+				.controller->hadButtonPress(); }
+			if(!ready[p]) { all = false; }
+		}
+		return all;
+	}
+};
+
+/** Takes a stage's searching computers through the planner, one at a time.
+ *  Until each has an answer, the stage should go by the rules of thumb. */
+class Consultation {
+	Planner* planner; ///< NULL if everyone goes by the rules
+	int asking; ///< Whose search is going; -1 for nobody's
+	bool answered[PLAYERS];
+	Planner::Choice choices[PLAYERS];
+public:
+	Consultation(GameLogicJumps* jumps) : planner(jumps->getPlanner()),
+		asking(-1) { for(int p = 0; p < PLAYERS; p++)
+			{ answered[p] = false; } }
+	~Consultation() { if(asking >= 0) { planner->finish(); } }
+	/** Poll, once a tick. Returns true once every searching computer in
+	 *  the waiting mask has an answer; if hurried, cuts the search going
+	 *  short, and gives up on the rest. Claimed is as Planner::start. */
+	bool consult(const GameSetup& setup, const Game& game,
+		const GameStageState& state, Planner::Decision decision,
+		uint32_t waiting, uint32_t claimed = 0, bool hurry = false) {
+
+		if(!planner) { return true; }
+		if(asking >= 0) {
+			if(!hurry && !planner->ready()) { return false; }
+			choices[asking] = planner->finish();
+			answered[asking] = true;
+			asking = -1;
+		}
+		if(hurry) { return true; }
+		for(int p = 0; p < PLAYERS; p++) {
+			if(answered[p] || !(waiting & (1u << p))
+			|| !setup.playersetup[p].computer
+			|| setup.playersetup[p].strategy
+				!= PlayerSetup::SEARCH) { continue; }
+			planner->start(decision, game, state, p, claimed);
+			asking = p;
+			return false;
+		}
+		return true;
+	}
+	/** The player's answer, or NULL if they don't have one. */
+	const Planner::Choice* answer(int player) const
+		{ return answered[player] ? &choices[player] : NULL; }
+};
+
+/* Auctions -----------------------------------------------------------------*/
+
+/** This tick's moves in the auction: humans push up to raise their price, and
+ *  down to drop it; computers go their own way. */
+static void auction_moves(GameSetup& setup, const Market::Book& book,
+	int8_t move[PLAYERS]) {
+
+	for(int p = 0; p < PLAYERS; p++) {
+		if(setup.playersetup[p].computer) {
+			move[p] = Market::computerMove(book, p);
+			continue;
+		}
+		switch(setup.playersetup[p].controller->getDirection()) {
+			case DIR_N: move[p] =  1; break;
+			case DIR_S: move[p] = -1; break;
+			default:    move[p] =  0;
+		}
+	}
+}
+
+class GameLogicAuction : public GameLogicShow {
+	int good;
+	bool opened; ///< The book needs the setup, so waits for simulate()
+	Market::Book book;
+	virtual GameStage::Type getStage() { return GameStage::AUCTION; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::PREAUCTION)
+		       | GameStage::mask(GameStage::SCOREBOARD); }
+
+	/** Scarcity drives the store's price up, and glut down. */
+	void reprice(Game& game) {
+		const Resource::Type resource = auction_goods[good];
+		int32_t& price = game.prices[resource];
+		if(game.store[resource] < 4) { price += price / 4; }
+		else if(game.store[resource] > 16) { price -= price / 8; }
+		if(price < 10) { price = 10; }
+	}
+
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		const Resource::Type resource = auction_goods[good];
+		if(!opened) {
+			const int32_t price = game->prices[resource];
+			Market::open(book, *game, setup, state, resource,
+				price, price + STORE_MARGIN);
+			opened = true;
+		}
+		if(any_humans(setup)) {
+			int8_t move[PLAYERS];
+			auction_moves(setup, book, move);
+			const bool trading = Market::step(book, move);
+			Market::apply(book, *game, state, resource);
+			if(state.auctiondeclare.time > 0
+				&& (trading || !seen(setup))) {
+
+				state.auctiondeclare.time--;
+				return 0;
+			}
+		} else {
+			// Nobody to watch, so it can all happen at once
+			Market::run(book, state.auctiondeclare.time);
+			Market::apply(book, *game, state, resource);
+		}
+		reprice(*game);
+		int next = next_good(*game, good);
+		if(next >= 0)
+			{ return new_preauction(jumps, state, *game, next); }
+		return new_scoreboard(jumps, state, *game);
+	}
+public:
+	GameLogicAuction(GameLogicJumps* jumps, GameStageState& state,
+		Game& game, int good) :
+		GameLogicShow(jumps, state), good(good), opened(false) {
+
+		STAGESTATE_RESET(auction, Auction);
+		state.auctiondeclare.timemax =
+			Difficulty::getAuctionTime(game.difficulty);
+		state.auctiondeclare.time = state.auctiondeclare.timemax;
+	}
+};
+
+class GameLogicAuctionDeclare : public GameLogicShow {
+	int good;
+	virtual GameStage::Type getStage()
+		{ return GameStage::AUCTIONDECLARE; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::AUCTION); }
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		// Humans push up to sell, down to buy
+		for(int p = 0; p < PLAYERS; p++) {
+			if(setup.playersetup[p].computer) { continue; }
+			switch(setup.playersetup[p].controller->getDirection()){
+				case DIR_N: state.auctiondeclare.buyer[p] =
+					false; break;
+				case DIR_S: state.auctiondeclare.buyer[p] =
+					true; break;
+				default: ;
+			}
+		}
+		// Searching computers think for as long as there is
+		const bool timeout = state.auctiondeclare.time <= 0;
+		const bool decided = consultation.consult(setup, *game, state,
+			Planner::DECLARE, (1u << PLAYERS) - 1, 0, timeout);
+		for(int p = 0; p < PLAYERS; p++) {
+			const Planner::Choice* answer = consultation.answer(p);
+			if(answer) { state.auctiondeclare.buyer[p] =
+				answer->buyer; }
+		}
+		if(!timeout && (!decided || (any_humans(setup)
+			&& !seen(setup)))) {
+
+			state.auctiondeclare.time--;
+			return 0;
+		}
+		return new GameLogicAuction(jumps, state, *game, good);
+	}
+	Consultation consultation;
+public:
+	GameLogicAuctionDeclare(GameLogicJumps* jumps, GameStageState& state,
+		Game& game, int good) :
+		GameLogicShow(jumps, state), good(good), consultation(jumps) {
+
+		STAGESTATE_RESET(auctiondeclare, AuctionDeclare);
+		for(int p = 0; p < PLAYERS; p++) {
+			state.auctiondeclare.buyer[p] = Computer::declareBuyer(
+				game, p, state.preauction.resource,
+				state.preauction.surplus[p]);
+		}
+		state.auctiondeclare.timemax =
+			Difficulty::getDeclareTime(game.difficulty);
+		state.auctiondeclare.time = state.auctiondeclare.timemax;
+	}
+};
+
+class GameLogicPreAuction : public GameLogicShow {
+	int good;
+	virtual GameStage::Type getStage() { return GameStage::PREAUCTION; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::AUCTIONDECLARE); }
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		if(!seen(setup)) { return 0; }
+		return new GameLogicAuctionDeclare(jumps, state, *game, good);
+	}
+
+	/// What the player needs to keep back for next month
+	static int32_t requirement(const Game& game, int player,
+		Resource::Type resource) {
+
+		Stock powered;
+		switch(resource) {
+			case Resource::FOOD:
+				return foodRequirement(game.month + 1);
+			case Resource::ENERGY:
+				powered.food = powered.ore = 1;
+				powered.crystal = 1;
+				return countTilesOfType(game, player, powered);
+			default: return 0;
+		}
+	}
+
+	/// What goes off; food and energy rot, and ore can't be stockpiled
+	static int32_t spoilage(Resource::Type resource, int32_t stock,
+		int32_t need) {
+
+		int32_t extra = stock - need;
+		if(extra <= 0) { return 0; }
+		switch(resource) {
+			case Resource::FOOD:   return extra / 2;
+			case Resource::ENERGY: return extra / 4;
+			default: return stock > 50 ? stock - 50 : 0;
+		}
+	}
+public:
+	GameLogicPreAuction(GameLogicJumps* jumps, GameStageState& state,
+		Game& game, int good) :
+		GameLogicShow(jumps, state), good(good) {
+
+		const Resource::Type resource = auction_goods[good];
+		/* The production state is still good: nothing has reset it
+		 * since the last production, so sum up what was made there. */
+		uint32_t produced[PLAYERS] = {0};
+		for(uint8_t y = 0; y < game.terrain.getSizeY(); y++) {
+			for(uint8_t x = 0; x < game.terrain.getSizeX(); x++) {
+				const Tile& tile = game.terrain.tile(x, y);
+				if(tile.owned() && tile.equipment() == resource)
+					{ produced[tile.owner()] +=
+					  state.product.production[x][y]; }
+			}
+		}
+		STAGESTATE_RESET(preauction, PreAuction);
+		state.preauction.resource = resource;
+		for(int p = 0; p < PLAYERS; p++) {
+			int32_t& stock = game.players[p].stock[resource];
+			int32_t need = requirement(game, p, resource);
+			int32_t rot = spoilage(resource, stock, need);
+			stock -= rot;
+			state.preauction.stock[p]      = stock;
+			state.preauction.production[p] = produced[p];
+			state.preauction.spoilage[p]   = rot;
+			state.preauction.surplus[p]    = stock - need;
+		}
+		state.preauction.store = game.store[resource];
+	}
+};
+
+static GameLogic* new_preauction(GameLogicJumps* jumps,
+	GameStageState& state, Game& game, int good)
+	{ return new GameLogicPreAuction(jumps, state, game, good); }
+
+/* Production ---------------------------------------------------------------*/
+
+class GameLogicPostProduct : public GameLogicShow {
+	bool landing; ///< The colony ship, rather than a month's end
+	virtual GameStage::Type getStage() { return GameStage::POSTPRODUCT; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup) {
+		return GameStage::mask(landing ? GameStage::SCOREBOARD
+			: GameStage::PREAUCTION);
+	}
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		if(!seen(setup)) { return 0; }
+		if(landing) { return new_scoreboard(jumps, state, *game); }
+		return new_preauction(jumps, state, *game, next_good(*game,-1));
+	}
+public:
+	/** The game is NULL for the landing, where nothing happens. */
+	GameLogicPostProduct(GameLogicJumps* jumps, GameStageState& state,
+		Game* game) : GameLogicShow(jumps, state), landing(!game) {
+
+		STAGESTATE_RESET(postproduct, PostProduct);
+		if(landing) { return; }
+		state.postproduct.event =
+			Production::chooseEvent(*game, game->rng, true);
+		Production::spoil(*game, state.postproduct.event,
+			state.product);
+	}
+};
+
+class GameLogicProduct : public GameLogicShow {
+	virtual GameStage::Type getStage() { return GameStage::PRODUCT; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::POSTPRODUCT); }
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		if(!seen(setup)) { return 0; }
+		// The UI has shown it; now it actually arrives
+		for(uint8_t y = 0; y < game->terrain.getSizeY(); y++) {
+			for(uint8_t x = 0; x < game->terrain.getSizeX(); x++) {
+				const Tile& tile = game->terrain.tile(x, y);
+				if(!tile.owned()) { continue; }
+				game->players[tile.owner()].stock[
+					tile.equipment()] +=
+					state.product.production[x][y];
+			}
+		}
+		return new GameLogicPostProduct(jumps, state, game);
+	}
+public:
+	GameLogicProduct(GameLogicJumps* jumps, GameStageState& state,
+		Game& game) : GameLogicShow(jumps, state) {
+
+		STAGESTATE_RESET(product, Product);
+		Production::produce(game, state.product,
+			state.preproduct.event);
+	}
+};
+
+class GameLogicPreProduct : public GameLogicShow {
+	virtual GameStage::Type getStage() { return GameStage::PREPRODUCT; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::PRODUCT); }
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		if(!seen(setup)) { return 0; }
+		return new GameLogicProduct(jumps, state, *game);
+	}
+public:
+	GameLogicPreProduct(GameLogicJumps* jumps, GameStageState& state,
+		Game& game) : GameLogicShow(jumps, state) {
+
+		STAGESTATE_RESET(preproduct, PreProduct);
+		state.preproduct.event =
+			Production::chooseEvent(game, game.rng, false);
+		Production::strike(game, state.preproduct.event);
+	}
+};
+
+/* Development --------------------------------------------------------------*/
+
+/** After the given turn, the next, or production if that was the last. */
+static GameLogic* next_turn(GameLogicJumps* jumps, GameStageState& state,
+	Game& game, int turn) {
+
+	if(turn + 1 < PLAYERS)
+		{ return new_predevelop(jumps, state, game, turn + 1); }
+	return new GameLogicPreProduct(jumps, state, game);
+}
+
+class GameLogicPostDevelop : public GameLogicShow {
+	int turn;
+	virtual GameStage::Type getStage() { return GameStage::POSTDEVELOP; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup) {
+		return GameStage::mask(turn + 1 < PLAYERS
+			? GameStage::PREDEVELOP : GameStage::PREPRODUCT);
+	}
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		if(!seen(setup, state.postdevelop.player)) { return 0; }
+		return next_turn(jumps, state, *game, turn);
+	}
+public:
+	GameLogicPostDevelop(GameLogicJumps* jumps, GameStageState& state,
+		Game& game, int turn, uint32_t winnings) :
+		GameLogicShow(jumps, state), turn(turn) {
+
+		STAGESTATE_RESET(postdevelop, PostDevelop);
+		state.postdevelop.player = game.turnorder[turn];
+		state.postdevelop.winnings = winnings;
+		game.players[state.postdevelop.player].money += winnings;
+	}
+};
+
+class GameLogicDevelopComp : public GameLogic {
+	int turn;
+	bool thinking; ///< The planner is searching for us
+	virtual GameStage::Type getStage() { return GameStage::DEVELOPCOMP; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::POSTDEVELOP); }
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		const int p = state.developcomp.player;
+		uint8_t& x = state.developcomp.x;
+		uint8_t& y = state.developcomp.y;
+		Planner* planner = jumps->getPlanner();
+		// Searching computers pick their first outfit; rules, the rest
+		if(planner && setup.playersetup[p].strategy
+			== PlayerSetup::SEARCH) {
+
+			Planner::Choice choice;
+			/* A speculation still going may be for us, and
+			 * finishing it keeps its answer. */
+			if(!thinking && planner->busy()) { planner->finish(); }
+			if(thinking) {
+				if(!planner->ready()) { return 0; }
+				thinking = false;
+				choice = planner->finish();
+			} else if(!planner->recall(*game, p, choice)) {
+				planner->start(Planner::DEVELOP, *game, state,
+					p);
+				thinking = true;
+				return 0;
+			}
+			if(choice.x != Planner::Choice::NOWHERE
+				&& Computer::outfit(*game, p, choice.x,
+				choice.y, choice.outfit))
+				{ x = choice.x; y = choice.y; }
+		}
+		Computer::develop(*game, p, x, y);
+		return new GameLogicPostDevelop(jumps, state, *game, turn, 0);
+	}
+public:
+	GameLogicDevelopComp(GameLogicJumps* jumps, GameStageState& state,
+		const Game& game, int turn) :
+		GameLogic(jumps, state), turn(turn), thinking(false) {
+
+		STAGESTATE_RESET(developcomp, DevelopComp);
+		state.developcomp.player = game.turnorder[turn];
+	}
+	virtual ~GameLogicDevelopComp()
+		{ if(thinking) { jumps->getPlanner()->finish(); } }
+};
+
+class GameLogicDevelopHuman : public GameLogic {
+	int turn;
+	virtual GameStage::Type getStage() { return GameStage::DEVELOPHUMAN; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::POSTDEVELOP); }
+	/** Put the planner to work on the computers' turns to come, one at a
+	 *  time, so they have an answer ready when they get there. */
+	void think(const GameSetup& setup, const Game& game) {
+		Planner* planner = jumps->getPlanner();
+		if(!planner) { return; }
+		if(planner->busy()) {
+			if(planner->ready()) { planner->finish(); }
+			return;
+		}
+		for(int t = turn + 1; t < PLAYERS; t++) {
+			const int q = game.turnorder[t];
+			if(!setup.playersetup[q].computer
+			|| setup.playersetup[q].strategy != PlayerSetup::SEARCH
+			|| planner->hasPlan(game, q)) { continue; }
+			planner->speculate(game, state, q);
+			return;
+		}
+	}
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		const int p = state.develophuman.player;
+		uint32_t winnings = 0;
+		think(setup, *game);
+		if(setup.playersetup[p].controller->hadButtonPress()) {
+			// Off to the pub with whatever time is left
+			const int left = state.develophuman.time * 4 / SECOND;
+			int pot = 50 * ((game->month / 4) + 1)
+				+ game->rng.uniform(0, left);
+			winnings = pot > 250 ? 250 : pot;
+		} else if(--state.develophuman.time > 0) {
+			return 0;
+		}
+		return new GameLogicPostDevelop(jumps, state, *game, turn,
+			winnings);
+	}
+public:
+	/** The player ate 'eaten' of the 'need' units of food they required. */
+	GameLogicDevelopHuman(GameLogicJumps* jumps, GameStageState& state,
+		Game& game, int turn, int32_t eaten, int32_t need) :
+		GameLogic(jumps, state), turn(turn) {
+
+		STAGESTATE_RESET(develophuman, DevelopHuman);
+		const int p = game.turnorder[turn];
+		state.develophuman.player = p;
+		state.develophuman.timemax =
+			Difficulty::getMoveTime(game.difficulty) *
+			Species::getTimeSevenths(
+				game.players[p].setup.species) / 7;
+		// A quarter of the time for nothing, the rest by how fed
+		state.develophuman.time = state.develophuman.timemax
+			* (need + 3 * eaten) / (4 * need);
+	}
+};
+
+class GameLogicPreDevelop : public GameLogicShow {
+	int turn;
+	int32_t eaten, need; ///< Food; need is never zero
+	virtual GameStage::Type getStage() { return GameStage::PREDEVELOP; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup) {
+		return GameStage::mask(setup.playersetup[
+			state.predevelop.player].computer
+			? GameStage::DEVELOPCOMP : GameStage::DEVELOPHUMAN);
+	}
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		const int p = state.predevelop.player;
+		if(setup.playersetup[p].computer) {
+			return new GameLogicDevelopComp(jumps, state, *game,
+				turn);
+		}
+		if(!seen(setup, p)) { return 0; }
+		clear_stray_presses(setup);
+		return new GameLogicDevelopHuman(jumps, state, *game, turn,
+			eaten, need);
+	}
+
+	/** Pick an event which hasn't happened yet this game, and whose
+	 *  preconditions hold. Good luck never goes to the leader, nor bad luck
+	 *  to whoever is last. Returns false if nothing fits. */
+	bool chooseEvent(Game& game, int player, PlayerEvent::Type& event) {
+		uint32_t allowed = PlayerEvent::eligible(player, game)
+			& ~game.playerevents;
+		if(player == game.turnorder[PLAYERS - 1])
+			{ allowed &= ~PlayerEvent::GOOD; }
+		if(player == game.turnorder[0])
+			{ allowed &= PlayerEvent::GOOD; }
+		return PlayerEvent::choose(allowed, game.rng, event);
+	}
+public:
+	GameLogicPreDevelop(GameLogicJumps* jumps, GameStageState& state,
+		Game& game, int turn) :
+		GameLogicShow(jumps, state), turn(turn), eaten(1), need(1) {
+
+		STAGESTATE_RESET(predevelop, PreDevelop);
+		const int p = game.turnorder[turn];
+		Player& player = game.players[p];
+		state.predevelop.player = p;
+		// Eat; going hungry means less time to work
+		const int32_t required = foodRequirement(game.month);
+		const int32_t ate = player.stock.food < required
+			? player.stock.food : required;
+		player.stock.food -= ate;
+		if(required) { eaten = ate; need = required; }
+		// Luck
+		PlayerEvent::Type event;
+		if(!Difficulty::hasRandomEvents(game.difficulty)
+		|| game.rng.fraction() >= EVENT_CHANCE
+		|| !chooseEvent(game, p, event)) { return; }
+		game.playerevents |= 1u << event;
+		if(PlayerEvent::good(event) && !player.stock.food)
+			{ event = PlayerEvent::CARE_PACKAGE; }
+		int32_t money;
+		uint16_t each;
+		Stock change = PlayerEvent::changes(event, p, game,
+			&money, &each);
+		add_money(player, money);
+		for(int r = Resource::NONE; r <= Resource::CRYSTAL; r++) {
+			int32_t& stock = player.stock[
+				static_cast<Resource::Type>(r)];
+			stock += change[static_cast<Resource::Type>(r)];
+			if(stock < 0) { stock = 0; }
+		}
+		PlayerEvent::applyOther(event, p, game);
+		state.predevelop.eventhappens = true;
+		state.predevelop.eventtype = event;
+	}
+};
+
+static GameLogic* new_predevelop(GameLogicJumps* jumps,
+	GameStageState& state, Game& game, int turn)
+	{ return new GameLogicPreDevelop(jumps, state, game, turn); }
+
+/** Fix the turn order, lowest score first, and start on the first turn. */
+static GameLogic* start_development(GameLogicJumps* jumps,
+	GameStageState& state, Game& game) {
+
+	uint32_t scores[PLAYERS];
+	for(int p = 0; p < PLAYERS; p++) {
+		scores[p] = Valuation::score(game, p);
+		int i = p; // Insertion sort; stable, so ties keep order
+		while(i > 0 && scores[game.turnorder[i-1]] > scores[p])
+			{ game.turnorder[i] = game.turnorder[i-1]; i--; }
+		game.turnorder[i] = p;
+	}
+	return new_predevelop(jumps, state, game, 0);
+}
+
+/* Land ---------------------------------------------------------------------*/
+
+static GameLogic* next_land_auction(GameLogicJumps* jumps,
+	GameStageState& state, Game& game, int left);
+
+/** The store sells the plot at state.landauction to the highest bidder. This
+ *  is the AUCTION stage again, but for land; see Market. Computers go as high
+ *  as the planner bid for them, if it did, else as the rules value the plot. */
+class GameLogicLandBidding : public GameLogicShow {
+	bool opened; ///< The book needs the setup, so waits for simulate()
+	Market::Book book;
+	virtual GameStage::Type getStage() { return GameStage::AUCTION; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::LANDAUCTION)
+		       | GameStage::mask(GameStage::PREDEVELOP); }
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		const uint8_t x = state.landauction.x;
+		const uint8_t y = state.landauction.y;
+		if(!opened) {
+			int32_t value[PLAYERS];
+			for(int p = 0; p < PLAYERS; p++) {
+				const int32_t bid = state.landauction.bid[p];
+				value[p] = !setup.playersetup[p].computer ? 0
+					: bid >= 0 ? bid
+					: Computer::valueLand(*game, p, x, y);
+			}
+			Market::openLand(book, *game, value,
+				Market::LAND_FLOOR, Market::LAND_OPENING);
+			opened = true;
+		}
+		if(any_humans(setup)) {
+			int8_t move[PLAYERS];
+			auction_moves(setup, book, move);
+			const bool trading = Market::step(book, move);
+			Market::apply(book, *game, state, Resource::NONE);
+			if(book.store && state.auctiondeclare.time > 0
+				&& (trading || !seen(setup))) {
+
+				state.auctiondeclare.time--;
+				return 0;
+			}
+		} else {
+			Market::run(book, state.auctiondeclare.time);
+			Market::apply(book, *game, state, Resource::NONE);
+		}
+		for(int p = 0; p < PLAYERS; p++) {
+			if(book.traded[p]) { game->terrain.setOwnership(x, y,
+				p, Resource::NONE); }
+		}
+		return next_land_auction(jumps, state, *game,
+			state.landauction.left);
+	}
+public:
+	GameLogicLandBidding(GameLogicJumps* jumps, GameStageState& state,
+		Game& game) : GameLogicShow(jumps, state), opened(false) {
+
+		STAGESTATE_RESET(preauction, PreAuction);
+		STAGESTATE_RESET(auctiondeclare, AuctionDeclare);
+		STAGESTATE_RESET(auction, Auction);
+		for(int p = 0; p < PLAYERS; p++)
+			{ state.auctiondeclare.buyer[p] = true; }
+		state.auctiondeclare.timemax =
+			Difficulty::getAuctionTime(game.difficulty);
+		state.auctiondeclare.time = state.auctiondeclare.timemax;
+	}
+};
+
+/** Shows everyone which plot is up for auction, while searching computers
+ *  decide how high to go; until the humans have seen it, if there are any. */
+class GameLogicLandAuction : public GameLogicShow {
+	Consultation consultation;
+	virtual GameStage::Type getStage() { return GameStage::LANDAUCTION; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::AUCTION); }
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		const bool looked = seen(setup);
+		const bool decided = consultation.consult(setup, *game, state,
+			Planner::BID, (1u << PLAYERS) - 1, 0,
+			looked && any_humans(setup));
+		if(!looked || !decided) { return 0; }
+		for(int p = 0; p < PLAYERS; p++) {
+			const Planner::Choice* answer = consultation.answer(p);
+			if(answer) { state.landauction.bid[p] = answer->bid; }
+		}
+		clear_stray_presses(setup);
+		return new GameLogicLandBidding(jumps, state, *game);
+	}
+public:
+	GameLogicLandAuction(GameLogicJumps* jumps, GameStageState& state,
+		uint8_t x, uint8_t y, int left) :
+		GameLogicShow(jumps, state), consultation(jumps) {
+
+		STAGESTATE_RESET(landauction, LandAuction);
+		state.landauction.x = x;
+		state.landauction.y = y;
+		state.landauction.left = left;
+	}
+};
+
+/** Auction another plot, if there are any to go and any left, else get on
+ *  with development. The store picks one at random. */
+static GameLogic* next_land_auction(GameLogicJumps* jumps,
+	GameStageState& state, Game& game, int left) {
+
+	int free = 0;
+	for(uint8_t y = 0; y < game.terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < game.terrain.getSizeX(); x++)
+			{ free += claimable(game, x, y); }
+	}
+	if(left <= 0 || !free) {
+		return start_development(jumps, state, game);
+	}
+	int pick = game.rng.uniform(0, free - 1);
+	for(uint8_t y = 0; y < game.terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < game.terrain.getSizeX(); x++) {
+			if(claimable(game, x, y) && !pick--) {
+				return new GameLogicLandAuction(jumps, state,
+					x, y, left - 1);
+			}
+		}
+	}
+	return NULL; // Unreachable
+}
+
+/** After the land grab, as many land auctions as the month brings. */
+static GameLogic* start_land_auctions(GameLogicJumps* jumps,
+	GameStageState& state, Game& game) {
+
+	return next_land_auction(jumps, state, game,
+		Difficulty::calcMaxLandAuctions(game.difficulty, game.rng));
+}
+
+class GameLogicLandGrab : public GameLogic {
+	bool claimed[PLAYERS];
+	ticks_t ticks; ///< Spent on the current plot
+	ticks_t tileticks; ///< To spend on each plot
+	Consultation consultation;
+
+	virtual GameStage::Type getStage() { return GameStage::LANDGRAB; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup)
+		{ return GameStage::mask(GameStage::LANDAUCTION)
+		       | GameStage::mask(GameStage::PREDEVELOP); }
+
+	void claim(Game& game, int player, uint8_t x, uint8_t y) {
+		game.terrain.setOwnership(x, y, player, Resource::NONE);
+		claimed[player] = true;
+	}
+
+	/// Where a computer wants to go: the planner's answer while it's still
+	/// free, else the rules'. False if there's nowhere.
+	bool target(const Game& game, int player, uint8_t& x, uint8_t& y) {
+		const Planner::Choice* answer = consultation.answer(player);
+		if(answer && answer->x != Planner::Choice::NOWHERE
+			&& claimable(game, answer->x, answer->y))
+			{ x = answer->x; y = answer->y; return true; }
+		return Computer::chooseLand(game, player, x, y);
+	}
+
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		uint8_t& cx = state.landgrab.x;
+		uint8_t& cy = state.landgrab.y;
+		uint8_t x, y;
+		uint32_t has = 0;
+		bool waiting = false; // for a human
+		for(int p = 0; p < PLAYERS; p++) {
+			if(claimed[p]) { has |= 1u << p; }
+			else if(!setup.playersetup[p].computer)
+				{ waiting = true; }
+		}
+		const bool thought = consultation.consult(setup, *game, state,
+			Planner::LAND, ~has & ((1u << PLAYERS) - 1), has);
+		// The computers needn't wait for the cursor if nobody else is
+		if(!waiting) {
+			if(!thought) { return 0; }
+			for(int p = 0; p < PLAYERS; p++) {
+				if(!claimed[p] && target(*game, p, x, y))
+					{ claim(*game, p, x, y); }
+			}
+			return start_land_auctions(jumps, state, *game);
+		}
+		for(int p = 0; p < PLAYERS; p++) {
+			if(claimed[p] || !claimable(*game, cx, cy)) {continue;}
+			if(setup.playersetup[p].computer) {
+				if(target(*game, p, x, y) && x == cx && y == cy)
+					{ claim(*game, p, cx, cy); }
+			} else if(setup.playersetup[p].controller
+				->hadButtonPress()) { claim(*game, p, cx, cy); }
+		}
+		// Move the cursor along, skipping the town
+		if(++ticks < tileticks) { return 0; }
+		ticks = 0;
+		do {
+			if(++cx >= game->terrain.getSizeX()) { cx = 0; cy++; }
+			if(cy >= game->terrain.getSizeY()) {
+				return start_land_auctions(jumps, state, *game);
+			}
+		} while(cx == game->terrain.getCityX()
+		     && cy == game->terrain.getCityY());
+		return 0;
+	}
+public:
+	GameLogicLandGrab(GameLogicJumps* jumps, GameStageState& state,
+		Game& game) : GameLogic(jumps, state), ticks(0),
+		consultation(jumps) {
+
+		STAGESTATE_RESET(landgrab, LandGrab);
+		game.month++;
+		tileticks = Difficulty::getLandGrabTime(game.difficulty);
+		for(int p = 0; p < PLAYERS; p++) { claimed[p] = false; }
+	}
+};
+
+/* Scoreboard ---------------------------------------------------------------*/
+
+class GameLogicScoreboard : public GameLogicShow {
+	bool over;
+	virtual GameStage::Type getStage() { return GameStage::SCOREBOARD; }
+	virtual GameStage::Mask predictNextStages(const GameSetup& setup) {
+		return GameStage::mask(over ? GameStage::TITLE
+			: GameStage::LANDGRAB);
+	}
+	virtual GameLogic* simulate(GameSetup& setup, Game* game) {
+		assert(game);
+		if(!seen(setup)) { return 0; }
+		if(over) { return jumps->gameOver(state); }
+		clear_stray_presses(setup);
+		return new GameLogicLandGrab(jumps, state, *game);
+	}
+
+	/** How is the colony doing? At the end, how did it do? */
+	static ScoreboardMessage::Type rate(const Game& game, uint32_t colony,
+		bool last) {
+
+		using namespace ScoreboardMessage;
+		// A colony can starve or freeze before its time is up
+		if(Difficulty::hasColonyRating(game.difficulty)) {
+			bool food = game.store.food, energy = game.store.energy;
+			for(int p = 0; p < PLAYERS; p++) {
+				const Stock& stock = game.players[p].stock;
+				if(stock.food)   { food = true; }
+				if(stock.energy) { energy = true; }
+			}
+			if(!food)   { return FAILFOOD; }
+			if(!energy) { return FAILENERGY; }
+		}
+		if(last) {
+			static const Type ratings[] = { ENDREALBAD, ENDBAD,
+				ENDSURVIVE, ENDOK, ENDGOOD, ENDREALGOOD };
+			for(int i = 0; i < 6; i++) {
+				if(colony < (uint32_t) (i + 1) * 20000)
+					{ return ratings[i]; }
+			}
+			return ENDAWESOME;
+		}
+		if(!game.store.food && !game.store.energy) { return LOWBOTH; }
+		if(!game.store.food)   { return LOWFOOD; }
+		if(!game.store.energy) { return LOWENERGY; }
+		if(!game.store.ore)    { return LOWORE; }
+		return NONE;
+	}
+public:
+	GameLogicScoreboard(GameLogicJumps* jumps, GameStageState& state,
+		Game& game) : GameLogicShow(jumps, state) {
+
+		STAGESTATE_RESET(scoreboard, Scoreboard);
+		// Between months, the store turns ore into workers
+		if(!Difficulty::hasInfiniteWorkers(game.difficulty)) {
+			int32_t make = 14 - game.store.workers;
+			if(make > game.store.ore / 2)
+				{ make = game.store.ore / 2; }
+			if(make > 0) {
+				game.store.workers += make;
+				game.store.ore -= make * 2;
+			}
+		}
+		// The kept counts should never drift from the map
+		assert(Valuation::consistent(game));
+		assert(game.terrain.getHash()
+			== Zobrist::terrain(game.terrain));
+		uint32_t colony = 0;
+		for(int p = 0; p < PLAYERS; p++) {
+			state.scoreboard.landvalue[p]  =
+				Valuation::land(game, p);
+			state.scoreboard.goodsvalue[p] =
+				Valuation::goods(game, p);
+			colony += game.players[p].money
+				+ state.scoreboard.landvalue[p]
+				+ state.scoreboard.goodsvalue[p];
+		}
+		const bool last = game.month >=
+			Difficulty::getGameDuration(game.difficulty);
+		state.scoreboard.message = rate(game, colony, last);
+		const ScoreboardMessage::Type message =
+			state.scoreboard.message;
+		over = last || message == ScoreboardMessage::FAILFOOD
+			|| message == ScoreboardMessage::FAILENERGY;
+	}
+};
+
+static GameLogic* new_scoreboard(GameLogicJumps* jumps,
+	GameStageState& state, Game& game)
+	{ return new GameLogicScoreboard(jumps, state, game); }
+
+GameLogic* GameLogic::getNewGameState(GameLogicJumps* jumps,
+	GameStageState& state) {
+
+	return new GameLogicPostProduct(jumps, state, NULL);
+}
+
+GameLogic* GameLogic::getResumeState(GameLogicJumps* jumps,
+	GameStageState& state, Game& game, GameStage::Type after) {
+
+	switch(after) {
+		case GameStage::LANDGRAB:
+			return start_land_auctions(jumps, state, game);
+		case GameStage::DEVELOPCOMP:
+			for(int turn = 0; turn < PLAYERS; turn++) {
+				if(game.turnorder[turn]
+					== state.developcomp.player) {
+					return next_turn(jumps, state, game,
+						turn);
+				}
+			}
+			break;
+		case GameStage::LANDAUCTION:
+			return new GameLogicLandBidding(jumps, state, game);
+		case GameStage::AUCTIONDECLARE:
+			for(int good = 0; good < AUCTION_GOODS; good++) {
+				if(auction_goods[good]
+					== state.preauction.resource) {
+					return new GameLogicAuction(jumps,
+						state, game, good);
+				}
+			}
+			break;
+		default: ;
+	}
+	return NULL;
+}
+
@@ -1,7 +1,7 @@
 #include "gamesetup.hpp"
 
 PlayerSetup::PlayerSetup() : species(Species::COMPUTER), computer(true),
-	controller(NULL) {}
+	controller(NULL), strategy(SEARCH) {}
 
 void PlayerSetup::humanPlayer(Controller* controller)
 	{ computer = false; this->controller = controller; }
@@ -21,6 +21,9 @@ public: // This is just a struct with an ego problem
 	Species::Type species;
 	bool computer;
 	Controller* controller; ///< meaningless if computer player
+	/// How a computer player decides; rules of thumb are quick but dim
+	typedef enum { RULES, SEARCH } Strategy;
+	Strategy strategy; ///< meaningless if human player
 	// Use these to set the above to keep comp => controller==NULL invariant
 	void humanPlayer(Controller* controller);
 	void computerPlayer();
@@ -28,6 +31,7 @@ public: // This is just a struct with an ego problem
 inline bool operator==(const PlayerSetup& one, const PlayerSetup& two) {
 	return one.species == two.species
 		&& one.computer == two.computer
+		&& one.strategy == two.strategy
 		&& one.controller == two.controller;
 }
 // std::rel_ops affects all types. Boost (operators.hpp) is overkill for this.
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <string.h>
+#include "lockstep.hpp"
+#include "platform.hpp"
+
+static const char MAGIC[4] = { 'M', 'E', 'W', 'L' };
+static const uint8_t VERSION_BYTE = 1; ///< Of the protocol
+/// What the host tells each machine as the game starts
+static const size_t WELCOME_BYTES = 17;
+static const int WAIT_MS = 1000; ///< For the host to start, or others to end
+
+/* Everything goes over the wire little-endian, whatever we are. */
+static void put32(uint8_t* out, uint32_t value)
+	{ for(int i = 0; i < 4; i++) { out[i] = value >> (8 * i); } }
+static void put64(uint8_t* out, uint64_t value)
+	{ for(int i = 0; i < 8; i++) { out[i] = value >> (8 * i); } }
+static uint32_t get32(const uint8_t* in) {
+	uint32_t value = 0;
+	for(int i = 3; i >= 0; i--) { value = (value << 8) | in[i]; }
+	return value;
+}
+static uint64_t get64(const uint8_t* in) {
+	uint64_t value = 0;
+	for(int i = 7; i >= 0; i--) { value = (value << 8) | in[i]; }
+	return value;
+}
+
+RemoteController::RemoteController(int seat) : seat(seat),
+	direction(DIR_CENTRE) {}
+
+void RemoteController::apply(Direction direction, bool pressed) {
+	this->direction = direction;
+	if(pressed) { fired = true; }
+}
+
+const char* RemoteController::getDescription() {
+	static const char* const names[PLAYERS] =
+		{ "Network player 1", "Network player 2", "Network player 3",
+		  "Network player 4" };
+	return names[seat];
+}
+
+Lockstep::Lockstep() : hosting(false), ours(0), peers(0), delay(DELAY),
+	difficulty(Difficulty::STANDARD), seed(0), local(NULL), tick(0),
+	broken(false) {
+
+	for(int p = 0; p < PLAYERS; p++) { seats[p] = NULL; }
+	for(int t = 0; t < WINDOW; t++)
+		{ slots[t].tick = NONE; slots[t].inputs = slots[t].hashes = 0; }
+}
+
+/* Hang up, and wait a moment for the others to: they may still need what we
+ * last sent, if they are behind, and we might lose it for them by closing with
+ * their last input unread. */
+Lockstep::~Lockstep() {
+	for(size_t c = 0; c < connections.size(); c++)
+		{ platform_hangup(connections[c].socket); }
+	const uint64_t give_up = platform_microseconds() + WAIT_MS * 1000;
+	for(size_t c = 0; c < connections.size(); c++) {
+		uint8_t drain[FRAME_BYTES * 16];
+		while(platform_receive(connections[c].socket, drain,
+			sizeof(drain), WAIT_MS / 10) >= 0
+		&& platform_microseconds() < give_up) {}
+		platform_close(connections[c].socket);
+	}
+	for(int p = 0; p < PLAYERS; p++) { delete seats[p]; }
+}
+
+bool Lockstep::host(uint16_t port, int peers, ticks_t delay,
+	Difficulty::Type difficulty, uint64_t seed) {
+
+	if(peers < 1 || peers > PLAYERS || delay < 1 || delay > MAX_DELAY) {
+		warn("Need 1 to %d players and a delay of 1 to %d ticks",
+			PLAYERS, MAX_DELAY);
+		return false;
+	}
+	hosting = true;
+	ours = 0;
+	this->peers = peers;
+	this->delay = delay;
+	this->difficulty = difficulty;
+	this->seed = seed;
+	const int listener = platform_listen(port);
+	if(listener < 0) { return false; }
+	while((int) connections.size() < peers - 1) {
+		trace("Waiting for %d more on port %u",
+			peers - 1 - (int) connections.size(), port);
+		Connection connection;
+		connection.socket = platform_accept(listener);
+		connection.filled = 0;
+		connection.gone = false;
+		if(connection.socket < 0) { platform_close(listener);
+			return false; }
+		connections.push_back(connection);
+	}
+	platform_close(listener);
+	// Everyone's here; tell them who they are, and what the game is
+	for(size_t c = 0; c < connections.size(); c++) {
+		uint8_t welcome[WELCOME_BYTES];
+		memcpy(welcome, MAGIC, sizeof(MAGIC));
+		welcome[4] = VERSION_BYTE;
+		welcome[5] = c + 1;
+		welcome[6] = peers;
+		welcome[7] = delay;
+		welcome[8] = difficulty;
+		put64(welcome + 9, seed);
+		if(!platform_send(connections[c].socket, welcome,
+			sizeof(welcome))) {
+			warn("Lost player %d before the start", (int) c + 2);
+			return false;
+		}
+	}
+	start();
+	return true;
+}
+
+bool Lockstep::join(const char* host, uint16_t port) {
+	Connection connection;
+	connection.socket = platform_connect(host, port);
+	connection.filled = 0;
+	connection.gone = false;
+	if(connection.socket < 0) { return false; }
+	connections.push_back(connection);
+	trace("Waiting for the game at %s:%u to start", host, port);
+	uint8_t welcome[WELCOME_BYTES];
+	size_t got = 0;
+	while(got < sizeof(welcome)) {
+		int read = platform_receive(connection.socket, welcome + got,
+			sizeof(welcome) - got, WAIT_MS);
+		if(read < 0) { warn("The host hung up"); return false; }
+		got += read;
+	}
+	if(memcmp(welcome, MAGIC, sizeof(MAGIC))
+	|| welcome[4] != VERSION_BYTE) {
+		warn("%s:%u isn't hosting a game we can join", host, port);
+		return false;
+	}
+	ours = welcome[5];
+	peers = welcome[6];
+	delay = welcome[7];
+	difficulty = static_cast<Difficulty::Type>(welcome[8]);
+	seed = get64(welcome + 9);
+	if(ours >= peers || peers > PLAYERS || delay < 1 || delay > MAX_DELAY
+	|| difficulty < Difficulty::FIRST || difficulty > Difficulty::LAST) {
+		warn("The host sent a game we can't play");
+		return false;
+	}
+	start();
+	return true;
+}
+
+/* Nobody has any input for the first delay ticks, so send that. */
+void Lockstep::start() {
+	trace("Playing seat %d of %d, %d ticks behind", ours + 1, peers,
+		delay);
+	for(ticks_t t = 0; t < delay; t++) {
+		Frame frame;
+		frame.tick = t;
+		frame.seat = ours;
+		frame.direction = DIR_CENTRE;
+		frame.button = 0;
+		frame.hashtick = NONE;
+		frame.hash = 0;
+		store(frame);
+		send(frame, NULL);
+	}
+}
+
+void Lockstep::seat(GameSetup& setup) {
+	setup.difficulty = difficulty;
+	for(int p = 0; p < PLAYERS; p++) {
+		PlayerSetup& player = setup.playersetup[p];
+		if(p < peers) {
+			if(!seats[p]) { seats[p] = new RemoteController(p); }
+			player.humanPlayer(seats[p]);
+		} else {
+			player.computerPlayer();
+			player.strategy = PlayerSetup::RULES;
+		}
+	}
+}
+
+uint64_t Lockstep::getSeed() const { return seed; }
+
+Lockstep::Slot& Lockstep::slot(uint32_t tick) {
+	Slot& slot = slots[tick % WINDOW];
+	if(slot.tick != tick) {
+		slot.tick = tick;
+		slot.inputs = slot.hashes = 0;
+	}
+	return slot;
+}
+
+/* Keep a seat's input, and check its hash against ours if we have both. */
+void Lockstep::store(const Frame& frame) {
+	Slot& input = slot(frame.tick);
+	input.direction[frame.seat] = frame.direction < DIR_CENTRE
+		? frame.direction : (uint8_t) DIR_CENTRE;
+	input.button[frame.seat] = frame.button;
+	input.inputs |= 1u << frame.seat;
+	if(frame.hashtick == NONE) { return; }
+	Slot& hashed = slot(frame.hashtick);
+	hashed.hash[frame.seat] = frame.hash;
+	hashed.hashes |= 1u << frame.seat;
+	const uint8_t both = (1u << ours) | (1u << frame.seat);
+	if((hashed.hashes & both) == both
+	&& hashed.hash[frame.seat] != hashed.hash[ours] && !broken) {
+		warn("Out of step with player %d as of tick %u",
+			frame.seat + 1, frame.hashtick);
+		broken = true;
+	}
+}
+
+void Lockstep::send(const Frame& frame, const Connection* except) {
+	uint8_t wire[FRAME_BYTES];
+	put32(wire, frame.tick);
+	wire[4] = frame.seat;
+	wire[5] = frame.direction;
+	wire[6] = frame.button;
+	put32(wire + 7, frame.hashtick);
+	put64(wire + 11, frame.hash);
+	for(size_t c = 0; c < connections.size(); c++) {
+		Connection& connection = connections[c];
+		if(&connection == except || connection.gone) { continue; }
+		if(!platform_send(connection.socket, wire, sizeof(wire)))
+			{ connection.gone = true; }
+	}
+}
+
+/* Read whatever frames have arrived on a connection, relaying them on if we
+ * are the host. */
+void Lockstep::receive(Connection& connection) {
+	while(!connection.gone) {
+		int read = platform_receive(connection.socket,
+			connection.buffer + connection.filled,
+			FRAME_BYTES - connection.filled, 0);
+		if(read < 0) { connection.gone = true; return; }
+		if(!read) { return; }
+		connection.filled += read;
+		if(connection.filled < FRAME_BYTES) { continue; }
+		connection.filled = 0;
+		Frame frame;
+		frame.tick = get32(connection.buffer);
+		frame.seat = connection.buffer[4];
+		frame.direction = connection.buffer[5];
+		frame.button = connection.buffer[6];
+		frame.hashtick = get32(connection.buffer + 7);
+		frame.hash = get64(connection.buffer + 11);
+		// Anything else means it isn't playing the same game
+		if(frame.seat >= peers || frame.seat == ours
+		|| frame.tick < tick || frame.tick >= tick + WINDOW / 2) {
+			warn("Another player sent nonsense; ignoring them");
+			connection.gone = true;
+			return;
+		}
+		store(frame);
+		if(hosting) { send(frame, &connection); }
+	}
+}
+
+bool Lockstep::poll() {
+	if(broken) { return false; }
+	bool gone = false;
+	for(size_t c = 0; c < connections.size(); c++) {
+		receive(connections[c]);
+		gone |= connections[c].gone;
+	}
+	const Slot& next = slots[tick % WINDOW];
+	if(next.tick == tick && next.inputs == (1u << peers) - 1)
+		{ return true; }
+	if(gone) {
+		warn("Lost touch with another player at tick %u", tick);
+		broken = true;
+	}
+	return false;
+}
+
+void Lockstep::advance(ControlManager& controlman) {
+	/* Whichever of our controllers last had its button pressed is the one
+	 * our player is using; to begin with, the first. (Presses on the
+	 * others are dropped, so they can't double up.) */
+	const std::vector<Controller*>& controllers =
+		controlman.getControllers();
+	bool pressed = false;
+	for(size_t c = 0; c < controllers.size(); c++) {
+		if(controllers[c]->hadButtonPress())
+			{ pressed = true; local = controllers[c]; }
+	}
+	if(!local && !controllers.empty()) { local = controllers[0]; }
+	Frame frame;
+	frame.tick = tick + delay;
+	frame.seat = ours;
+	frame.direction = local ? local->getDirection() : DIR_CENTRE;
+	frame.button = pressed;
+	frame.hashtick = tick ? tick - 1 : NONE;
+	frame.hash = tick ? slots[(tick - 1) % WINDOW].hash[ours] : 0;
+	store(frame);
+	send(frame, NULL);
+
+	const Slot& now = slots[tick % WINDOW];
+	for(int p = 0; p < peers; p++) {
+		seats[p]->apply(static_cast<Direction>(now.direction[p]),
+			now.button[p]);
+	}
+}
+
+void Lockstep::record(uint64_t hash) {
+	Slot& ran = slots[tick % WINDOW];
+	ran.hash[ours] = hash;
+	ran.hashes |= 1u << ours;
+	for(int p = 0; p < peers; p++) {
+		if(p != ours && (ran.hashes & (1u << p)) && ran.hash[p] != hash
+		&& !broken) {
+			warn("Out of step with player %d as of tick %u", p + 1,
+				tick);
+			broken = true;
+		}
+	}
+	tick++;
+}
+
+bool Lockstep::isBroken() const { return broken; }
+
@@ -0,0 +1,131 @@
+#ifndef LOCKSTEP_HPP_
+#define LOCKSTEP_HPP_
+#include <stdint.h>
+#include <vector>
+#include "controller.hpp"
+#include "game.hpp"
+#include "gamesetup.hpp"
+
+/** \file
+ * \brief Lockstep play between machines, sending nothing but input */
+
+/** The controller for a seat in a networked game, local or not: it reports
+ *  the input that seat's machine gave for the tick being simulated. */
+class RemoteController : public Controller {
+	int seat;
+	Direction direction;
+public:
+	explicit RemoteController(int seat);
+	/** What the seat did this tick; a press latches, as any controller's
+	 *  does, until the logic looks. */
+	void apply(Direction direction, bool pressed);
+	const char* getDescription();
+	bool hasPosition() { return false; }
+	std::pair<double, double> getPosition()
+		{ return std::make_pair(0.5, 0.5); }
+	Direction getDirection() { return direction; }
+	void feedEvent(SDL_Event& event) {}
+};
+
+/** A game played on several machines at once, each with one human seat.
+ *
+ * The logic is deterministic given the seed and the controllers' input, so
+ * the machines only need to agree on those: nobody sends game state. Each
+ * tick, each machine sends its player's input for a tick delay ticks ahead,
+ * and simulates a tick only once it has everyone's input for it. Input is
+ * thus always delay ticks late, the same for everyone, including the player
+ * at the keyboard, so that a round trip shorter than that never stalls the
+ * game. (The seats' controllers are all RemoteControllers, which report that
+ * late input.)
+ *
+ * The host takes the other machines' connections, and relays what each sends
+ * to the rest, over TCP; everyone else is connected to the host alone. The
+ * host picks the seed, difficulty and delay, and tells the others as the game
+ * starts. Seats without a machine are computers, on rules of thumb, as the
+ * planner's answers depend on how much thinking time it got.
+ *
+ * Each input also carries the sender's Zobrist hash of the last tick it
+ * simulated, which everyone else checks against their own for that tick, so
+ * a game which somehow goes out of step is caught on the tick it does. */
+class Lockstep {
+public:
+	static const uint16_t PORT = 5120;
+	static const ticks_t DELAY = 6; ///< By default; 60ms, a LAN with room
+	/// Ticks of input and hashes held at once; far more than any delay
+	static const int WINDOW = 256;
+	static const ticks_t MAX_DELAY = WINDOW / 4;
+private:
+	/** One seat's input for one tick, as sent; and the sender's hash of
+	 *  the last tick it ran, if any. */
+	struct Frame {
+		uint32_t tick;
+		uint8_t seat;
+		uint8_t direction;
+		uint8_t button;
+		uint32_t hashtick; ///< NONE if the sender hasn't run one
+		uint64_t hash;
+	};
+	static const uint32_t NONE = 0xffffffff;
+	static const size_t FRAME_BYTES = 19;
+	/** Everything known about one tick: everyone's input, and hashes. */
+	struct Slot {
+		uint32_t tick;
+		uint8_t inputs; ///< Bit per seat whose input is in
+		uint8_t direction[PLAYERS];
+		bool button[PLAYERS];
+		uint8_t hashes; ///< Bit per seat whose hash is in
+		uint64_t hash[PLAYERS];
+	};
+	struct Connection {
+		int socket;
+		uint8_t buffer[FRAME_BYTES];
+		size_t filled; ///< Of a frame, so far
+		bool gone; ///< Hung up; which only matters if input is due
+	};
+	std::vector<Connection> connections; ///< The host's to each, or ours
+	bool hosting;
+	int ours; ///< Seat
+	int peers;
+	ticks_t delay;
+	Difficulty::Type difficulty;
+	uint64_t seed;
+	RemoteController* seats[PLAYERS];
+	Controller* local; ///< Whichever of ours last pressed its button
+	Slot slots[WINDOW];
+	uint32_t tick; ///< The next to simulate
+	bool broken; ///< Out of step, or missing input from a machine gone
+
+	Slot& slot(uint32_t tick);
+	void store(const Frame& frame);
+	void send(const Frame& frame, const Connection* except);
+	void receive(Connection& connection);
+	void start();
+public:
+	Lockstep();
+	~Lockstep();
+	/** Wait for peers - 1 machines to join on the port, then start. */
+	bool host(uint16_t port, int peers, ticks_t delay,
+		Difficulty::Type difficulty, uint64_t seed);
+	/** Join the host's game, waiting until it starts. */
+	bool join(const char* host, uint16_t port);
+	/** Seat everyone: a RemoteController for each machine, and computers
+	 *  for the rest. */
+	void seat(GameSetup& setup);
+	uint64_t getSeed() const;
+	/** Take in whatever has arrived. True if everyone's input for the
+	 *  next tick is here, so that it can be simulated. (A machine which
+	 *  has hung up only breaks the game once input is due from it, so that
+	 *  those ending the game together don't trip over each other.) */
+	bool poll();
+	/** Before simulating the next tick: send our player's input for delay
+	 *  ticks on, from whichever local controller they're using, and give
+	 *  the seats their input for this one. */
+	void advance(ControlManager& controlman);
+	/** After simulating it: the hash of where it left the game. */
+	void record(uint64_t hash);
+	/** Has a machine gone, or gone out of step? (It has been warn()ed.) */
+	bool isBroken() const;
+};
+
+#endif
+
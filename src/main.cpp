@@ -1,15 +1,36 @@
 #include <memory>
+#include <thread>
+#include <ctype.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <SDL.h>
+#include "broadcast.hpp"
 #include "game.hpp"
 #include "gamelogic.hpp"
+#include "lockstep.hpp"
+#include "metrics.hpp"
+#include "planner.hpp"
 #include "platform.hpp"
+#include "tracezone.hpp"
 #include "ui.hpp"
+#include "zobrist.hpp"
 
-static const Uint32 tickduration = 10; /* ms -> 100Hz */
+static const Uint32 tickduration = 1000 / SECOND; /* ms */
+static const double thinktime = 0.5; /* s per computer player decision */
 
-static int realmain(bool fullscreen) {
+/// How to play over the network, if at all
+struct NetworkOptions {
+	int host; ///< Players to wait for, if hosting
+	const char* join; ///< Host to join, if joining
+	const char* watch; ///< Host to spectate, if spectating
+	uint16_t port; ///< Or zero for the default
+	ticks_t delay;
+	uint16_t broadcast; ///< Port to take spectators on, if any
+};
+
+static int realmain(bool fullscreen,
+	UserInterface::Presentation presentation, const char* metricsfile,
+	const char* tracefile, const NetworkOptions& network) {
 	bool run;
 	GameSetup gamesetup;
 	GameStageState gamestate;
@@ -20,9 +41,43 @@ static int realmain(bool fullscreen) {
 	UserInterface* userintf;
 	SDL_Event event;
 	Uint32 tickerror, ticklast;
+	Metrics& metrics = Metrics::global();
 
 	trace("M.E.W.L. version " VERSION " starting");
+	TraceZone::nameThread("main");
 	platform_init();
+
+	// Gather everyone before opening a window, if playing over a network
+	std::unique_ptr<Lockstep> lockstep;
+	if(network.host || network.join) {
+		lockstep.reset(new Lockstep);
+		const uint16_t port = network.port ? network.port
+			: Lockstep::PORT;
+		if(network.host ? !lockstep->host(port, network.host,
+			network.delay, Difficulty::STANDARD, random_seed())
+		: !lockstep->join(network.join, port)) {
+			warn("Unable to start a network game.");
+			die();
+		}
+	}
+	std::unique_ptr<Spectator> spectator;
+	if(network.watch) {
+		spectator.reset(new Spectator);
+		if(!spectator->connect(network.watch, network.port
+			? network.port : Broadcast::PORT)) {
+			warn("Unable to watch a game.");
+			die();
+		}
+	}
+	std::unique_ptr<Broadcast> broadcast;
+	if(network.broadcast) {
+		broadcast.reset(new Broadcast);
+		if(!broadcast->listen(network.broadcast)) {
+			warn("Unable to broadcast the game.");
+			die();
+		}
+	}
+
 	if(SDL_Init(0) < 0)
 		{ warn("Unable to initialise SDL: %s", SDL_GetError()); die(); }
 
@@ -34,6 +89,7 @@ static int realmain(bool fullscreen) {
 		SDL_Quit(); die();
 	}
 	// And initialise it
+	userintf->setPresentation(presentation);
 	if(!userintf->init(fullscreen)) {
 		warn("Unable to initialise user interface.");
 		delete userintf; SDL_Quit(); die();
@@ -50,9 +106,27 @@ static int realmain(bool fullscreen) {
 	auto controlman = std::unique_ptr<ControlManager>(new ControlManager);
 	controlman->populate();
 
+	/* Computer players think on whatever cores the main thread and the
+	 * renderer pool's preloader leave spare, and at least one. */
+	int thinkers = std::thread::hardware_concurrency() - 2;
+	auto planner = std::unique_ptr<Planner>(new Planner(
+		thinkers > 1 ? thinkers : 1, thinktime, 0, &metrics));
+
 	game = 0;
-	gamejumps = new GameLogicJumps(&game, *userintf);
-	gamelogic = GameLogic::getTitleState(gamejumps, gamestate, *controlman);
+	gamejumps = new GameLogicJumps(&game, userintf, controlman.get(),
+		planner.get());
+	if(spectator) {
+		// There's no logic; what it did comes from elsewhere
+		gamelogic = NULL;
+	} else if(lockstep) {
+		// Everyone has to agree on the setup, so skip straight past it
+		lockstep->seat(gamesetup);
+		game = new Game(gamesetup, lockstep->getSeed());
+		gamelogic = GameLogic::getNewGameState(gamejumps, gamestate);
+	} else {
+		gamelogic = GameLogic::getTitleState(gamejumps, gamestate,
+			*controlman);
+	}
 	transitionok = true;
 
 	trace("Running");
@@ -61,6 +135,7 @@ static int realmain(bool fullscreen) {
 	run = true;
 	while(run) {
 		/* Process events */
+		{ TRACE_ZONE("realmain events");
 		while(SDL_PollEvent(&event)) { switch(event.type) {
 			/* case SDL_ACTIVEEVENT:
 				if(event.active.state == SDL_APPACTIVE)
@@ -83,6 +158,12 @@ static int realmain(bool fullscreen) {
 					case SDLK_F11:
 						userintf->toggleFullscreen();
 						break;
+					case SDLK_F3:
+						userintf->toggleOverlay();
+						break;
+					case SDLK_F9:
+						userintf->toggleSmoothing();
+						break;
 					case SDLK_RETURN:
 						if(event.key.keysym.mod &
 							KMOD_ALT) { userintf->
@@ -101,7 +182,7 @@ static int realmain(bool fullscreen) {
 			case SDL_JOYBUTTONDOWN:
 			case SDL_JOYBUTTONUP:
 				controlman->feedEvent(event);
-		}}
+		}}}
 
 		/* Process the passage of time */
 		if(1) { const Uint32 now = SDL_GetTicks();
@@ -112,11 +193,46 @@ static int realmain(bool fullscreen) {
 			do {
 				tickerror -= tickduration;
 
+				/* Or, if spectating, bring the game up to
+				 * the next tick sent, if it has been. */
+				if(spectator && transitionok) {
+					GameStage::Type stage =
+						spectator->getStage();
+					if(!spectator->next(gamesetup, game,
+						gamestate)) {
+						if(spectator->isGone())
+							{ run = false; }
+						tickerror = 0;
+						break;
+					}
+					transitionok =
+						spectator->getStage() == stage;
 				/* Poke game logic to tick */
-				if(transitionok) {
+				} else if(transitionok) {
+					/* Over a network, wait until all the
+					 * input for the tick is in (dropping
+					 * the time waited), or give up. */
+					if(lockstep && !lockstep->poll()) {
+						if(lockstep->isBroken())
+							{ run = false; }
+						tickerror = 0;
+						break;
+					}
+					if(lockstep) {
+						lockstep->advance(*controlman);
+					}
 					GameLogic* nextlogic;
+					GameStage::Type stage =
+						gamelogic->getStage();
+					TRACE_ZONE("GameLogic::simulate",
+						Metrics::getStageName(stage));
+					uint64_t start =
+						platform_microseconds();
 					nextlogic = gamelogic->simulate(
 						gamesetup, game);
+					metrics.record(Metrics::SIMULATE_US,
+						stage, platform_microseconds()
+						- start);
 					if(nextlogic) {
 						delete gamelogic;
 						gamelogic = nextlogic;
@@ -126,13 +242,41 @@ static int realmain(bool fullscreen) {
 						// to react.
 						transitionok = false;
 					}
+					if(broadcast) {
+						broadcast->send(gamesetup, game,
+							gamelogic->getStage(),
+							gamestate);
+					}
+					if(lockstep && game) {
+						lockstep->record(Zobrist::hash(
+							*game,
+							gamelogic->getStage(),
+							gamestate));
+					} else if(lockstep) {
+						// The game is over
+						run = false;
+						break;
+					}
 				}
 				ticks++;
 			} while(tickerror >= tickduration);
 
+			/* Let the UI get ahead on where we're going next */
+			if(gamelogic) { userintf->anticipate(
+				gamelogic->predictNextStages(gamesetup)); }
 			/* Poke UI to render game state */
-			transitionok = userintf->render(gamelogic->getStage(),
-				gamesetup, game, gamestate, ticks);
+			GameStage::Type stage = spectator
+				? spectator->getStage() : gamelogic->getStage();
+			uint64_t start = platform_microseconds();
+			{ TRACE_ZONE("UserInterface::render",
+				Metrics::getStageName(stage));
+			transitionok = userintf->render(stage,
+				gamesetup, game, gamestate, ticks); }
+			metrics.record(Metrics::RENDER_US, stage,
+				platform_microseconds() - start);
+			metrics.record(Metrics::TICKS_PER_RENDER, stage, ticks);
+			if(ticks > 1) { metrics.record(
+				Metrics::CATCHUP_TICKS, stage, ticks); }
 		} else {
 			/* Have a nap until we actually have at least one tick
 			 * to run */
@@ -141,10 +285,13 @@ static int realmain(bool fullscreen) {
 	}
 
 	trace("Clean exit");
+	if(metricsfile) { metrics.dump(metricsfile); }
+	if(tracefile) { TraceZone::write(tracefile); }
 	controlman.reset(nullptr);
 	delete userintf;
 	delete gamelogic;
 	delete gamejumps;
+	planner.reset(nullptr);
 	if(game) { delete game; }
 	SDL_Quit();
 	return EXIT_SUCCESS;
@@ -152,16 +299,47 @@ static int realmain(bool fullscreen) {
 
 int main(int argc, char** argv) {
 	bool fullscreen = false;
+	UserInterface::Presentation presentation = UserInterface::PRESENT_AUTO;
+	const char* metricsfile = NULL;
+	const char* tracefile = NULL;
+	NetworkOptions network = { 0, NULL, NULL, 0, Lockstep::DELAY, 0 };
 	// Do all the horrible command-line processing malarky
 	for(int a = 1; a < argc; a++) {
 		const char* arg = argv[a];
 		if(0) {
 		} else if(!strcmp(arg, "-h") || !strcmp(arg, "--help")
 		       || !strcmp(arg, "/h") || !strcmp(arg, "/?")) {
-			puts("Usage: mewl [-f]\n");
+			puts("Usage: mewl [-f] [-u HOW] [-m FILE] [-t FILE] "
+				"[-H PLAYERS | -J HOST | -W HOST]\n"
+				"            [-P PORT] [-D TICKS] [-B PORT]\n");
 			puts("  -h --help       : this text");
 			puts("  -v --version    : show version information");
 			puts("  -f --fullscreen : run fullscreen");
+			puts("  -u --update     : show frames by updating what "
+				"changed (rects), by flipping");
+			puts("                    (flip), whichever was faster "
+				"here (auto, the default),");
+			puts("                    or whichever is faster, "
+				"measuring again (test)");
+			puts("  -m --metrics    : write performance metrics to "
+				"FILE on exit");
+			puts("                    (JSON if it ends .json, "
+				"else CSV)");
+			puts("  -t --trace      : write Chrome trace-event "
+				"JSON to FILE on exit");
+			puts("  -H --host       : host a network game for "
+				"PLAYERS machines");
+			puts("  -J --join       : join the network game at "
+				"HOST");
+			puts("  -W --watch      : spectate the game broadcast "
+				"from HOST");
+			puts("  -P --port       : of the network game "
+				"(default 5120) or broadcast (5121)");
+			puts("  -D --delay      : network input delay in "
+				"ticks (default 6)");
+			puts("  -B --broadcast  : take spectators on PORT");
+			puts("\nF3 toggles a performance overlay, and F9 "
+				"smooth scaling.");
 			return 0;
 		} else if(!strcmp(arg, "-v") || !strcmp(arg, "--version")) {
 			puts("M.E.W.L. version " VERSION);
@@ -169,10 +347,61 @@ int main(int argc, char** argv) {
 			return 0;
 		} else if(!strcmp(arg, "-f") || !strcmp(arg, "--fullscreen")) {
 			fullscreen = true;
+		} else if(!strcmp(arg, "-u") || !strcmp(arg, "--update")) {
+			const char* how = ++a < argc ? argv[a] : "";
+			if(!strcmp(how, "rects")) {
+				presentation = UserInterface::PRESENT_RECTS;
+			} else if(!strcmp(how, "flip")) {
+				presentation = UserInterface::PRESENT_FLIP;
+			} else if(!strcmp(how, "auto")) {
+				presentation = UserInterface::PRESENT_AUTO;
+			} else if(!strcmp(how, "test")) {
+				presentation = UserInterface::PRESENT_TEST;
+			} else {
+				warn("%s needs rects, flip, auto or test", arg);
+				return EXIT_FAILURE;
+			}
+		} else if(!strcmp(arg, "-m") || !strcmp(arg, "--metrics")) {
+			if(++a >= argc) {
+				warn("%s needs a filename", arg);
+				return EXIT_FAILURE;
+			}
+			metricsfile = argv[a];
+		} else if(!strcmp(arg, "-t") || !strcmp(arg, "--trace")) {
+			if(++a >= argc) {
+				warn("%s needs a filename", arg);
+				return EXIT_FAILURE;
+			}
+			tracefile = argv[a];
+			TraceZone::enable();
+		} else if(!strcmp(arg, "-H") || !strcmp(arg, "--host")
+		       || !strcmp(arg, "-J") || !strcmp(arg, "--join")
+		       || !strcmp(arg, "-P") || !strcmp(arg, "--port")
+		       || !strcmp(arg, "-W") || !strcmp(arg, "--watch")
+		       || !strcmp(arg, "-D") || !strcmp(arg, "--delay")
+		       || !strcmp(arg, "-B") || !strcmp(arg, "--broadcast")) {
+			if(++a >= argc) {
+				warn("%s needs a value", arg);
+				return EXIT_FAILURE;
+			}
+			switch(arg[1] == '-' ? toupper(arg[2]) : arg[1]) {
+				case 'H': network.host = atoi(argv[a]); break;
+				case 'J': network.join = argv[a]; break;
+				case 'P': network.port = atoi(argv[a]); break;
+				case 'W': network.watch = argv[a]; break;
+				case 'D': network.delay = atoi(argv[a]); break;
+				case 'B': network.broadcast = atoi(argv[a]);
+					break;
+			}
 		}
 	}
 
 	// Now do the 'real' main routine
-	return realmain(fullscreen);
+	if(!!network.host + !!network.join + !!network.watch > 1) {
+		warn("Host a network game, join one, or watch one; only one");
+		return EXIT_FAILURE;
+	}
+	return realmain(fullscreen, presentation, metricsfile, tracefile,
+		network);
 }
 
@@ -0,0 +1,224 @@
+#include "market.hpp"
+
+/* Trading speeds up as a pair keep at it, as in the original: the first unit
+ * takes a moment to change hands, and the rest come quicker and quicker. */
+static const uint8_t FIRST_WAIT   = 30; ///< Ticks, before a pair's first unit
+static const uint8_t FASTEST_WAIT = 6;  ///< Ticks, between units at best
+static const uint8_t QUICKEN      = 4;  ///< Fewer ticks for each in a row
+/// Humans can trade as much as they like, until they walk away
+static const int32_t HUMAN_LIMIT = 9999;
+static const int32_t LAND_FALL = 2; ///< Store's land price drop, per tick
+/// Longer than any land auction takes to play out among computers
+static const uint32_t LAND_TICKS = 100000;
+
+static bool selling(const Market::Book& book, int p) {
+	return !book.buyer[p] && book.traded[p] < book.limit[p]
+		&& book.units[p] > 0;
+}
+
+static bool buying(const Market::Book& book, int p) {
+	return book.buyer[p] && book.traded[p] < book.limit[p]
+		&& book.money[p] >= book.price[p];
+}
+
+static int32_t clamp(int32_t value, int32_t low, int32_t high)
+	{ return value < low ? low : value > high ? high : value; }
+
+/** Move one unit from seller to taker (either may be the store) at a price. */
+static void transfer(Market::Book& book, int seller, int taker, int32_t at) {
+	if(seller == Market::STORE) {
+		book.store--;
+		book.storesell++;
+	} else {
+		book.units[seller]--;
+		book.money[seller] += at;
+		book.traded[seller]++;
+	}
+	if(taker == Market::STORE) {
+		book.store++;
+		book.storebuy++;
+	} else {
+		book.units[taker]++;
+		book.money[taker] -= at;
+		book.traded[taker]++;
+	}
+}
+
+void Market::open(Book& book, const Game& game, const GameSetup& setup,
+	const GameStageState& state, Resource::Type resource, int32_t floor,
+	int32_t ceiling) {
+
+	book.floor = floor;
+	book.ceiling = ceiling;
+	book.store = game.store[resource];
+	book.storebuy = book.storesell = 0;
+	for(int p = 0; p < PLAYERS; p++) {
+		const int32_t surplus = state.preauction.surplus[p];
+		const bool buyer = state.auctiondeclare.buyer[p];
+		book.buyer[p] = buyer;
+		book.price[p] = buyer ? floor : ceiling;
+		book.units[p] = game.players[p].stock[resource];
+		book.money[p] = game.players[p].money;
+		book.traded[p] = 0;
+		book.reserve[p] = buyer ? ceiling : floor;
+		if(setup.playersetup[p].computer) {
+			book.limit[p] = buyer ? -surplus : surplus;
+			if(book.limit[p] < 0) { book.limit[p] = 0; }
+		} else {
+			book.limit[p] = buyer ? HUMAN_LIMIT : book.units[p];
+		}
+	}
+	book.fall = 0;
+	book.seller = book.taker = NOBODY;
+	book.wait = 0;
+	book.streak = 0;
+}
+
+void Market::openLand(Book& book, const Game& game,
+	const int32_t value[PLAYERS], int32_t floor, int32_t ceiling) {
+
+	book.floor = floor;
+	book.ceiling = ceiling;
+	book.store = 1;
+	book.storebuy = book.storesell = 0;
+	for(int p = 0; p < PLAYERS; p++) {
+		book.buyer[p] = true;
+		book.price[p] = floor;
+		book.units[p] = 0;
+		book.money[p] = game.players[p].money;
+		book.limit[p] = 1;
+		book.traded[p] = 0;
+		book.reserve[p] = value[p] < book.money[p]
+			? value[p] : book.money[p];
+	}
+	book.fall = LAND_FALL;
+	book.seller = book.taker = NOBODY;
+	book.wait = 0;
+	book.streak = 0;
+}
+
+int8_t Market::landOutcome(const Book& book, const int32_t value[PLAYERS],
+	int32_t& price) {
+
+	Book trial = book;
+	for(int p = 0; p < PLAYERS; p++) {
+		trial.reserve[p] = value[p] < trial.money[p]
+			? value[p] : trial.money[p];
+	}
+	run(trial, LAND_TICKS);
+	for(int p = 0; p < PLAYERS; p++) {
+		if(trial.traded[p]) {
+			price = book.money[p] - trial.money[p];
+			return p;
+		}
+	}
+	return NOBODY;
+}
+
+/* Computers have no patience: they head straight for their limit. For goods
+ * they walk there like anyone else; for land, where the store's price comes
+ * down to meet them, they go as fast as they can. */
+int8_t Market::computerMove(const Book& book, int player) {
+	const int32_t most = book.fall ? 127 : 1;
+	return clamp(book.reserve[player] - book.price[player], -most, most);
+}
+
+bool Market::step(Book& book, const int8_t move[PLAYERS]) {
+	bool moved = false;
+	// The store comes down until somebody meets it, if it's selling land
+	if(book.fall && book.seller != STORE && book.ceiling > book.floor) {
+		book.ceiling -= book.fall;
+		if(book.ceiling < book.floor) { book.ceiling = book.floor; }
+		moved = true;
+	}
+	// Sellers come down as far as the best bid, then buyers up to the ask
+	int32_t bid = book.floor;
+	for(int p = 0; p < PLAYERS; p++) {
+		if(buying(book, p) && book.price[p] > bid)
+			{ bid = book.price[p]; }
+	}
+	int32_t ask = book.ceiling;
+	for(int p = 0; p < PLAYERS; p++) {
+		if(!selling(book, p)) { continue; }
+		const int32_t price = clamp(book.price[p] + move[p], bid,
+			book.ceiling);
+		if(price != book.price[p])
+			{ book.price[p] = price; moved = true; }
+		if(price < ask) { ask = price; }
+	}
+	for(int p = 0; p < PLAYERS; p++) {
+		if(!buying(book, p)) { continue; }
+		const int32_t price = clamp(book.price[p] + move[p], book.floor,
+			ask);
+		if(price != book.price[p] && book.money[p] >= price)
+			{ book.price[p] = price; moved = true; }
+	}
+
+	// The best of each side; ties go to the lowest seat
+	int seller = NOBODY, taker = NOBODY;
+	for(int p = 0; p < PLAYERS; p++) {
+		if(selling(book, p) && (seller == NOBODY
+			|| book.price[p] < book.price[seller])) { seller = p; }
+		if(buying(book, p) && (taker == NOBODY
+			|| book.price[p] > book.price[taker])) { taker = p; }
+	}
+	int32_t at = 0;
+	if(seller != NOBODY && taker != NOBODY
+		&& book.price[taker] >= book.price[seller]) {
+
+		at = book.price[seller];
+	} else if(taker != NOBODY && book.price[taker] >= book.ceiling
+		&& book.store > 0) {
+
+		seller = STORE;
+		at = book.ceiling;
+	} else if(seller != NOBODY && book.price[seller] <= book.floor) {
+		taker = STORE;
+		at = book.floor;
+	} else {
+		book.seller = book.taker = NOBODY;
+		book.streak = 0;
+		return moved;
+	}
+
+	if(seller != book.seller || taker != book.taker) {
+		book.seller = seller;
+		book.taker = taker;
+		book.streak = 0;
+		book.wait = FIRST_WAIT;
+	}
+	if(--book.wait) { return true; }
+	transfer(book, seller, taker, at);
+	if(book.streak < 0xFF) { book.streak++; }
+	const int wait = FIRST_WAIT - book.streak * QUICKEN;
+	book.wait = wait < FASTEST_WAIT ? FASTEST_WAIT : wait;
+	return true;
+}
+
+uint32_t Market::run(Book& book, uint32_t ticks) {
+	int8_t move[PLAYERS];
+	uint32_t t;
+	for(t = 0; t < ticks; t++) {
+		for(int p = 0; p < PLAYERS; p++)
+			{ move[p] = computerMove(book, p); }
+		if(!step(book, move)) { break; }
+	}
+	return t;
+}
+
+void Market::apply(const Book& book, Game& game, GameStageState& state,
+	Resource::Type resource) {
+
+	// Land is handed over by the logic, as Tile ownership
+	if(resource != Resource::NONE) { game.store[resource] = book.store; }
+	for(int p = 0; p < PLAYERS; p++) {
+		if(resource != Resource::NONE)
+			{ game.players[p].stock[resource] = book.units[p]; }
+		game.players[p].money = book.money[p];
+		state.auction.bid[p] = book.price[p];
+		state.auction.traded[p] = book.traded[p];
+	}
+	state.auction.storebuy = book.storebuy;
+	state.auction.storesell = book.storesell;
+}
+
@@ -0,0 +1,90 @@
+#ifndef MARKET_HPP_
+#define MARKET_HPP_
+#include <stdint.h>
+#include "game.hpp"
+
+/** \file
+ * \brief The goods auction's trading, as a pure function of a small state */
+
+/** Matches buyers and sellers in the goods auction.
+ *
+ * Sellers start at the top of the price scale, asking the store's selling
+ * price, and buyers at the bottom, bidding its buying price. Each tick, every
+ * trader can move their price one step, but never past the best price on the
+ * other side; they meet, rather than cross. When the highest bid reaches the
+ * lowest ask, that pair trade at the ask, one unit at a time, each unit coming
+ * a little quicker than the last while the same pair keep at it. The store
+ * buys anything offered at its buying price, and sells while it has stock at
+ * its selling price, but only once no player will deal.
+ *
+ * Land is sold the same way, but by the store alone, one plot at a time, with
+ * every player a buyer. The store's price starts high and falls each tick
+ * until someone's bid meets it, and they have the plot at that price; so the
+ * clearing price is the highest that anyone will go.
+ *
+ * All of it is in a Book, which is about a hundred bytes with no pointers,
+ * and step() touches nothing else, in time linear in the players and without
+ * allocating. So the logic can step a copy of the real auction each tick, and
+ * computers looking ahead can run() whole auctions very cheaply. */
+namespace Market {
+	/// Stands in for a player index when the store is party to a trade
+	static const int8_t STORE = PLAYERS;
+	static const int8_t NOBODY = -1;
+	static const int32_t LAND_FLOOR = 160; ///< The store's least, for land
+	static const int32_t LAND_OPENING = 1000; ///< Where the store starts
+
+	struct Book {
+		int32_t floor;   ///< The store buys at this
+		int32_t ceiling; ///< The store sells at this, while it has any
+		int32_t store;   ///< Units the store has
+		int32_t storebuy;  ///< Units the store has bought, this auction
+		int32_t storesell; ///< Units the store has sold, this auction
+		int32_t price[PLAYERS]; ///< Each player's bid, or ask
+		int32_t units[PLAYERS]; ///< Of the good, held
+		int32_t money[PLAYERS];
+		int32_t limit[PLAYERS]; ///< Most units they will buy, or sell
+		int32_t traded[PLAYERS];
+		/// Computers move their price toward this, and stop there
+		int32_t reserve[PLAYERS];
+		bool buyer[PLAYERS]; ///< Else seller
+		int32_t fall; ///< The store's price drops this much per tick
+		int8_t seller; ///< Of the pair trading, or NOBODY
+		int8_t taker;  ///< The buyer of the pair trading, or NOBODY
+		uint8_t wait;   ///< Ticks until their next unit changes hands
+		uint8_t streak; ///< Units the pair have traded in a row
+	};
+
+	/** Set up the book for an auction of the resource, from the players'
+	 *  declarations and surpluses, with the store's prices. Human players
+	 *  may trade as much as they have or can afford; computers only their
+	 *  surplus, or deficit. */
+	void open(Book& book, const Game& game, const GameSetup& setup,
+		const GameStageState& state, Resource::Type resource,
+		int32_t floor, int32_t ceiling);
+	/** Set up the book to sell one plot of land, given the most each player
+	 *  would pay for it (or less, if that's all they have), and the store's
+	 *  lowest and opening prices. */
+	void openLand(Book& book, const Game& game,
+		const int32_t value[PLAYERS], int32_t floor, int32_t ceiling);
+	/** Who would win the land in the book, and at what price, if everyone
+	 *  bid up to the given values? Works on a copy, so the book can be
+	 *  reused for each set of values tried. Returns NOBODY if unsold. */
+	int8_t landOutcome(const Book& book, const int32_t value[PLAYERS],
+		int32_t& price);
+	/** How far a computer moves its price this tick; positive is up. */
+	int8_t computerMove(const Book& book, int player);
+	/** Advance one tick, with each player moving their price by move[p],
+	 *  positive for up; humans get a step of 1. Returns false if nothing
+	 *  has moved and no trade is under way; for computers, it's over. */
+	bool step(Book& book, const int8_t move[PLAYERS]);
+	/** Play the auction out for up to the given ticks, with everyone moving
+	 *  as a computer would. Returns the ticks taken. */
+	uint32_t run(Book& book, uint32_t ticks);
+	/** Write the book's holdings back into the game and auction state. For
+	 *  land (a resource of NONE), only the money. */
+	void apply(const Book& book, Game& game, GameStageState& state,
+		Resource::Type resource);
+}
+
+#endif
+
@@ -0,0 +1,143 @@
+#include <stdarg.h>
+#include <string.h>
+#include "metrics.hpp"
+#include "platform.hpp"
+
+Histogram::Histogram() : total(0), sum(0), lowest(0xffffffff), highest(0) {
+	for(int i = 0; i < BUCKETS; i++) { counts[i] = 0; }
+}
+
+int Histogram::bucketFor(uint32_t value) {
+	if(value < (uint32_t) SUB_COUNT) { return value; }
+	int top; // Position of the highest set bit
+#ifdef __GNUC__
+	top = 31 - __builtin_clz(value);
+#else
+	for(top = 31; !(value & (1u << top)); top--) {}
+#endif
+	return ((top - SUB_BITS + 1) << SUB_BITS)
+		+ ((value >> (top - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+uint32_t Histogram::bucketTop(int bucket) {
+	if(bucket < SUB_COUNT) { return bucket; }
+	int shift = (bucket >> SUB_BITS) - 1;
+	uint64_t bottom = (uint64_t) (SUB_COUNT + (bucket & (SUB_COUNT - 1)))
+		<< shift;
+	return (uint32_t) (bottom + (1ull << shift) - 1);
+}
+
+void Histogram::record(uint32_t value) {
+	counts[bucketFor(value)]++;
+	total++;
+	sum += value;
+	if(value < lowest) { lowest = value; }
+	if(value > highest) { highest = value; }
+}
+
+uint32_t Histogram::count() const { return total; }
+uint32_t Histogram::min() const { return total ? lowest : 0; }
+uint32_t Histogram::max() const { return highest; }
+double Histogram::mean() const { return total ? (double) sum / total : 0; }
+
+uint32_t Histogram::percentile(double percent) const {
+	if(!total) { return 0; }
+	uint64_t wanted = (uint64_t) ((percent / 100.0) * total + 0.5);
+	if(wanted < 1) { wanted = 1; }
+	uint64_t seen = 0;
+	for(int i = 0; i < BUCKETS; i++) {
+		seen += counts[i];
+		if(seen >= wanted) {
+			uint32_t top = bucketTop(i);
+			return top > highest ? highest : top;
+		}
+	}
+	return highest;
+}
+
+Metrics& Metrics::global() { static Metrics m; return m; }
+
+const Histogram& Metrics::get(Type metric, GameStage::Type stage) const
+	{ return histograms[metric][stage]; }
+
+void Metrics::note(const char* name, const char* fmt, ...) {
+	char value[128];
+	va_list marker;
+	va_start(marker, fmt);
+	vsnprintf(value, sizeof value, fmt, marker);
+	va_end(marker);
+	for(size_t n = 0; n < notes.size(); n++) {
+		if(notes[n].first == name) {
+			notes[n].second = value;
+			return;
+		}
+	}
+	notes.push_back(std::make_pair(std::string(name), std::string(value)));
+}
+
+const char* Metrics::getName(Type metric) {
+	switch(metric) {
+		case SIMULATE_US:      return "simulate_us";
+		case RENDER_US:        return "render_us";
+		case TICKS_PER_RENDER: return "ticks_per_render";
+		case CATCHUP_TICKS:    return "catchup_ticks";
+		case DIRTY_PIXELS:     return "dirty_pixels";
+		case UPDATE_US:        return "update_us";
+		case PLAYOUTS_PER_S:   return "playouts_per_s";
+		case METRIC_COUNT:     break;
+	}
+	return "?";
+}
+
+/* These match the node names in doc/stages.dot, not anything the UI shows. */
+static const char* stage_names[] = {
+	"title", "colour", "species", "scoreboard", "landgrab", "landauction",
+	"preauction", "auctiondeclare", "auction", "predevelop",
+	"develophuman", "wampus", "developcomp", "postdevelop", "preproduct",
+	"product", "postproduct" };
+static_assert(sizeof(stage_names) / sizeof(*stage_names) == GameStage::COUNT,
+	"Stage names out of step with GameStage");
+
+const char* Metrics::getStageName(GameStage::Type stage)
+	{ return stage_names[stage]; }
+
+bool Metrics::dump(const char* filename) const {
+	FILE* out = fopen(filename, "w");
+	if(!out) {
+		warn("Unable to write metrics to %s", filename);
+		return false;
+	}
+	const size_t len = strlen(filename);
+	const bool json = (len >= 5) && !strcmp(filename + len - 5, ".json");
+	bool first = true;
+
+	if(json) { fputs("{\"notes\": {", out); }
+	for(size_t n = 0; n < notes.size(); n++) {
+		fprintf(out, json ? "%s\n\t\"%s\": \"%s\"" : "%s# %s: %s\n",
+			json && n ? "," : "", notes[n].first.c_str(),
+			notes[n].second.c_str());
+	}
+	fputs(json ? (notes.empty() ? "},\n\"metrics\": [\n"
+		: "\n},\n\"metrics\": [\n")
+		: "metric,stage,count,min,mean,p50,p90,p99,max\n", out);
+	for(int m = 0; m < METRIC_COUNT; m++) {
+		for(int s = 0; s < GameStage::COUNT; s++) {
+			const Histogram& h = histograms[m][s];
+			if(!h.count()) { continue; }
+			fprintf(out, json ?
+	"%s\t{\"metric\": \"%s\", \"stage\": \"%s\", \"count\": %u, "
+	"\"min\": %u, \"mean\": %.2f, \"p50\": %u, \"p90\": %u, \"p99\": %u, "
+	"\"max\": %u}" : "%s%s,%s,%u,%u,%.2f,%u,%u,%u,%u\n",
+				json ? (first ? "" : ",\n") : "",
+				getName(static_cast<Type>(m)), stage_names[s],
+				h.count(), h.min(), h.mean(),
+				h.percentile(50), h.percentile(90),
+				h.percentile(99), h.max());
+			first = false;
+		}
+	}
+	if(json) { fputs("\n]}\n", out); }
+	fclose(out);
+	return true;
+}
+
@@ -0,0 +1,82 @@
+#ifndef METRICS_HPP_
+#define METRICS_HPP_
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "game.hpp"
+
+/** \file
+ * \brief Performance instrumentation */
+
+/** A fixed-size log-linear histogram, in the style of HdrHistogram. Values are
+ *  bucketed first by their highest set bit, and then linearly by the next
+ *  SUB_BITS bits below it, so every bucket is within 1/SUB_COUNT (~6%) of the
+ *  values in it, whether they're microseconds or millions of pixels. Recording
+ *  is a handful of instructions and never allocates. */
+class Histogram {
+public:
+	static const int SUB_BITS  = 4;
+	static const int SUB_COUNT = 1 << SUB_BITS;
+	static const int BUCKETS   = (32 - SUB_BITS + 1) * SUB_COUNT;
+private:
+	uint32_t counts[BUCKETS];
+	uint32_t total;
+	uint64_t sum;
+	uint32_t lowest;
+	uint32_t highest;
+	static int bucketFor(uint32_t value);
+	static uint32_t bucketTop(int bucket); ///< Highest value in bucket
+public:
+	Histogram();
+	void record(uint32_t value);
+	uint32_t count() const;
+	uint32_t min() const;
+	uint32_t max() const;
+	double mean() const;
+	/** Value at or below which the given percentage (0--100) of recorded
+	 *  values lie, to the histogram's precision. */
+	uint32_t percentile(double percent) const;
+};
+
+/** Everything we measure, split by the stage it happened in. The main loop and
+ *  UI record into the global instance; main dumps it at exit, and the UI can
+ *  show some of it as an overlay. */
+class Metrics {
+public:
+	typedef enum {
+		SIMULATE_US,      ///< Time to simulate one tick
+		RENDER_US,        ///< Time to render one frame (inc. upload)
+		TICKS_PER_RENDER, ///< Ticks simulated for each frame rendered
+		CATCHUP_TICKS,    ///< Ticks per frame, when more than one
+		DIRTY_PIXELS,     ///< Pixels sent to the screen per frame
+		UPDATE_US,        ///< Time spent in SDL_UpdateRects/SDL_Flip
+		PLAYOUTS_PER_S,   ///< Planner search rate, once per decision
+		METRIC_COUNT
+	} Type;
+private:
+	Histogram histograms[METRIC_COUNT][GameStage::COUNT];
+	/// Decided or measured once, rather than frame by frame
+	std::vector<std::pair<std::string, std::string> > notes;
+	Metrics() {}
+public:
+	static Metrics& global();
+	inline void record(Type metric, GameStage::Type stage, uint32_t value)
+		{ histograms[metric][stage].record(value); }
+	const Histogram& get(Type metric, GameStage::Type stage) const;
+	/** Set a note (printf-style), replacing any of the same name: something
+	 *  that happens once and shapes the rest, like the way frames are
+	 *  presented. */
+	void note(const char* name, const char* fmt, ...);
+	/** Write a summary of every non-empty histogram, and the notes. Format
+	 *  is JSON if the filename ends in .json, CSV otherwise, with the notes
+	 *  as "# name: value" comments before the header. Returns success. */
+	bool dump(const char* filename) const;
+	static const char* getName(Type metric);
+	/** Short lowercase name for a stage, as used in stages.dot. */
+	static const char* getStageName(GameStage::Type stage);
+};
+
+#endif
+
@@ -0,0 +1,117 @@
+#ifndef MEWL_ENV_H_
+#define MEWL_ENV_H_
+#include <stdint.h>
+#include <stdio.h>
+
+/** \file
+ * \brief C interface to the game as a learning environment
+ *
+ * For trainers written in anything that can call C, or can talk to a process
+ * that does. Link against libmewl-env.a, which has the game logic and no SDL.
+ * Each tick, the trainer gives every seat it plays the input a controller
+ * would (a direction, and whether the button was pressed), and the game
+ * advances by one tick (a hundredth of a second of game time). Seats it
+ * doesn't play are computers.
+ *
+ * Observations are written straight into a mewl_env_observation the caller
+ * owns, which has a fixed layout with no pointers, so it can sit in shared
+ * memory, or be sent down a pipe as it is; mewl_env_serve() does the latter.
+ * Nothing is allocated by observing or stepping, except by the game itself
+ * when a stage changes. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEWL_ENV_PLAYERS 4
+#define MEWL_ENV_WIDTH   9
+#define MEWL_ENV_HEIGHT  5
+/** Goods are indexed as Resource::Type: workers, food, energy, ore, crystal */
+#define MEWL_ENV_GOODS   5
+/** For directions, as the Direction type: 0 is north, going clockwise */
+#define MEWL_ENV_CENTRE  8
+
+typedef struct mewl_env mewl_env;
+
+/** One seat's input for one tick. */
+typedef struct {
+	uint8_t direction; /**< 0--7, or MEWL_ENV_CENTRE for none */
+	uint8_t button;    /**< Nonzero if pressed this tick */
+} mewl_env_action;
+
+typedef struct {
+	uint32_t tick;       /**< Since reset */
+	uint8_t stage;       /**< As GameStage::Type */
+	uint8_t month;
+	uint8_t difficulty;  /**< As Difficulty::Type */
+	uint8_t finished;    /**< Nonzero once the game is over */
+	int32_t money[MEWL_ENV_PLAYERS];
+	int32_t score[MEWL_ENV_PLAYERS]; /**< Money, land and goods */
+	int32_t stock[MEWL_ENV_PLAYERS][MEWL_ENV_GOODS];
+	int32_t store[MEWL_ENV_GOODS];
+	int32_t prices[MEWL_ENV_GOODS];
+	/* The map, by row; owner is MEWL_ENV_PLAYERS where nobody's, and
+	 * equipment is 0 there too */
+	uint8_t owner[MEWL_ENV_HEIGHT][MEWL_ENV_WIDTH];
+	uint8_t equipment[MEWL_ENV_HEIGHT][MEWL_ENV_WIDTH];
+	uint8_t mountains[MEWL_ENV_HEIGHT][MEWL_ENV_WIDTH];
+	uint8_t crystal[MEWL_ENV_HEIGHT][MEWL_ENV_WIDTH];
+	uint8_t river[MEWL_ENV_HEIGHT][MEWL_ENV_WIDTH];
+	/** The latest month's production */
+	uint8_t production[MEWL_ENV_HEIGHT][MEWL_ENV_WIDTH];
+	/* What the current stage is about; zero where it doesn't apply */
+	int8_t player;       /**< Whose turn it is, or -1 */
+	uint8_t x, y;        /**< The plot in question, or the cursor */
+	uint8_t resource;    /**< Up for auction, as Resource::Type */
+	uint8_t buyer[MEWL_ENV_PLAYERS]; /**< In the auction, else sellers */
+	int32_t bid[MEWL_ENV_PLAYERS];   /**< Or ask */
+	int32_t millis;      /**< Left on the clock, for turns and auctions */
+} mewl_env_observation;
+
+/** A game with the trainer in the seats set in the agents mask (bit 0 for the
+ *  first), at a difficulty (0 beginner, 1 standard, 2 tournament). Not
+ *  started until reset. NULL if the arguments are out of range. */
+mewl_env* mewl_env_create(int difficulty, unsigned agents);
+void mewl_env_destroy(mewl_env* env);
+/** Start a new game, which plays out the same way for the same seed and
+ *  actions. */
+void mewl_env_reset(mewl_env* env, uint64_t seed);
+/** Advance one tick with an action for each seat; those for computers' seats
+ *  are ignored. Returns zero once the game is over. */
+int mewl_env_step(mewl_env* env,
+	const mewl_env_action actions[MEWL_ENV_PLAYERS]);
+void mewl_env_observe(const mewl_env* env, mewl_env_observation* out);
+/** A 64-bit hash of the whole game state. Two runs which should match can
+ *  compare it each tick to find where they first differ. */
+uint64_t mewl_env_hash(const mewl_env* env);
+
+/** Many games at once, stepped in lockstep across threads (zero or fewer for
+ *  one per processor). Arrays passed in or out have an element per game. A
+ *  game which finishes starts a new one in its place, and is flagged done for
+ *  that step; game n in slot i is seeded with seed + i + n * count. */
+typedef struct mewl_envs mewl_envs;
+mewl_envs* mewl_envs_create(int difficulty, unsigned agents, int count,
+	int threads);
+void mewl_envs_destroy(mewl_envs* envs);
+int mewl_envs_size(const mewl_envs* envs);
+void mewl_envs_reset(mewl_envs* envs, uint64_t seed);
+/** out may be NULL, to step without observing. */
+void mewl_envs_step(mewl_envs* envs,
+	const mewl_env_action actions[][MEWL_ENV_PLAYERS], uint8_t done[],
+	mewl_env_observation out[]);
+void mewl_envs_observe(mewl_envs* envs, mewl_env_observation out[]);
+
+/** Drive the environment over a pair of streams, such as pipes to a trainer
+ *  in another process, until the input ends. Each request is a byte:
+ *  'r' and a little-endian uint64_t seed, to reset; 's' and an action for
+ *  each seat (two bytes each), to step; or 'o', to observe alone. Every
+ *  request is answered with the observation, as its raw bytes. Returns zero
+ *  at the end of input, or nonzero on a bad request or a failed write. */
+int mewl_env_serve(mewl_env* env, FILE* in, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include "computer.hpp"
+#include "gamelogic.hpp"
+#include "market.hpp"
+#include "planner.hpp"
+#include "platform.hpp"
+#include "tracezone.hpp"
+#include "valuation.hpp"
+
+static const int LAND_CHOICES = 8; ///< Best-rated plots worth a look
+/// Bids worth a look, in percent of the rules' (or the store's least)
+static const int BID_PERCENT[] = { 0, 50, 75, 100, 125, 150, 200 };
+static const int BIDS = sizeof(BID_PERCENT) / sizeof(*BID_PERCENT);
+static const double EXPLORATION = 0.7; ///< UCB1's; rewards are 0--1
+static const uint32_t MAX_TICKS = 100000; ///< For a playout; a bug if hit
+
+Planner::Choice::Choice() : x(NOWHERE), y(NOWHERE), outfit(Resource::NONE),
+	buyer(false), bid(-1) {}
+
+Planner::Request::Request(const Game& game, const GameStageState& state)
+	: game(game), state(state), count(0), speculative(false) {}
+
+Planner::Planner(int threads, double seconds, uint32_t playouts,
+	Metrics* metrics) : request(NULL), generation(0), reported(0),
+	quit(false), stop(false), playouts(0), started(0),
+	budget_us(seconds * 1e6), budget_playouts(playouts),
+	metrics(metrics), total_playouts(0), total_us(0) {
+
+	assert(seconds > 0 || playouts > 0);
+	for(int p = 0; p < PLAYERS; p++) { plans[p].valid = false; }
+#ifdef NOSDL
+	// Built without SDL, so without threads; all searches are in finish()
+	threads = 0;
+	lock = NULL;
+	changed = NULL;
+#else
+	lock = SDL_CreateMutex();
+	changed = SDL_CreateCond();
+	if(!lock || !changed) {
+		warn("Unable to create planner lock: %s", SDL_GetError());
+		die();
+	}
+#endif
+	tallies.resize(threads > 0 ? threads : 1);
+	starts.resize(tallies.size());
+#ifndef NOSDL
+	for(int w = 0; w < threads; w++) {
+		starts[w].planner = this;
+		starts[w].worker = w;
+		SDL_Thread* thread = SDL_CreateThread(threadMain, &starts[w]);
+		// Fewer threads just means fewer playouts
+		if(!thread) {
+			warn("No planner thread: %s", SDL_GetError());
+			break;
+		}
+		this->threads.push_back(thread);
+	}
+#endif
+}
+
+Planner::~Planner() {
+#ifndef NOSDL
+	SDL_LockMutex(lock);
+	quit = true;
+	stop = true;
+	SDL_CondBroadcast(changed);
+	SDL_UnlockMutex(lock);
+	for(size_t t = 0; t < threads.size(); t++)
+		{ SDL_WaitThread(threads[t], NULL); }
+	SDL_DestroyCond(changed);
+	SDL_DestroyMutex(lock);
+#endif
+	delete request;
+}
+
+/** Make the choice in a copy of the game, and play it out, returning how well
+ *  the player did: their final score as a fraction of the winner's. */
+double Planner::playout(const Request& request, const Choice& choice,
+	Random& rng) {
+
+	Game game(request.game);
+	GameStageState state(request.state);
+	GameSetup setup(request.setup);
+	game.rng = Random(rng.next());
+	const int player = request.player;
+	uint8_t x, y;
+	GameStage::Type after = GameStage::TITLE;
+	switch(request.decision) {
+		case LAND:
+			game.terrain.setOwnership(choice.x, choice.y, player,
+				Resource::NONE);
+			// Everyone still to claim does, as soon as they can
+			for(int p = 0; p < PLAYERS; p++) {
+				if(p == player || (request.claimed & (1u << p))
+				|| !Computer::chooseLand(game, p, x, y))
+					{ continue; }
+				game.terrain.setOwnership(x, y, p,
+					Resource::NONE);
+			}
+			after = GameStage::LANDGRAB;
+			break;
+		case DEVELOP:
+			if(choice.x != Choice::NOWHERE) {
+				Computer::outfit(game, player, choice.x,
+					choice.y, choice.outfit);
+			}
+			Computer::develop(game, player, x, y);
+			after = GameStage::DEVELOPCOMP;
+			break;
+		case DECLARE:
+			state.auctiondeclare.buyer[player] = choice.buyer;
+			after = GameStage::AUCTIONDECLARE;
+			break;
+		case BID:
+			state.landauction.bid[player] = choice.bid;
+			after = GameStage::LANDAUCTION;
+			break;
+	}
+
+	Game* ptrgame = &game;
+	GameLogicJumps jumps(&ptrgame, NULL, NULL);
+	GameLogic* logic =
+		GameLogic::getResumeState(&jumps, state, game, after);
+	assert(logic);
+	for(uint32_t t = 0; t < MAX_TICKS && !jumps.isFinished(); t++) {
+		GameLogic* next = logic->simulate(setup, &game);
+		if(next) { delete logic; logic = next; }
+	}
+	delete logic;
+
+	uint32_t scores[PLAYERS], best = 1;
+	for(int p = 0; p < PLAYERS; p++) {
+		scores[p] = Valuation::score(game, p);
+		if(scores[p] > best) { best = scores[p]; }
+	}
+	double reward = (double) scores[player] / best;
+	// Winning in a failed colony is worth less than losing in a good one
+	if(state.scoreboard.message == ScoreboardMessage::FAILFOOD
+	|| state.scoreboard.message == ScoreboardMessage::FAILENERGY)
+		{ reward /= 2; }
+	return reward;
+}
+
+void Planner::search(int worker, const Request& request, Tally& tally) {
+	TRACE_ZONE("Planner::search");
+	Random rng(request.seed + worker);
+	uint32_t total = 0;
+	for(int c = 0; c < request.count; c++)
+		{ tally.visits[c] = 0; tally.reward[c] = 0; }
+	if(request.count < 2) { return; } // Nothing to decide
+	while(!stop) {
+		if(budget_playouts && playouts++ >= budget_playouts) { break; }
+		if(budget_us && platform_microseconds() - started >= budget_us)
+			{ break; }
+		// UCB1; everything gets tried once before anything twice
+		int pick = 0;
+		double pickvalue = -1;
+		for(int c = 0; c < request.count; c++) {
+			if(!tally.visits[c]) { pick = c; break; }
+			double value = tally.reward[c] / tally.visits[c]
+				+ EXPLORATION * sqrt(log((double) total)
+				/ tally.visits[c]);
+			if(value > pickvalue) { pick = c; pickvalue = value; }
+		}
+		double reward = playout(request, request.choices[pick], rng);
+		tally.visits[pick]++;
+		tally.reward[pick] += reward;
+		total++;
+	}
+}
+
+int Planner::threadMain(void* thread) {
+#ifndef NOSDL
+	Planner* planner = static_cast<Thread*>(thread)->planner;
+	const int worker = static_cast<Thread*>(thread)->worker;
+	TraceZone::nameThread("planner");
+	unsigned seen = 0;
+	SDL_LockMutex(planner->lock);
+	while(!planner->quit) {
+		if(planner->generation == seen) {
+			SDL_CondWait(planner->changed, planner->lock);
+			continue;
+		}
+		seen = planner->generation;
+		const Request* request = planner->request;
+		SDL_UnlockMutex(planner->lock);
+		planner->search(worker, *request, planner->tallies[worker]);
+		SDL_LockMutex(planner->lock);
+		planner->reported++;
+		SDL_CondBroadcast(planner->changed);
+	}
+	SDL_UnlockMutex(planner->lock);
+#endif
+	return 0;
+}
+
+/** The plots the rules of thumb like best, up to LAND_CHOICES of them. */
+static int land_choices(const Game& game, int player,
+	Planner::Choice* choices) {
+
+	std::vector<std::pair<int32_t, int> > rated;
+	const Terrain& terrain = game.terrain;
+	for(uint8_t y = 0; y < terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < terrain.getSizeX(); x++) {
+			if(terrain.tile(x, y).owned()
+			|| (x == terrain.getCityX() && y == terrain.getCityY()))
+				{ continue; }
+			rated.push_back(std::make_pair(
+				-Computer::rateLand(game, player, x, y),
+				(y << 8) | x));
+		}
+	}
+	std::sort(rated.begin(), rated.end());
+	int count;
+	for(count = 0; count < (int) rated.size() && count < LAND_CHOICES;
+		count++) {
+
+		choices[count].x = rated[count].second & 0xFF;
+		choices[count].y = rated[count].second >> 8;
+	}
+	return count;
+}
+
+/** Every outfit for every idle plot, and leaving it all to the rules. */
+static int develop_choices(const Game& game, int player,
+	Planner::Choice* choices, int max) {
+
+	const Resource::Type last = Difficulty::hasCrystal(game.difficulty)
+		? Resource::CRYSTAL : Resource::ORE;
+	const Terrain& terrain = game.terrain;
+	int count = 1; // The default Choice is NOWHERE, for the rules
+	for(uint8_t y = 0; y < terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < terrain.getSizeX(); x++) {
+			const Tile& tile = terrain.tile(x, y);
+			if(!tile.owned() || tile.owner() != player
+			|| tile.equipment() != Resource::NONE) { continue; }
+			for(int r = Resource::FOOD; r <= last && count < max;
+				r++) {
+
+				choices[count].x = x;
+				choices[count].y = y;
+				choices[count].outfit =
+					static_cast<Resource::Type>(r);
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+/** Bids around the rules' value for the plot up for auction, leaving out any
+ *  which would win or lose it at the same price as one already in. */
+static int bid_choices(const Game& game, const GameStageState& state,
+	int player, Planner::Choice* choices) {
+
+	const uint8_t x = state.landauction.x, y = state.landauction.y;
+	int32_t value[PLAYERS];
+	for(int p = 0; p < PLAYERS; p++)
+		{ value[p] = Computer::valueLand(game, p, x, y); }
+	Market::Book book;
+	Market::openLand(book, game, value, Market::LAND_FLOOR,
+		Market::LAND_OPENING);
+	const int32_t base = value[player] > Market::LAND_FLOOR
+		? value[player] : Market::LAND_FLOOR;
+	int8_t winner[BIDS];
+	int32_t price[BIDS] = {0};
+	int count = 0;
+	for(int b = 0; b < BIDS; b++) {
+		value[player] = base * BID_PERCENT[b] / 100;
+		winner[count] = Market::landOutcome(book, value, price[count]);
+		bool same = false;
+		for(int c = 0; c < count && !same; c++) {
+			same = winner[c] == winner[count] && (winner[c]
+				== Market::NOBODY || price[c] == price[count]);
+		}
+		if(!same) { choices[count++].bid = value[player]; }
+	}
+	return count;
+}
+
+/** Snapshot the game, and list the choices to search. */
+Planner::Request* Planner::prepare(Decision decision, const Game& game,
+	const GameStageState& state, int player, uint32_t claimed) {
+
+	Request* request = new Request(game, state);
+	request->decision = decision;
+	request->player = player;
+	request->claimed = claimed;
+	request->setup.difficulty = game.difficulty;
+	for(int p = 0; p < PLAYERS; p++) {
+		request->setup.playersetup[p].computerPlayer();
+		request->setup.playersetup[p].strategy = PlayerSetup::RULES;
+		request->setup.playersetup[p].species =
+			game.players[p].setup.species;
+	}
+	// Derived from, but not drawn from, the game's stream
+	Random luck = game.rng;
+	request->seed = luck.next() + (player << 8) + decision;
+
+	Choice* choices = request->choices;
+	switch(decision) {
+		case LAND:
+			request->count = land_choices(game, player, choices);
+			break;
+		case DEVELOP:
+			request->count = develop_choices(game, player, choices,
+				MAX_CHOICES);
+			break;
+		case DECLARE:
+			choices[0].buyer = false;
+			choices[1].buyer = true;
+			request->count = 2;
+			break;
+		case BID:
+			request->count = bid_choices(game, state, player,
+				choices);
+			break;
+	}
+	return request;
+}
+
+void Planner::start(Decision decision, const Game& game,
+	const GameStageState& state, int player, uint32_t claimed) {
+
+	if(request) { finish(); }
+	begin(prepare(decision, game, state, player, claimed));
+}
+
+void Planner::begin(Request* request) {
+	this->request = request;
+	stop = false;
+	playouts = 0;
+	started = platform_microseconds();
+	if(threads.empty()) { return; } // All done in finish()
+#ifndef NOSDL
+	SDL_LockMutex(lock);
+	reported = 0;
+	generation++;
+	SDL_CondBroadcast(changed);
+	SDL_UnlockMutex(lock);
+#endif
+}
+
+bool Planner::busy() const { return request != NULL; }
+
+bool Planner::ready() const {
+	if(!request || threads.empty() || request->count < 2) { return true; }
+	if(budget_playouts && playouts >= budget_playouts) { return true; }
+	return budget_us && platform_microseconds() - started >= budget_us;
+}
+
+Planner::Choice Planner::finish() {
+	if(!request) { return Choice(); }
+	if(threads.empty()) {
+		search(0, *request, tallies[0]);
+	} else {
+		stop = true;
+#ifndef NOSDL
+		SDL_LockMutex(lock);
+		while(reported < (int) threads.size())
+			{ SDL_CondWait(changed, lock); }
+		SDL_UnlockMutex(lock);
+#endif
+	}
+	const uint64_t us = platform_microseconds() - started;
+
+	// The most tried is the most trusted
+	const int workers = threads.empty() ? 1 : threads.size();
+	uint32_t searched = 0, bestvisits = 0;
+	double bestreward = 0;
+	int best = 0;
+	for(int c = 0; c < request->count; c++) {
+		uint32_t visits = 0;
+		double reward = 0;
+		for(int w = 0; w < workers; w++) {
+			visits += tallies[w].visits[c];
+			reward += tallies[w].reward[c];
+		}
+		searched += visits;
+		if(visits > bestvisits
+		|| (visits == bestvisits && reward > bestreward)) {
+			best = c;
+			bestvisits = visits;
+			bestreward = reward;
+		}
+	}
+	total_playouts += searched;
+	total_us += us;
+	if(metrics && searched && us) {
+		/* Under the stage it ran in; a speculation runs while the
+		 * humans take their turns. */
+		static const GameStage::Type stages[] = { GameStage::LANDGRAB,
+			GameStage::DEVELOPCOMP, GameStage::AUCTIONDECLARE,
+			GameStage::LANDAUCTION };
+		const GameStage::Type stage = request->speculative
+			? GameStage::DEVELOPHUMAN : stages[request->decision];
+		metrics->record(Metrics::PLAYOUTS_PER_S, stage,
+			searched * 1000000ull / us);
+	}
+
+	Choice answer = request->count ? request->choices[best] : Choice();
+	if(request->speculative) {
+		Plan& plan = plans[request->player];
+		plan.valid = true;
+		plan.key = developKey(request->game, request->player);
+		plan.choice = answer;
+	}
+	delete request;
+	request = NULL;
+	return answer;
+}
+
+uint64_t Planner::getPlayouts() const { return total_playouts; }
+
+double Planner::getSeconds() const { return total_us / 1e6; }
+
+/** Mix what a development decision depends on into a hash: the month, which
+ *  of the player's plots are idle, and the terms on which workers are sold. */
+uint64_t Planner::developKey(const Game& game, int player) {
+	uint64_t key = 14695981039346656037ull; // FNV-1a
+	const uint64_t prime = 1099511628211ull;
+	key = (key ^ game.month) * prime;
+	key = (key ^ game.prices.workers) * prime;
+	key = (key ^ (game.store.workers > 0)) * prime;
+	for(uint8_t y = 0; y < game.terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < game.terrain.getSizeX(); x++) {
+			const Tile& tile = game.terrain.tile(x, y);
+			if(!tile.owned() || tile.owner() != player)
+				{ continue; }
+			key = (key ^ ((y << 8) | x)) * prime;
+			key = (key ^ tile.equipment()) * prime;
+		}
+	}
+	return key;
+}
+
+bool Planner::speculate(const Game& game, const GameStageState& state,
+	int player) {
+
+	if(request || threads.empty()) { return false; }
+	Request* speculation = prepare(DEVELOP, game, state, player);
+	speculation->speculative = true;
+	/* Playouts carry on from the end of the player's turn, so make it
+	 * theirs. (Turns between now and then are skipped; close enough.) */
+	speculation->state.developcomp.player = player;
+	begin(speculation);
+	return true;
+}
+
+bool Planner::hasPlan(const Game& game, int player) const {
+	return plans[player].valid
+		&& plans[player].key == developKey(game, player);
+}
+
+bool Planner::recall(const Game& game, int player, Choice& choice) {
+	const bool good = hasPlan(game, player);
+	plans[player].valid = false;
+	if(!good) { return false; }
+	choice = plans[player].choice;
+	if(choice.x == Choice::NOWHERE) { return true; }
+	// The player may have spent money since; the rest is in the key
+	return (int32_t) game.players[player].money >= game.prices.workers
+		+ Resource::getOutfitCost(choice.outfit);
+}
@@ -0,0 +1,164 @@
+#ifndef PLANNER_HPP_
+#define PLANNER_HPP_
+#include <atomic>
+#include <vector>
+#ifdef NOSDL
+// Only ever NULL or empty, with no threads (see the Planner constructor)
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+#else
+# include <SDL.h>
+#endif
+#include "game.hpp"
+#include "metrics.hpp"
+
+/** \file
+ * \brief Search-based decisions for computer players */
+
+/** Decides for computer players by flat Monte Carlo search.
+ *
+ * Each candidate choice is tried by cloning the Game, making it, and playing
+ * the rest of the game out with every seat on rules of thumb. Choices are
+ * picked for trial by UCB1, so the promising ones get most of the playouts,
+ * and the one tried most when the search stops is the answer. There is no
+ * tree: only the one decision is searched, a bandit over its choices, and
+ * everything after it is left to the rules. Worker threads each keep their
+ * own tally of the choices, and are summed at the end, so they never wait on
+ * each other.
+ *
+ * For a land auction, the choices are how high to go: nothing, or a spread
+ * around what the rules of thumb would pay. Those which would come to the
+ * same thing, against everyone else on the rules (see Market::landOutcome),
+ * are only tried once. In the goods auctions, the Planner only decides
+ * whether to buy or sell; the prices are still the rules'.
+ *
+ * The logic start()s a search, then polls ready() once per tick until the
+ * time or playout budget is spent, and collects the answer with finish(). It
+ * can finish() early, whenever it likes, and gets the best answer so far. So
+ * the simulation never waits on the search for more than one playout.
+ *
+ * With no threads, finish() does the whole search there and then, on the
+ * calling thread. That's for the batch runner, which already has a thread per
+ * core, and wants the same answer every time from the same seed.
+ *
+ * While humans take their development turns, the threads would otherwise sit
+ * idle, so the logic can have them speculate() about the computers' turns to
+ * come. Those answers are kept until the turn arrives, when recall() hands one
+ * over if nothing it depends on has changed since: which of the computer's
+ * plots are idle, and whether it can still buy the worker it chose. Anything
+ * else the human does only shifts the odds the playouts found, and is not
+ * worth thinking again for.
+ *
+ * One search at a time; all methods are for the logic's thread. */
+class Planner {
+public:
+	typedef enum {
+		LAND,    ///< Which plot to claim in the land grab
+		DEVELOP, ///< Which idle plot to outfit first, and for what
+		DECLARE, ///< Whether to buy or sell in an auction
+		BID      ///< How high to go for the plot in a land auction
+	} Decision;
+	/** An answer. Only the fields for the decision are meaningful. */
+	struct Choice {
+		Choice();
+		/// For x, to leave it to the rules of thumb
+		static const uint8_t NOWHERE = 0xFF;
+		uint8_t x;
+		uint8_t y;
+		Resource::Type outfit;
+		bool buyer;
+		int32_t bid; ///< The most to pay; negative for the rules' say
+	};
+private:
+	static const int MAX_CHOICES = 64;
+	/// What is being searched; a snapshot, so the real game can carry on
+	struct Request {
+		Decision decision;
+		int player;
+		uint32_t claimed; ///< Bit per player with land this month
+		Game game;
+		GameStageState state;
+		GameSetup setup; ///< All computers, all on rules
+		Choice choices[MAX_CHOICES];
+		int count;
+		uint64_t seed;
+		bool speculative; ///< Keep the answer for recall()
+		Request(const Game& game, const GameStageState& state);
+	};
+	/// A speculative development answer, and what it was worked out for
+	struct Plan {
+		bool valid;
+		uint64_t key; ///< developKey() at the time
+		Choice choice;
+	};
+	Plan plans[PLAYERS];
+	/// One worker's statistics for each choice
+	struct Tally {
+		uint32_t visits[MAX_CHOICES];
+		double reward[MAX_CHOICES]; ///< Total over visits
+	};
+	/// What each thread is started with
+	struct Thread { Planner* planner; int worker; };
+	std::vector<Thread> starts;
+	std::vector<SDL_Thread*> threads;
+	std::vector<Tally> tallies;
+	Request* request; ///< NULL if not searching
+	unsigned generation; ///< Bumped for each start()
+	int reported; ///< Workers finished with this generation
+	bool quit;
+	std::atomic<bool> stop;
+	std::atomic<uint32_t> playouts; ///< This search, so far
+	SDL_mutex* lock; ///< Guards everything not atomic
+	SDL_cond* changed;
+	uint64_t started; ///< platform_microseconds() at start()
+	const uint64_t budget_us; ///< Zero for none
+	const uint32_t budget_playouts; ///< Zero for none
+	Metrics* metrics;
+	uint64_t total_playouts;
+	uint64_t total_us;
+
+	void search(int worker, const Request& request, Tally& tally);
+	Request* prepare(Decision decision, const Game& game,
+		const GameStageState& state, int player, uint32_t claimed = 0);
+	void begin(Request* request);
+	static uint64_t developKey(const Game& game, int player);
+	static double playout(const Request& request, const Choice& choice,
+		Random& rng);
+	static int threadMain(void* thread);
+public:
+	/** Budgets are per search, and zero for no limit; at least one must be
+	 *  set. Playouts are recorded as PLAYOUTS_PER_S into metrics, if not
+	 *  NULL, so only use the global instance from the main thread. */
+	Planner(int threads, double seconds, uint32_t playouts,
+		Metrics* metrics);
+	~Planner();
+	/** Begin searching for a player's decision. Any search still going is
+	 *  abandoned. For LAND, claimed has a bit set for each player who
+	 *  already has their plot this month. */
+	void start(Decision decision, const Game& game,
+		const GameStageState& state, int player, uint32_t claimed = 0);
+	/** Is there a search going? */
+	bool busy() const;
+	/** Has the search used up its budget? */
+	bool ready() const;
+	/** Stop searching, and return the best choice found. */
+	Choice finish();
+	/** If the threads are free, start searching for the player's next
+	 *  DEVELOP decision, from the game as it is now. Returns whether it
+	 *  started. finish() the search as usual, but the answer is also kept,
+	 *  for recall(). start() cuts it short (keeping what it has so far). */
+	bool speculate(const Game& game, const GameStageState& state,
+		int player);
+	/** Is there a speculative answer for the player that's still good? */
+	bool hasPlan(const Game& game, int player) const;
+	/** Take the speculative answer for the player's DEVELOP decision, if
+	 *  it's still good. Either way, it's used up. */
+	bool recall(const Game& game, int player, Choice& choice);
+	/** Totals over every search so far. */
+	uint64_t getPlayouts() const;
+	double getSeconds() const;
+};
+
+#endif
+
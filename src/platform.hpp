@@ -1,5 +1,7 @@
 #ifndef PLATFORM_HPP_
 #define PLATFORM_HPP_
+#include <stddef.h>
+#include <stdint.h>
 
 /** \file
  * \brief Platform-specific utility methods */
@@ -33,5 +35,38 @@ double platform_random();
 /// Calculate the error function (this is in C99 as erf()).
 double platform_erf(double x);
 
+/** A monotonic clock in microseconds, for measuring, not telling, the time.
+ *  (SDL_GetTicks is only good to the millisecond, and wants SDL.) */
+uint64_t platform_microseconds();
+
+/** Where to keep a file of ours between runs (a cache, say), by name: in the
+ *  user's settings directory, which is made if it isn't there. False if there
+ *  is nowhere, or the path won't fit. */
+bool platform_statefile(const char* name, char* path, size_t size);
+
+/* Plain TCP streams, for lockstep play between machines and for spectators.
+ * Sockets are handles, or -1 on failure, having warn()ed why. */
+/// Listen on all interfaces.
+int platform_listen(uint16_t port);
+/// Wait for someone to connect.
+int platform_accept(int listener);
+int platform_connect(const char* host, uint16_t port);
+/// Send all of it, waiting if needs be. False if the connection is gone.
+bool platform_send(int socket, const void* data, size_t size);
+/** Send as much as will go without waiting, which may be none of it. Returns
+ *  how much went, or -1 if the connection is gone. */
+int platform_offer(int socket, const void* data, size_t size);
+/** Is there anything to read, or on a listener anyone to accept? Waits up to
+ *  ms to see. */
+bool platform_ready(int socket, int ms);
+/** Read up to size of whatever has arrived, or wait up to ms for something
+ *  to. Returns how much was read (maybe zero), or -1 if the connection is
+ *  gone. */
+int platform_receive(int socket, void* buffer, size_t size, int ms);
+/** Stop sending, so the other end can see that everything sent has arrived.
+ *  (Closing with their data unread instead may lose them what we sent.) */
+void platform_hangup(int socket);
+void platform_close(int socket);
+
 #endif
 
@@ -3,6 +3,15 @@
 #include <stdio.h>
 #include <math.h>
 #include <time.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include "platform.hpp"
 
 #ifndef RANDOM_MAX
@@ -27,9 +36,142 @@ double platform_random() {
 	return ((double) random()) / RANDOM_MAX;
 }
 
+uint64_t platform_microseconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t) now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
 double platform_erf(double x) {
 	/* We shall somewhat dubiously assume here that 'POSIX' also means
 	 * 'compiling with GCC (so does C99)' or 'smells like BSD'. */
 	return erf(x);
 }
 
+/* $XDG_CONFIG_HOME/mewl, or ~/.config/mewl; making .config too, if need be,
+ * on a fresh account. */
+bool platform_statefile(const char* name, char* path, size_t size) {
+	const char* config = getenv("XDG_CONFIG_HOME");
+	const char* home = getenv("HOME");
+	const bool xdg = config && *config;
+	int len;
+	if(xdg) {
+		len = snprintf(path, size, "%s/mewl", config);
+	} else if(home && *home) {
+		len = snprintf(path, size, "%s/.config/mewl", home);
+	} else {
+		return false;
+	}
+	if(len < 0 || (size_t) len >= size) { return false; }
+	if(!xdg) {
+		char* slash = strrchr(path, '/');
+		*slash = '\0';
+		mkdir(path, 0777);
+		*slash = '/';
+	}
+	if(mkdir(path, 0777) < 0 && errno != EEXIST) { return false; }
+	len = snprintf(path + len, size - len, "/%s", name) + len;
+	return len >= 0 && (size_t) len < size;
+}
+
+/// Lockstep sends a few bytes a tick, which mustn't wait to be batched up
+static void nodelay(int socket) {
+	int on = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+int platform_listen(uint16_t port) {
+	int listener = socket(AF_INET6, SOCK_STREAM, 0);
+	if(listener < 0) { warn("Unable to listen: %s", strerror(errno));
+		return -1; }
+	int on = 1, off = 0;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	// Take IPv4 as well, where the system allows
+	setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+	struct sockaddr_in6 address;
+	memset(&address, 0, sizeof(address));
+	address.sin6_family = AF_INET6;
+	address.sin6_addr = in6addr_any;
+	address.sin6_port = htons(port);
+	if(bind(listener, (struct sockaddr*) &address, sizeof(address)) < 0
+	|| listen(listener, 4) < 0) {
+		warn("Unable to listen on port %u: %s", port, strerror(errno));
+		close(listener);
+		return -1;
+	}
+	return listener;
+}
+
+int platform_accept(int listener) {
+	int socket;
+	do { socket = accept(listener, NULL, NULL); }
+	while(socket < 0 && errno == EINTR);
+	if(socket < 0) { warn("Unable to accept: %s", strerror(errno));
+		return -1; }
+	nodelay(socket);
+	return socket;
+}
+
+int platform_connect(const char* host, uint16_t port) {
+	struct addrinfo hints, *found;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	char service[8];
+	snprintf(service, sizeof(service), "%u", port);
+	int error = getaddrinfo(host, service, &hints, &found);
+	if(error) { warn("Unable to find %s: %s", host, gai_strerror(error));
+		return -1; }
+	int connected = -1;
+	for(struct addrinfo* a = found; a && connected < 0; a = a->ai_next) {
+		connected = socket(a->ai_family, a->ai_socktype,
+			a->ai_protocol);
+		if(connected < 0) { continue; }
+		if(connect(connected, a->ai_addr, a->ai_addrlen) < 0)
+			{ close(connected); connected = -1; }
+	}
+	freeaddrinfo(found);
+	if(connected < 0) { warn("Unable to connect to %s:%u: %s", host,
+		port, strerror(errno)); return -1; }
+	nodelay(connected);
+	return connected;
+}
+
+bool platform_send(int socket, const void* data, size_t size) {
+	const char* next = static_cast<const char*>(data);
+	while(size) {
+		ssize_t sent = send(socket, next, size, MSG_NOSIGNAL);
+		if(sent < 0 && errno == EINTR) { continue; }
+		if(sent <= 0) { return false; }
+		next += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+int platform_offer(int socket, const void* data, size_t size) {
+	ssize_t sent = send(socket, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if(sent < 0 && (errno == EINTR || errno == EAGAIN
+		|| errno == EWOULDBLOCK)) { return 0; }
+	return sent >= 0 ? sent : -1;
+}
+
+bool platform_ready(int socket, int ms) {
+	struct pollfd wait = { socket, POLLIN, 0 };
+	return poll(&wait, 1, ms) > 0;
+}
+
+int platform_receive(int socket, void* buffer, size_t size, int ms) {
+	struct pollfd wait = { socket, POLLIN, 0 };
+	int ready = poll(&wait, 1, ms);
+	if(ready < 0) { return errno == EINTR ? 0 : -1; }
+	if(!ready) { return 0; }
+	ssize_t got = recv(socket, buffer, size, 0);
+	if(got < 0 && (errno == EINTR || errno == EAGAIN)) { return 0; }
+	return got > 0 ? got : -1; // Zero is the other end hanging up
+}
+
+void platform_hangup(int socket) { shutdown(socket, SHUT_WR); }
+
+void platform_close(int socket) { close(socket); }
+
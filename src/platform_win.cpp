@@ -3,6 +3,9 @@
 #include <stdarg.h>
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
 #include "platform.hpp"
 
@@ -43,3 +46,137 @@ double platform_random() {
  * get stdint, it provides a fancy-pants templated version of erf().
  * For now, we just try math.h and erf(), as this works for Dev-C++. */
 double platform_erf(double x) {	return erf(x); }
+
+uint64_t platform_microseconds() {
+	static LARGE_INTEGER frequency = {{0, 0}};
+	LARGE_INTEGER now;
+	if(!frequency.QuadPart) { QueryPerformanceFrequency(&frequency); }
+	QueryPerformanceCounter(&now);
+	return (uint64_t) ((now.QuadPart * 1000000.0) / frequency.QuadPart);
+}
+
+/* %APPDATA%\mewl */
+bool platform_statefile(const char* name, char* path, size_t size) {
+	const char* appdata = getenv("APPDATA");
+	if(!appdata || !*appdata) { return false; }
+	int len = snprintf(path, size, "%s\\mewl", appdata);
+	if(len < 0 || (size_t) len >= size) { return false; }
+	if(!CreateDirectory(path, NULL)
+		&& GetLastError() != ERROR_ALREADY_EXISTS) { return false; }
+	len = snprintf(path + len, size - len, "\\%s", name) + len;
+	return len >= 0 && (size_t) len < size;
+}
+
+/* Winsock, which wants starting before use. Its handles are pointer-sized,
+ * but in practice small; they fit an int. */
+static bool winsock() {
+	static bool started = false;
+	if(!started) {
+		WSADATA data;
+		started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		if(!started) { warn("Unable to start Winsock"); }
+	}
+	return started;
+}
+
+static void nodelay(SOCKET socket) {
+	BOOL on = TRUE;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*) &on,
+		sizeof(on));
+}
+
+int platform_listen(uint16_t port) {
+	if(!winsock()) { return -1; }
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+	if(listener == INVALID_SOCKET) { warn("Unable to listen (%d)",
+		WSAGetLastError()); return -1; }
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if(bind(listener, (struct sockaddr*) &address, sizeof(address))
+	|| listen(listener, 4)) {
+		warn("Unable to listen on port %u (%d)", port,
+			WSAGetLastError());
+		closesocket(listener);
+		return -1;
+	}
+	return (int) listener;
+}
+
+int platform_accept(int listener) {
+	SOCKET socket = accept((SOCKET) listener, NULL, NULL);
+	if(socket == INVALID_SOCKET) { warn("Unable to accept (%d)",
+		WSAGetLastError()); return -1; }
+	nodelay(socket);
+	return (int) socket;
+}
+
+int platform_connect(const char* host, uint16_t port) {
+	if(!winsock()) { return -1; }
+	struct hostent* found = gethostbyname(host);
+	if(!found) { warn("Unable to find %s (%d)", host, WSAGetLastError());
+		return -1; }
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	memcpy(&address.sin_addr, found->h_addr, sizeof(address.sin_addr));
+	address.sin_port = htons(port);
+	SOCKET connected = socket(AF_INET, SOCK_STREAM, 0);
+	if(connected == INVALID_SOCKET || connect(connected,
+		(struct sockaddr*) &address, sizeof(address))) {
+		warn("Unable to connect to %s:%u (%d)", host, port,
+			WSAGetLastError());
+		if(connected != INVALID_SOCKET) { closesocket(connected); }
+		return -1;
+	}
+	nodelay(connected);
+	return (int) connected;
+}
+
+bool platform_send(int socket, const void* data, size_t size) {
+	const char* next = static_cast<const char*>(data);
+	while(size) {
+		int sent = send((SOCKET) socket, next, size, 0);
+		if(sent <= 0) { return false; }
+		next += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+int platform_offer(int socket, const void* data, size_t size) {
+	// Nonblocking just for this; Winsock has no flag to send() for it
+	u_long on = 1, off = 0;
+	ioctlsocket((SOCKET) socket, FIONBIO, &on);
+	int sent = send((SOCKET) socket, (const char*) data, size, 0);
+	const bool full = sent < 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+	ioctlsocket((SOCKET) socket, FIONBIO, &off);
+	if(full) { return 0; }
+	return sent >= 0 ? sent : -1;
+}
+
+bool platform_ready(int socket, int ms) {
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET((SOCKET) socket, &readable);
+	struct timeval wait = { ms / 1000, (ms % 1000) * 1000 };
+	return select(0, &readable, NULL, NULL, &wait) > 0;
+}
+
+int platform_receive(int socket, void* buffer, size_t size, int ms) {
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET((SOCKET) socket, &readable);
+	struct timeval wait = { ms / 1000, (ms % 1000) * 1000 };
+	int ready = select(0, &readable, NULL, NULL, &wait);
+	if(ready < 0) { return -1; }
+	if(!ready) { return 0; }
+	int got = recv((SOCKET) socket, (char*) buffer, size, 0);
+	return got > 0 ? got : -1; // Zero is the other end hanging up
+}
+
+void platform_hangup(int socket) { shutdown((SOCKET) socket, SD_SEND); }
+
+void platform_close(int socket) { closesocket((SOCKET) socket); }
@@ -1,125 +1,134 @@
-#include "playerevent.hpp"
-#include "game.hpp"
-
-// Calculate the round-dependent multiplier on some event magnitudes.
-static int multiplier(const Game& game) { return 25 * ((game.month / 4) + 1); }
-
-bool PlayerEvent::good(PlayerEvent::Type self) { return self < FIRST_BAD; }
-
-bool PlayerEvent::precondition(PlayerEvent::Type self, int player,
-	const Game& game) {
-
-	Stock select;
-	switch(self) {
-		case MULE_WINNINGS_1:
-		case MULE_WINNINGS_2:
-		case MULE_COST: // At least one exploitation (non-None land)
-			select.food = 1; select.energy  = 1;
-			select.ore  = 1; select.crystal = 1;
-			return countTilesOfType(game, player, select);
-		case AGRICULTURE_GRANT: // At least one food exploitation
-			select.food = 1;
-			return countTilesOfType(game, player, select);
-		case EXTRA_LAND: // At least one unowned land
-			{int freeland =
-				(game.terrain.getSizeX() *
-				 game.terrain.getSizeY()) - 1; // not city!
-			select.food = 1; select.energy  = 1;
-			select.ore  = 1; select.crystal = 1; select.workers = 1;
-			freeland -= countTilesOfType(game, player, select);
-			return freeland;}
-		case MULE_MINING_COST: // At least one ore or crystal tile
-			select.ore  = 1; select.crystal = 1;
-			return countTilesOfType(game, player, select);
-		case MULE_SOLAR_COST: // At least one energy exploitation
-			select.energy = 1;
-			return countTilesOfType(game, player, select);
-		case LOST_LAND: // At least one plot of land owned
-			select.food = 1; select.energy  = 1;
-			select.ore  = 1; select.crystal = 1; select.workers = 1;
-			return countTilesOfType(game, player, select);
-		default: return true; // Nothing stopping it
-	}
-}
-	
-Stock PlayerEvent::changes(PlayerEvent::Type self, int player, const Game& game,
-	int32_t* money, uint16_t* each) {
-
-	Stock select;
-	Stock change;
-	*money = 0;
-	*each = 0;
-	switch(self) {
-		case CARE_PACKAGE:
-			change.food = 3; change.energy = 2; break;
-		case WANDERING_TRAVELLER:
-			change.ore = 2; break;
-		case MULE_WINNINGS_1:
-			*money = 2 * multiplier(game); break;
-		case MULE_WINNINGS_2:
-			*money = 4 * multiplier(game); break;
-		case AGRICULTURE_GRANT:
-			*each  = 2 * multiplier(game);
-			select.food = 1;
-			*money = *each * countTilesOfType(game, player, select);
-			break;
-		case WINNINGS_1:
-			*money = 4 * multiplier(game); break;
-		case WINNINGS_2:
-			*money = 8 * multiplier(game); break;
-		case WINNINGS_3:
-			*money = 2 * multiplier(game); break;
-		case WINNINGS_4:
-			*money = 3 * multiplier(game); break;
-		case WINNINGS_5:
-			*money = 6 * multiplier(game); break;
-		case WINNINGS_6:
-			*money = 4 * multiplier(game); break;
-		case WINNINGS_7:
-			*money = 2 * multiplier(game); break;
-		case EXTRA_LAND: break; // Only has side-effects
-		case FOOD_STOLEN:
-			// TWEAK Does this round up?
-			change.food = -(game.players[player].stock.food / 2);
-			break;
-		case MULE_COST:
-			*money = -3 * multiplier(game); break;
-		case MULE_MINING_COST:
-			*each  =  2 * multiplier(game);
-			select.ore = 1; select.crystal = 1;
-			*money = -1 * *each *
-				countTilesOfType(game, player, select);
-			break;
-		case MULE_SOLAR_COST:
-			*each = multiplier(game);
-			select.energy = 1;
-			*money = -1 * *each *
-				countTilesOfType(game, player, select);
-			break;
-		case LOSSES_1:
-			*money = -6 * multiplier(game); break;
-		case LOSSES_2:
-			*money = -4 * multiplier(game); break;
-		case LOSSES_3:
-			*money = -4 * multiplier(game); break;
-		case LOSSES_4:
-			*money = -4 * multiplier(game); break;
-		case LOST_LAND: break; // Only has side-effects
-	}
-	return change;
-}
-
-void PlayerEvent::applyOther(PlayerEvent::Type self, int player, Game& game) {
-	switch(self) {
-		case EXTRA_LAND:
-			// TODO find an empty land and assign it to player
-			break;
-		case LOST_LAND:
-			/* TWEAK Supposedly, this should be the most recent land
-			 * the player got, but we don't track that---they lose a
-			 * random one. This shouldn't matter too much. */
-			// TODO find a player's land and remove it from player
-			break;
-		default: break; // NOP
-	}
-}
+#include "playerevent.hpp"
+#include "game.hpp"
+
+// Calculate the round-dependent multiplier on some event magnitudes.
+static int multiplier(const Game& game) { return 25 * ((game.month / 4) + 1); }
+
+/** The countTilesOfType selection for a mask of plot kinds. */
+static Stock kinds(uint8_t mask) {
+	Stock select;
+	for(int r = Resource::NONE; r <= Resource::CRYSTAL; r++) {
+		Resource::Type resource = static_cast<Resource::Type>(r);
+		select[resource] = (mask >> r) & 1;
+	}
+	return select;
+}
+
+bool PlayerEvent::precondition(PlayerEvent::Type self, int player,
+	const Game& game) {
+
+	const Effect& effect = EFFECTS[self];
+	if(effect.needs & FREE) { // At least one unowned land
+		const int freeland = (game.terrain.getSizeX() *
+			game.terrain.getSizeY()) - 1; // not city!
+		return freeland - countTilesOfType(game, player, kinds(ANY));
+	}
+	return !effect.needs
+		|| countTilesOfType(game, player, kinds(effect.needs));
+}
+
+uint32_t PlayerEvent::eligible(int player, const Game& game) {
+	uint8_t have = 0; // Kinds of plot the player has
+	int owned = 0;
+	for(uint8_t y = 0; y < game.terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < game.terrain.getSizeX(); x++) {
+			const Tile& tile = game.terrain.tile(x, y);
+			if(!tile.owned() || tile.owner() != player)
+				{ continue; }
+			have |= 1 << tile.equipment();
+			owned++;
+		}
+	}
+	const int freeland = (game.terrain.getSizeX() *
+		game.terrain.getSizeY()) - 1 - owned;
+	uint32_t mask = 0;
+	for(int e = MINIMUM; e <= MAXIMUM; e++) {
+		const uint8_t needs = EFFECTS[e].needs;
+		if(needs & FREE ? freeland > 0 : !needs || (needs & have))
+			{ mask |= 1u << e; }
+	}
+	return mask;
+}
+
+/// Every event is as likely as any other
+static Sampler make_sampler() {
+	uint16_t weight[PlayerEvent::MAXIMUM + 1];
+	for(int e = PlayerEvent::MINIMUM; e <= PlayerEvent::MAXIMUM; e++)
+		{ weight[e] = 1; }
+	return Sampler(weight, PlayerEvent::MAXIMUM + 1);
+}
+
+bool PlayerEvent::choose(uint32_t allowed, Random& rng,
+	PlayerEvent::Type& event) {
+
+	static const Sampler sampler = make_sampler();
+	const int e = sampler.sample(rng, allowed);
+	if(e < 0) { return false; }
+	event = static_cast<PlayerEvent::Type>(e);
+	return true;
+}
+
+Stock PlayerEvent::changes(PlayerEvent::Type self, int player, const Game& game,
+	int32_t* money, uint16_t* each) {
+
+	const Effect& effect = EFFECTS[self];
+	Stock change;
+	change.food = effect.halvefood
+		? -(game.players[player].stock.food / 2) : effect.food;
+	change.energy = effect.energy;
+	change.ore = effect.ore;
+	*money = effect.money * multiplier(game);
+	*each = 0;
+	if(effect.plots) {
+		*each = (effect.money < 0 ? -effect.money : effect.money)
+			* multiplier(game);
+		*money *= countTilesOfType(game, player, kinds(effect.plots));
+	}
+	return change;
+}
+
+/// Is the plot, other than the town, the player's (or no one's if negative)?
+static bool fits(const Terrain& terrain, int i, int player) {
+	const uint8_t x = i % terrain.getSizeX(), y = i / terrain.getSizeX();
+	if(x == terrain.getCityX() && y == terrain.getCityY()) { return false; }
+	const Tile& tile = terrain.tile(x, y);
+	return player < 0 ? !tile.owned()
+		: tile.owned() && tile.owner() == player;
+}
+
+/** One of the plots that fits, all equally likely; false if none do. */
+static bool pick_plot(Game& game, int player, uint8_t& x, uint8_t& y) {
+	const Terrain& terrain = game.terrain;
+	const int plots = terrain.getSizeX() * terrain.getSizeY();
+	int count = 0;
+	for(int i = 0; i < plots; i++)
+		{ if(fits(terrain, i, player)) { count++; } }
+	if(!count) { return false; }
+	int n = game.rng.uniform(0, count - 1);
+	for(int i = 0; i < plots; i++) {
+		if(!fits(terrain, i, player) || n--) { continue; }
+		x = i % terrain.getSizeX(); y = i / terrain.getSizeX();
+		return true;
+	}
+	return false;
+}
+
+void PlayerEvent::applyOther(PlayerEvent::Type self, int player, Game& game) {
+	uint8_t x, y;
+	switch(self) {
+		case EXTRA_LAND: // A plot going spare, with no worker
+			if(pick_plot(game, -1, x, y)) {
+				game.terrain.setOwnership(x, y, player,
+					Resource::NONE);
+			}
+			break;
+		case LOST_LAND:
+			/* TWEAK Supposedly, this should be the most recent land
+			 * the player got, but we don't track that---they lose a
+			 * random one. This shouldn't matter too much. */
+			if(pick_plot(game, player, x, y))
+				{ game.terrain.setUnowned(x, y); }
+			break;
+		default: break; // NOP
+	}
+}
@@ -2,6 +2,7 @@
 #define PLAYEREVENT_HPP_
 
 #include "resources.hpp"
+#include "util.hpp"
 
 /** \file
  * \brief Game events that can happen to players */
@@ -45,10 +46,68 @@ namespace PlayerEvent {
 	 *    logic's state.)
 	 *  - A valid selection (AFTER flagging the above) may get changed to
 	 *    a food package if the player is low on food. */
+
+	/** What an event does, as data. Plot kinds are masks with a bit for
+	 *  each Resource::Type, where NONE means plots with no worker, as with
+	 *  countTilesOfType. */
+	struct Effect {
+		/** Money, times the month's multiplier; if plots is set,
+		 *  this is for each of the player's plots of those kinds. */
+		int8_t money;
+		uint8_t plots;
+		int8_t food, energy, ore; ///< Stock, for everyone it happens to
+		bool halvefood; ///< Loses half their food, rounding down
+		/** Must have a plot of one of these kinds; or FREE, only if
+		 *  there's land going spare. */
+		uint8_t needs;
+	};
+	const uint8_t FARMS  = 1 << Resource::FOOD;
+	const uint8_t SOLAR  = 1 << Resource::ENERGY;
+	const uint8_t MINES  = 1 << Resource::ORE | 1 << Resource::CRYSTAL;
+	const uint8_t WORKED = FARMS | SOLAR | MINES;
+	const uint8_t ANY    = WORKED | 1 << Resource::NONE;
+	const uint8_t FREE   = 1 << 7;
+	constexpr Effect EFFECTS[] = {
+		{  0, 0,     3, 2, 0, false, 0      }, // CARE_PACKAGE
+		{  0, 0,     0, 0, 2, false, 0      }, // WANDERING_TRAVELLER
+		{  2, 0,     0, 0, 0, false, WORKED }, // MULE_WINNINGS_1
+		{  4, 0,     0, 0, 0, false, WORKED }, // MULE_WINNINGS_2
+		{  2, FARMS, 0, 0, 0, false, FARMS  }, // AGRICULTURE_GRANT
+		{  4, 0,     0, 0, 0, false, 0      }, // WINNINGS_1
+		{  8, 0,     0, 0, 0, false, 0      }, // WINNINGS_2
+		{  2, 0,     0, 0, 0, false, 0      }, // WINNINGS_3
+		{  3, 0,     0, 0, 0, false, 0      }, // WINNINGS_4
+		{  6, 0,     0, 0, 0, false, 0      }, // WINNINGS_5
+		{  4, 0,     0, 0, 0, false, 0      }, // WINNINGS_6
+		{  2, 0,     0, 0, 0, false, 0      }, // WINNINGS_7
+		{  0, 0,     0, 0, 0, false, FREE   }, // EXTRA_LAND
+		// TWEAK Does this round up?
+		{  0, 0,     0, 0, 0, true,  0      }, // FOOD_STOLEN
+		{ -3, 0,     0, 0, 0, false, WORKED }, // MULE_COST
+		{ -2, MINES, 0, 0, 0, false, MINES  }, // MULE_MINING_COST
+		{ -1, SOLAR, 0, 0, 0, false, SOLAR  }, // MULE_SOLAR_COST
+		{ -6, 0,     0, 0, 0, false, 0      }, // LOSSES_1
+		{ -4, 0,     0, 0, 0, false, 0      }, // LOSSES_2
+		{ -4, 0,     0, 0, 0, false, 0      }, // LOSSES_3
+		{ -4, 0,     0, 0, 0, false, 0      }, // LOSSES_4
+		{  0, 0,     0, 0, 0, false, ANY    }, // LOST_LAND
+	};
+	static_assert(sizeof(EFFECTS) / sizeof(EFFECTS[0]) == MAXIMUM + 1,
+		"An event is missing its effects");
+
 	/// Is the event good for the player (else it is bad)?
-	bool good(PlayerEvent::Type self);
+	constexpr bool good(PlayerEvent::Type self) { return self < FIRST_BAD; }
 	/// Are any *specific* preconditions for the event met for this player?
 	bool precondition(PlayerEvent::Type self, int player, const Game& game);
+	/// Events as a mask, a bit for each
+	const uint32_t ALL = (1u << (MAXIMUM + 1)) - 1;
+	const uint32_t GOOD = (1u << FIRST_BAD) - 1;
+	/** The events whose preconditions are met for this player, as
+	 *  precondition() would say for each, but looking over the map once. */
+	uint32_t eligible(int player, const Game& game);
+	/** Pick one of the allowed events, as a mask, all equally likely.
+	 *  False if there are none. */
+	bool choose(uint32_t allowed, Random& rng, PlayerEvent::Type& event);
 	
 	/** Thankfully, all the random effects can be immediate, and we don't
 	 * have to keep the differences around for the UI (else we'd be here
@@ -61,6 +120,8 @@ namespace PlayerEvent {
 	 * only records magnitude: it is always positive. */
 	Stock changes(PlayerEvent::Type self, int player, const Game& game,
 		int32_t* money, uint16_t* each);
+	/** Hand over or take away land: a random spare plot for EXTRA_LAND,
+	 *  one of the player's for LOST_LAND, drawn from the game's rng. */
 	void applyOther(PlayerEvent::Type self, int player, Game& game);
 };
 
@@ -0,0 +1,408 @@
+#include "production.hpp"
+
+using Production::PLOTS;
+
+static const int WIDTH = TERRAIN_WIDTH;
+static const double PRE_EVENT_CHANCE  = 0.3; ///< Per month, of an event before
+static const double POST_EVENT_CHANCE = 0.2; ///< And after production
+/// How likely each event is, when it can happen, against the others
+static const uint16_t EVENT_WEIGHT[] = {
+	0, // NONE
+	3, // PESTS
+	2, // PIRATES
+	3, // RAIN
+	2, // QUAKE
+	3, // SUN
+	1, // METEORITE
+	2, // RADIATION
+	2, // FIRE
+};
+static const int8_t RAIN_FOOD   = 3; ///< More food, on the row it falls on
+static const int8_t RAIN_ENERGY = 2; ///< And less energy, under the clouds
+static const int8_t SUN_ENERGY  = 3; ///< Every energy plot, from sunspots
+static const uint8_t MOST_MOUNTAINS = 3;
+static const uint8_t MOST_CRYSTAL = 4; ///< Left by a meteorite
+/// A player's plots of one kind, as one number: 0 for none of anyone's
+static inline uint8_t plot_key(int owner, int equipment)
+	{ return (owner << 3) | equipment; }
+
+/* The per-lane steps below keep to bitwise and arithmetic operations on
+ * values of one width, since short-circuit logic and branches on a lane stop
+ * the compiler from vectorising the loop (at -O3; see the header). */
+
+/// All ones if true, else zero
+static inline uint8_t mask(bool b) { return (uint8_t) -(uint8_t) b; }
+
+template <int N> void Production::load(Grid<N>& grid, int lane,
+	const Game& game, Random& rng) {
+
+	for(int i = 0; i < PLOTS; i++) {
+		const Tile& tile = game.terrain.tile(i % WIDTH, i / WIDTH);
+		const bool working = tile.owned()
+			&& tile.equipment() != Resource::NONE;
+		grid.owner[i][lane] = tile.owned() ? tile.owner() : PLAYERS;
+		grid.equipment[i][lane] = working ? tile.equipment()
+			: Resource::NONE;
+		grid.mountains[i][lane] = tile.mountains();
+		grid.crystal[i][lane] = tile.crystal();
+		grid.river[i][lane] = tile.river();
+		// Only what actually yields gets any luck, good or bad
+		grid.variation[i][lane] = working
+			&& tileYield(tile, tile.equipment())
+			? Difficulty::calcProductionVariation(game.difficulty,
+				rng) : 0;
+	}
+	for(int p = 0; p < PLAYERS; p++) {
+		const int32_t energy = game.players[p].stock.energy;
+		grid.energy[p][lane] = energy > INT16_MAX ? INT16_MAX : energy;
+	}
+}
+
+template <int N> void Production::compute(const Grid<N>& grid,
+	uint8_t production[PLOTS][N], int16_t energy[PLAYERS][N]) {
+
+	/* Whose plots of what kind, with a blank row above and below, so that
+	 * neighbours can be looked up without running off the map. */
+	uint8_t key[WIDTH + PLOTS + WIDTH][N];
+	uint8_t yield[PLOTS][N];
+	int8_t bonus[PLOTS][N];
+	for(int i = 0; i < WIDTH; i++) {
+		for(int l = 0; l < N; l++)
+			{ key[i][l] = key[WIDTH + PLOTS + i][l] = 0; }
+	}
+
+	// Each plot's yield, as tileYield
+	for(int i = 0; i < PLOTS; i++) {
+		for(int l = 0; l < N; l++) {
+			const uint8_t e = grid.equipment[i][l];
+			const uint8_t m = grid.mountains[i][l];
+			const uint8_t hilly = mask(m != 0);
+			const uint8_t river = mask(grid.river[i][l]);
+			const uint8_t food  = (river & 4)
+				| (~river & (2 - (hilly & 1)));
+			const uint8_t power = (river & 2)
+				| (~river & (3 - (hilly & 2)));
+			const uint8_t ore   = ~river & (m + 1);
+			yield[i][l] = (mask(e == Resource::FOOD) & food)
+				| (mask(e == Resource::ENERGY) & power)
+				| (mask(e == Resource::ORE) & ore)
+				| (mask(e == Resource::CRYSTAL)
+				  & grid.crystal[i][l]);
+			key[WIDTH + i][l] = mask(e != Resource::NONE)
+				& plot_key(grid.owner[i][l], e);
+			bonus[i][l] = grid.variation[i][l];
+		}
+	}
+
+	// The learning curve: one more for every three of a kind
+	for(int p = 0; p < PLAYERS; p++) {
+		for(int e = Resource::FOOD; e <= Resource::CRYSTAL; e++) {
+			const uint8_t k = plot_key(p, e);
+			uint8_t count[N];
+			for(int l = 0; l < N; l++) { count[l] = 0; }
+			for(int i = 0; i < PLOTS; i++) {
+				for(int l = 0; l < N; l++)
+					{ count[l] += key[WIDTH + i][l] == k; }
+			}
+			for(int l = 0; l < N; l++) { count[l] /= 3; }
+			for(int i = 0; i < PLOTS; i++) {
+				for(int l = 0; l < N; l++) {
+					bonus[i][l] += key[WIDTH + i][l] == k
+						? count[l] : 0;
+				}
+			}
+		}
+	}
+
+	// Economies of scale: one more for a neighbour of the same kind
+	for(int i = 0; i < PLOTS; i++) {
+		const uint8_t west = mask(i % WIDTH > 0);
+		const uint8_t east = mask(i % WIDTH < WIDTH - 1);
+		const uint8_t (*here)[N] = &key[WIDTH + i];
+		for(int l = 0; l < N; l++) {
+			const uint8_t k = here[0][l];
+			const uint8_t next = mask(here[-WIDTH][l] == k)
+				| mask(here[WIDTH][l] == k)
+				| (west & mask(here[-1][l] == k))
+				| (east & mask(here[1][l] == k));
+			bonus[i][l] += mask(k != 0) & next & 1;
+		}
+	}
+
+	// Energy, first come first served across the map, and the total
+	int16_t used[PLAYERS][N];
+	for(int p = 0; p < PLAYERS; p++) {
+		for(int l = 0; l < N; l++) { used[p][l] = 0; }
+	}
+	for(int i = 0; i < PLOTS; i++) {
+		for(int l = 0; l < N; l++) {
+			const uint8_t e = grid.equipment[i][l];
+			const int16_t needs = e != Resource::NONE
+				&& e != Resource::ENERGY;
+			int16_t idle = mask(yield[i][l] == 0);
+			for(int p = 0; p < PLAYERS; p++) {
+				const int16_t mine = needs
+					& (grid.owner[i][l] == p);
+				idle |= -(mine
+					& (used[p][l] >= grid.energy[p][l]));
+				used[p][l] += mine;
+			}
+			int16_t total = yield[i][l] + bonus[i][l];
+			total = total < 0 ? 0 : total > 0xFF ? 0xFF : total;
+			production[i][l] = total & ~idle;
+		}
+	}
+	for(int p = 0; p < PLAYERS; p++) {
+		for(int l = 0; l < N; l++) {
+			const int16_t have = grid.energy[p][l];
+			const int16_t left = have - used[p][l];
+			energy[p][l] = left > 0 ? left : 0;
+		}
+	}
+}
+
+template <int N> void Production::boost(Grid<N>& grid, int lane,
+	const ProductionEvent& event) {
+
+	int first = 0, last = PLOTS; // Plots it touches
+	int8_t food = 0, power = 0;  // And how
+	switch(event.type) {
+		case ProductionEvent::RAIN:
+			first = event.y * WIDTH;
+			last = first + WIDTH;
+			food = RAIN_FOOD;
+			power = -RAIN_ENERGY;
+			break;
+		case ProductionEvent::SUN:
+			power = SUN_ENERGY;
+			break;
+		default: return;
+	}
+	for(int i = first; i < last; i++) {
+		const uint8_t e = grid.equipment[i][lane];
+		grid.variation[i][lane] += (mask(e == Resource::FOOD) & food)
+			| (mask(e == Resource::ENERGY) & power);
+	}
+}
+
+void Production::produce(Game& game, GameStageState::Product& product,
+	const ProductionEvent& event) {
+
+	Grid<1> grid;
+	uint8_t production[PLOTS][1];
+	int16_t energy[PLAYERS][1];
+	load(grid, 0, game, game.rng);
+	boost(grid, 0, event);
+	compute(grid, production, energy);
+	for(int i = 0; i < PLOTS; i++)
+		{ product.production[i % WIDTH][i / WIDTH] = production[i][0]; }
+	for(int p = 0; p < PLAYERS; p++)
+		{ game.players[p].stock.energy = energy[p][0]; }
+}
+
+/* Which events could happen, in one pass over the map, as a mask with a bit
+ * for each type; and where. */
+
+static bool is_farm(const Tile& tile)
+	{ return tile.owned() && tile.equipment() == Resource::FOOD; }
+static bool is_mine(const Tile& tile)
+	{ return tile.owned() && tile.equipment() == Resource::CRYSTAL; }
+static bool is_worked(const Tile& tile)
+	{ return tile.owned() && tile.equipment() != Resource::NONE; }
+static bool is_mountain(const Tile& tile) { return tile.mountains(); }
+/// Anywhere but the river, for a meteorite; the city is left out anyway
+static bool is_open(const Tile& tile) { return !tile.river(); }
+
+static uint32_t bit(int type) { return 1u << type; }
+
+static uint32_t possible_events(const Game& game, bool after) {
+	uint32_t possible = 0;
+	for(int i = 0; i < PLOTS; i++) {
+		const Tile& tile = game.terrain.tile(i % WIDTH, i / WIDTH);
+		if(is_farm(tile))
+			{ possible |= bit(ProductionEvent::PESTS); }
+		if(is_mine(tile))
+			{ possible |= bit(ProductionEvent::PIRATES); }
+		if(is_worked(tile))
+			{ possible |= bit(ProductionEvent::RADIATION); }
+		if(is_mountain(tile))
+			{ possible |= bit(ProductionEvent::QUAKE); }
+	}
+	possible |= bit(ProductionEvent::RAIN) | bit(ProductionEvent::SUN);
+	if(Difficulty::hasCrystal(game.difficulty))
+		{ possible |= bit(ProductionEvent::METEORITE); }
+	if(game.store.food || game.store.energy || game.store.ore)
+		{ possible |= bit(ProductionEvent::FIRE); }
+	const uint32_t post = bit(ProductionEvent::PESTS)
+		| bit(ProductionEvent::PIRATES);
+	return possible & (after ? post : ~post);
+}
+
+/** One of the plots that fits, all equally likely; false if none do. */
+static bool pick_plot(const Game& game, Random& rng,
+	bool (*fits)(const Tile&), uint8_t& x, uint8_t& y) {
+
+	const uint8_t cityx = game.terrain.getCityX();
+	const uint8_t cityy = game.terrain.getCityY();
+	const int city = cityx + cityy * WIDTH;
+	int count = 0;
+	for(int i = 0; i < PLOTS; i++) {
+		if(i != city && fits(game.terrain.tile(i % WIDTH, i / WIDTH)))
+			{ count++; }
+	}
+	if(!count) { return false; }
+	int n = rng.uniform(0, count - 1);
+	for(int i = 0; i < PLOTS; i++) {
+		if(i == city || !fits(game.terrain.tile(i % WIDTH, i / WIDTH)))
+			{ continue; }
+		if(!n--) { x = i % WIDTH; y = i / WIDTH; return true; }
+	}
+	return false;
+}
+
+/** Where a landslide from the plot ends up, or false if off the map. */
+static bool slide(const Game& game, Direction d, uint8_t x, uint8_t y,
+	uint8_t& tox, uint8_t& toy) {
+
+	int dx = 0, dy = 0;
+	switch(d) {
+		case DIR_N: dy = -1; break;
+		case DIR_E: dx = +1; break;
+		case DIR_S: dy = +1; break;
+		case DIR_W: dx = -1; break;
+		default: return false;
+	}
+	if(x + dx < 0 || x + dx >= game.terrain.getSizeX()
+	|| y + dy < 0 || y + dy >= game.terrain.getSizeY()) { return false; }
+	tox = x + dx; toy = y + dy;
+	return true;
+}
+
+static_assert(sizeof(EVENT_WEIGHT) / sizeof(*EVENT_WEIGHT)
+	== ProductionEvent::FIRE + 1, "A production event has no weight");
+
+/** Which way the mountain slides, onto any tile (other than river or the town)
+ *  with room for another mountain, or centre if it stays. */
+static Direction landslide(const Game& game, Random& rng, uint8_t x,
+	uint8_t y) {
+
+	static const Direction ways[] = { DIR_N, DIR_E, DIR_S, DIR_W };
+	const Direction way = ways[rng.uniform(0, 3)];
+	uint8_t tox, toy;
+	if(!slide(game, way, x, y, tox, toy)) { return DIR_CENTRE; }
+	const Tile& to = game.terrain.tile(tox, toy);
+	if(to.river() || to.mountains() >= MOST_MOUNTAINS
+	|| (tox == game.terrain.getCityX() && toy == game.terrain.getCityY()))
+		{ return DIR_CENTRE; }
+	return way;
+}
+
+static Sampler make_sampler() {
+	uint16_t weight[ProductionEvent::FIRE + 1];
+	for(int e = 0; e <= ProductionEvent::FIRE; e++)
+		{ weight[e] = EVENT_WEIGHT[e]; }
+	return Sampler(weight, ProductionEvent::FIRE + 1);
+}
+
+ProductionEvent Production::chooseEvent(const Game& game, Random& rng,
+	bool after) {
+
+	static const Sampler sampler = make_sampler();
+	ProductionEvent event;
+	if(!Difficulty::hasRandomEvents(game.difficulty)
+	|| rng.fraction() >= (after ? POST_EVENT_CHANCE : PRE_EVENT_CHANCE))
+		{ return event; }
+	const int type = sampler.sample(rng, possible_events(game, after));
+	if(type < 0) { return event; }
+	event.type = static_cast<decltype(event.type)>(type);
+	switch(event.type) {
+		case ProductionEvent::RAIN:
+			event.y = rng.uniform(0, game.terrain.getSizeY() - 1);
+			break;
+		case ProductionEvent::QUAKE:
+			pick_plot(game, rng, is_mountain, event.x, event.y);
+			event.landslide = landslide(game, rng, event.x,
+				event.y);
+			break;
+		case ProductionEvent::METEORITE:
+			pick_plot(game, rng, is_open, event.x, event.y);
+			break;
+		case ProductionEvent::RADIATION:
+			pick_plot(game, rng, is_worked, event.x, event.y);
+			break;
+		case ProductionEvent::PESTS:
+			pick_plot(game, rng, is_farm, event.x, event.y);
+			break;
+		default: break;
+	}
+	return event;
+}
+
+void Production::strike(Game& game, const ProductionEvent& event) {
+	Tile& tile = game.terrain.tile(event.x, event.y);
+	switch(event.type) {
+		case ProductionEvent::QUAKE: {
+			uint8_t tox, toy;
+			if(!slide(game, event.landslide, event.x, event.y,
+				tox, toy)) { break; }
+			game.terrain.setMountains(event.x, event.y,
+				tile.mountains() - 1);
+			game.terrain.setMountains(tox, toy,
+				game.terrain.tile(tox, toy).mountains() + 1);
+			} break;
+		case ProductionEvent::METEORITE:
+			game.terrain.setCrystal(event.x, event.y, MOST_CRYSTAL);
+			break;
+		case ProductionEvent::RADIATION:
+			// The worker runs off; the plot stays its owner's
+			game.terrain.setOwnership(event.x, event.y,
+				tile.owner(), Resource::NONE);
+			break;
+		case ProductionEvent::FIRE:
+			game.store.food = game.store.energy = 0;
+			game.store.ore = 0;
+			break;
+		default: break;
+	}
+}
+
+void Production::spoil(Game& game, const ProductionEvent& event,
+	GameStageState::Product& product) {
+
+	// Only the plots hit change, and their owners' stock with them
+	int first = 0, last = 0;
+	bool (*hit)(const Tile&) = is_mine;
+	switch(event.type) {
+		case ProductionEvent::PESTS:
+			first = event.x + event.y * WIDTH;
+			last = first + 1;
+			hit = is_farm;
+			break;
+		case ProductionEvent::PIRATES:
+			last = PLOTS;
+			break;
+		default: return;
+	}
+	for(int i = first; i < last; i++) {
+		const uint8_t x = i % WIDTH, y = i / WIDTH;
+		const Tile& tile = game.terrain.tile(x, y);
+		if(!hit(tile)) { continue; }
+		int32_t& stock = game.players[tile.owner()].stock[
+			tile.equipment()];
+		stock -= product.production[x][y];
+		if(stock < 0) { stock = 0; }
+		product.production[x][y] = 0;
+	}
+}
+
+template void Production::boost<1>(Grid<1>&, int, const ProductionEvent&);
+template void Production::boost<Production::LANES>(Grid<LANES>&, int,
+	const ProductionEvent&);
+template void Production::load<1>(Grid<1>&, int, const Game&, Random&);
+template void Production::load<Production::LANES>(Grid<LANES>&, int,
+	const Game&, Random&);
+template void Production::compute<1>(const Grid<1>&, uint8_t[PLOTS][1],
+	int16_t[PLAYERS][1]);
+template void Production::compute<Production::LANES>(const Grid<LANES>&,
+	uint8_t[PLOTS][LANES], int16_t[PLAYERS][LANES]);
+
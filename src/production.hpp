@@ -0,0 +1,81 @@
+#ifndef PRODUCTION_HPP_
+#define PRODUCTION_HPP_
+#include <stdint.h>
+#include "game.hpp"
+
+/** \file
+ * \brief What every plot produces each month, a whole map at a time */
+
+/** Works out the month's production for every plot at once.
+ *
+ * A plot's output is its yield for what it's outfitted for (see tileYield),
+ * plus one for each three plots of that kind its owner has (the learning
+ * curve), plus one if it is next to another of them (economies of scale),
+ * plus the month's luck (Difficulty::calcProductionVariation). Everything but
+ * an energy plant needs a unit of energy to run; going across the map, those
+ * whose owner has run out sit idle.
+ *
+ * The terrain is copied into a Grid, which has an array for each field, so
+ * that each step is the same few operations over every plot with no branches,
+ * and the compiler can turn them into vector instructions (GCC does at -O3,
+ * as in the Makefile's release flags, but not at the debugging -O). A Grid
+ * has a lane per game, as the innermost index, so that LANES independent
+ * games can be worked out together in lockstep; a Grid<1> is just the one.
+ *
+ * Only the bench uses more than one lane so far. The game, and so the batch
+ * runner, the planner's playouts and the learning environment, all produce
+ * through Grid<1>: each game gets to production on its own tick, inside its
+ * stage's logic, so there is nothing yet to gather LANES of them at once. */
+namespace Production {
+	static const int PLOTS = TERRAIN_WIDTH * TERRAIN_HEIGHT;
+	/// Games in a batch; a vector register's worth of bytes, or half
+	static const int LANES = 16;
+
+	/** The terrain, and what the month's production needs from the rest
+	 *  of the game, for N games. Plots are numbered x + y * width. */
+	template <int N> struct Grid {
+		uint8_t owner[PLOTS][N];     ///< PLAYERS if nobody's
+		uint8_t equipment[PLOTS][N]; ///< A Resource::Type; NONE if idle
+		uint8_t mountains[PLOTS][N];
+		uint8_t crystal[PLOTS][N];
+		uint8_t river[PLOTS][N];     ///< 1 or 0
+		int8_t variation[PLOTS][N];  ///< This month's luck, by plot
+		int16_t energy[PLAYERS][N];  ///< What each player has to run on
+	};
+
+	/** Copy a game into one lane of the grid, drawing its luck. */
+	template <int N> void load(Grid<N>& grid, int lane, const Game& game,
+		Random& rng);
+	/** Work out every plot's production, in every lane, and the energy
+	 *  each player has left after running them. */
+	template <int N> void compute(const Grid<N>& grid,
+		uint8_t production[PLOTS][N], int16_t energy[PLAYERS][N]);
+	/** The month's production for the game, into the product state, using
+	 *  up the players' energy, with the pre-production event's effect. */
+	void produce(Game& game, GameStageState::Product& product,
+		const ProductionEvent& event);
+
+	/* Production events, at most one before production and one after.
+	 * Those before change the land, or the store, and what some plots
+	 * make; those after take away some of what was made. */
+
+	/** Pick the event, if any, before production (or after, if after is
+	 *  set): what, and where, from the events that could happen then.
+	 *  Its type is NONE if nothing does. */
+	ProductionEvent chooseEvent(const Game& game, Random& rng, bool after);
+	/** Make a pre-production event's changes to the game itself: a
+	 *  landslide, a crystal deposit, a lost worker, or a burnt store. */
+	void strike(Game& game, const ProductionEvent& event);
+	/** Change one lane's production for a pre-production event, as bulk
+	 *  changes to the luck of every plot of a kind in a row, or all rows.
+	 *  Call between load and compute. */
+	template <int N> void boost(Grid<N>& grid, int lane,
+		const ProductionEvent& event);
+	/** Take a post-production event's losses out of what was made, plot
+	 *  by plot, and out of the owners' stock, where it has already gone. */
+	void spoil(Game& game, const ProductionEvent& event,
+		GameStageState::Product& product);
+}
+
+#endif
+
@@ -1,3 +1,29 @@
 #include "resources.hpp"
 
 Stock::Stock() : food(0), energy(0), ore(0), crystal(0), workers(0) {}
+
+int32_t& Stock::operator[](Resource::Type type) {
+	switch(type) {
+		case Resource::NONE:    return workers;
+		case Resource::FOOD:    return food;
+		case Resource::ENERGY:  return energy;
+		case Resource::ORE:     return ore;
+		case Resource::CRYSTAL: return crystal;
+	}
+	return workers; // shush, g++
+}
+
+int32_t Stock::operator[](Resource::Type type) const
+	{ return (*const_cast<Stock*>(this))[type]; }
+
+/* As the original game, where outfitting is paid for at the corral. */
+int32_t Resource::getOutfitCost(Resource::Type self) {
+	switch(self) {
+		case Resource::NONE:    return 0;
+		case Resource::FOOD:    return 25;
+		case Resource::ENERGY:  return 50;
+		case Resource::ORE:     return 75;
+		case Resource::CRYSTAL: return 100;
+	}
+	return 0;
+}
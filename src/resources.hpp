@@ -5,7 +5,11 @@
 /** \file
  * \brief Resource types and stocks */
 
-namespace Resource { typedef enum { NONE, FOOD, ENERGY, ORE, CRYSTAL } Type; }
+namespace Resource { typedef enum { NONE, FOOD, ENERGY, ORE, CRYSTAL } Type;
+	/** What the store charges to outfit a worker for this, on top of the
+	 *  price of the worker itself. */
+	int32_t getOutfitCost(Type self);
+}
 
 /** The constructor zeros out the fields for miscellaneous use, e.g. showing
  * differences in auctions. Initialised correctly for player/store by difficulty
@@ -17,6 +21,9 @@ struct Stock {
 	int32_t ore;     ///< (Smithore)
 	int32_t crystal; ///< (Crystite)
 	int32_t workers; ///< (Mules) (Players never have workers 'in stock')
+	/** Field for a resource; as with countTilesOfType, 'None' is workers.*/
+	int32_t& operator[](Resource::Type type);
+	int32_t operator[](Resource::Type type) const;
 };
 
 #endif
@@ -27,10 +27,32 @@ namespace Species {
 
 /* Because there is only one game logic implementation (vs. many UIs), we'll
  * define these here and avoid reaching JAVA levels of source file dilution. */
+	struct Traits {
+		int32_t bonus; ///< Added to starting money
+		uint8_t btu;   ///< BTUs to the PTU; move time in sevenths
+	};
+	/* In original MULE, the species adjusts the PTU/BTU conversion. Normal
+	 * is 1 PTU to 7 BTU; Flappers get 9, Humans get 5. 9/7 is about 1.29;
+	 * 5/7 is ~0.71. _Computers_ get a 200 bonus in Tourny; _not_ all
+	 * Mechtrons. So that times stay whole numbers of ticks, they're kept
+	 * as the BTU count, over the normal 7. */
+	constexpr Traits TRAITS[] = {
+		{    0, 7 }, // REGULAR1
+		{    0, 7 }, // REGULAR2
+		{    0, 7 }, // REGULAR3
+		{ -400, 5 }, // ADVANCED
+		{    0, 7 }, // REGULAR4
+		{ +600, 9 }, // BEGINNER
+		{    0, 7 }, // REGULAR5
+		{    0, 7 }, // COMPUTER
+	};
 	/** Amount to add to starting money. May be negative. */
-	int32_t getStartingBonus(Type self);
-	/** Multiplier for move time. > 1 means more time to move. */
-	double getTimeModifier(Type self);
+	constexpr int32_t getStartingBonus(Type self)
+		{ return TRAITS[self].bonus; }
+	/** Multiplier for move time, in sevenths. > 7 means more time to
+	 *  move. */
+	constexpr uint8_t getTimeSevenths(Type self)
+		{ return TRAITS[self].btu; }
 }
 
 inline void operator++(Species::Type& d) {
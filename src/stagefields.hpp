@@ -0,0 +1,126 @@
+#ifndef STAGEFIELDS_HPP_
+#define STAGEFIELDS_HPP_
+#include "game.hpp"
+
+/** \file
+ * \brief Walks the part of a GameStageState that the current stage uses */
+
+/** Most of a GameStageState is stale at any one time: only the struct for the
+ *  current stage (and, in an auction, those of the stages before it) means
+ *  anything. This calls a visitor with each field that does, one at a time
+ *  and always in the same order, so that whatever needs all of them (hashing,
+ *  sending) agrees on which they are. The state may be const or not, and so
+ *  may the fields passed on; a visitor which reads them in can rely on each
+ *  field that decides which follow (whether a player event happens) having
+ *  been visited first. */
+namespace StageFields {
+	template <typename T, int N, typename Visitor>
+	void each(T (&values)[N], Visitor& visit)
+		{ for(int i = 0; i < N; i++) { visit(values[i]); } }
+
+	template <typename Event, typename Visitor>
+	void event(Event& event, Visitor& visit) {
+		visit(event.type); visit(event.x); visit(event.y);
+		visit(event.landslide);
+	}
+
+	template <typename State, typename Visitor>
+	void walk(GameStage::Type stage, State& state, Visitor& visit) {
+		switch(stage) {
+			case GameStage::TITLE:
+				each(state.title.playerready, visit);
+				break;
+			case GameStage::COLOUR:
+				visit(state.colour.offer);
+				each(state.colour.claim, visit);
+				break;
+			case GameStage::SPECIES:
+				visit(state.species.player);
+				visit(state.species.defined);
+				break;
+			case GameStage::SCOREBOARD:
+				each(state.scoreboard.landvalue, visit);
+				each(state.scoreboard.goodsvalue, visit);
+				visit(state.scoreboard.message);
+				break;
+			case GameStage::LANDGRAB:
+				visit(state.landgrab.x);
+				visit(state.landgrab.y);
+				break;
+			case GameStage::LANDAUCTION:
+				visit(state.landauction.x);
+				visit(state.landauction.y);
+				visit(state.landauction.left);
+				each(state.landauction.bid, visit);
+				break;
+			// Each stage of an auction keeps the last's, and adds
+			case GameStage::AUCTION:
+				each(state.auction.bid, visit);
+				each(state.auction.traded, visit);
+				visit(state.auction.storebuy);
+				visit(state.auction.storesell);
+				visit(state.landauction.x);
+				visit(state.landauction.y);
+				visit(state.landauction.left);
+				each(state.landauction.bid, visit);
+				// Fall through
+			case GameStage::AUCTIONDECLARE:
+				each(state.auctiondeclare.buyer, visit);
+				visit(state.auctiondeclare.time);
+				visit(state.auctiondeclare.timemax);
+				// Fall through
+			case GameStage::PREAUCTION:
+				visit(state.preauction.resource);
+				each(state.preauction.stock, visit);
+				each(state.preauction.production, visit);
+				each(state.preauction.spoilage, visit);
+				each(state.preauction.surplus, visit);
+				visit(state.preauction.store);
+				break;
+			case GameStage::PREDEVELOP:
+				visit(state.predevelop.player);
+				visit(state.predevelop.eventhappens);
+				if(state.predevelop.eventhappens)
+					{ visit(state.predevelop.eventtype); }
+				break;
+			case GameStage::DEVELOPHUMAN:
+				visit(state.develophuman.player);
+				visit(state.develophuman.dir);
+				visit(state.develophuman.town);
+				visit(state.develophuman.mule);
+				visit(state.develophuman.muletype);
+				visit(state.develophuman.time);
+				visit(state.develophuman.timemax);
+				break;
+			case GameStage::WAMPUS:
+				visit(state.wampus.player);
+				visit(state.wampus.prize);
+				break;
+			case GameStage::DEVELOPCOMP:
+				visit(state.developcomp.player);
+				visit(state.developcomp.x);
+				visit(state.developcomp.y);
+				break;
+			case GameStage::POSTDEVELOP:
+				visit(state.postdevelop.player);
+				visit(state.postdevelop.winnings);
+				break;
+			case GameStage::PREPRODUCT:
+				event(state.preproduct.event, visit);
+				break;
+			// Losses after production come out of what was made
+			case GameStage::POSTPRODUCT:
+				event(state.postproduct.event, visit);
+				// Fall through
+			case GameStage::PRODUCT:
+				for(int x = 0; x < TERRAIN_WIDTH; x++) {
+					each(state.product.production[x],
+						visit);
+				}
+				break;
+		}
+	}
+}
+
+#endif
+
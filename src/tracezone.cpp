@@ -0,0 +1,113 @@
+#include <atomic>
+#include <stdio.h>
+#include "tracezone.hpp"
+
+bool TraceZone::enabled = false;
+
+/** One thread's events. Only the owning thread writes to it, and it publishes
+ *  each event by bumping head afterwards, so the writer never waits on anyone
+ *  and a reader can see how much is valid without a lock. Rings are linked
+ *  into a list as threads first record, and live until exit. */
+struct TraceRing {
+	static const uint32_t SIZE = 1 << 16; // power of two, for the wrap
+	struct Event {
+		const char* name;
+		const char* detail;
+		uint64_t start;
+		uint32_t duration;
+	} events[SIZE];
+	std::atomic<uint32_t> head; ///< Total events ever recorded
+	uint32_t tid;
+	const char* name;
+	TraceRing* next;
+};
+
+static std::atomic<TraceRing*> rings(0);
+static std::atomic<uint32_t> next_tid(1);
+static thread_local TraceRing* ring = 0;
+
+static TraceRing* this_ring() {
+	if(!ring) {
+		ring = new TraceRing;
+		ring->head.store(0);
+		ring->tid = next_tid++;
+		ring->name = 0;
+		// Lock-free push onto the front of the list
+		ring->next = rings.load();
+		while(!rings.compare_exchange_weak(ring->next, ring)) {}
+	}
+	return ring;
+}
+
+/// JSON strings; our names are all literals, but be safe about quotes
+static void write_string(FILE* out, const char* str) {
+	fputc('"', out);
+	for(; *str; str++) {
+		if(*str == '"' || *str == '\\') { fputc('\\', out); }
+		if((unsigned char) *str >= 32) { fputc(*str, out); }
+	}
+	fputc('"', out);
+}
+
+void TraceZone::record(const char* name, const char* detail,
+	uint64_t start, uint64_t end) {
+
+	TraceRing* r = this_ring();
+	uint32_t head = r->head.load(std::memory_order_relaxed);
+	TraceRing::Event& e = r->events[head & (TraceRing::SIZE - 1)];
+	e.name = name;
+	e.detail = detail;
+	e.start = start;
+	e.duration = (uint32_t) (end - start);
+	r->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceZone::enable() { enabled = true; }
+
+void TraceZone::nameThread(const char* name) {
+	if(enabled) { this_ring()->name = name; }
+}
+
+bool TraceZone::write(const char* filename) {
+	FILE* out = fopen(filename, "w");
+	if(!out) {
+		warn("Unable to write trace to %s", filename);
+		return false;
+	}
+	bool first = true;
+	fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", out);
+	for(TraceRing* r = rings.load(); r; r = r->next) {
+		if(r->name) {
+			fprintf(out, "%s{\"ph\": \"M\", \"pid\": 1, "
+				"\"tid\": %u, \"name\": \"thread_name\", "
+				"\"args\": {\"name\": ", first ? "" : ",\n",
+				r->tid);
+			write_string(out, r->name);
+			fputs("}}", out);
+			first = false;
+		}
+		uint32_t head = r->head.load(std::memory_order_acquire);
+		uint32_t tail = head > TraceRing::SIZE
+			? head - TraceRing::SIZE : 0;
+		for(uint32_t i = tail; i != head; i++) {
+			const TraceRing::Event& e =
+				r->events[i & (TraceRing::SIZE - 1)];
+			fprintf(out, "%s{\"ph\": \"X\", \"pid\": 1, "
+				"\"tid\": %u, \"ts\": %llu, \"dur\": %u, "
+				"\"name\": ", first ? "" : ",\n", r->tid,
+				(unsigned long long) e.start, e.duration);
+			write_string(out, e.name);
+			if(e.detail) {
+				fputs(", \"args\": {\"detail\": ", out);
+				write_string(out, e.detail);
+				fputc('}', out);
+			}
+			fputc('}', out);
+			first = false;
+		}
+	}
+	fputs("\n]}\n", out);
+	fclose(out);
+	return true;
+}
+
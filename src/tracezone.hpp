@@ -0,0 +1,49 @@
+#ifndef TRACEZONE_HPP_
+#define TRACEZONE_HPP_
+#include <stdint.h>
+#include "platform.hpp"
+
+/** \file
+ * \brief Scoped timing zones, written out as Chrome trace events
+ *
+ * Put TRACE_ZONE("what") at the top of a block, and when tracing is on, the
+ * time spent in the rest of the block is recorded into a ring buffer belonging
+ * to the current thread. At exit, TraceZone::write() dumps every thread's ring
+ * as trace-event JSON, for chrome://tracing or ui.perfetto.dev. The rings only
+ * keep the most recent events, so a long session shows its last minute or so.
+ *
+ * When tracing is off, a zone costs one test of a flag on entry and exit. */
+class TraceZone {
+	const char* name;
+	const char* detail;
+	uint64_t start; ///< Zero if tracing was off when we were entered
+	static bool enabled;
+	static void record(const char* name, const char* detail,
+		uint64_t start, uint64_t end);
+public:
+	/** The strings are NOT copied, so should be literals or otherwise
+	 *  live forever. The detail is optional extra context, e.g. stage. */
+	inline TraceZone(const char* name, const char* detail = 0)
+		: name(name), detail(detail),
+		  start(enabled ? platform_microseconds() : 0) {}
+	inline ~TraceZone()
+		{ if(start) { record(name, detail, start,
+			platform_microseconds()); } }
+
+	/** Turn tracing on. Do this before starting other threads. */
+	static void enable();
+	/** Label the calling thread in the output. The name is not copied. */
+	static void nameThread(const char* name);
+	/** Write everything recorded so far. Other threads should be idle or
+	 *  finished, else their latest events may be torn. Returns success. */
+	static bool write(const char* filename);
+};
+
+#define TRACE_ZONE_CAT2(a, b) a##b
+#define TRACE_ZONE_CAT(a, b) TRACE_ZONE_CAT2(a, b)
+/** Time the rest of the enclosing block, optionally with a detail string. */
+#define TRACE_ZONE(...) \
+	TraceZone TRACE_ZONE_CAT(tracezone_, __LINE__)(__VA_ARGS__)
+
+#endif
+
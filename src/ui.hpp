@@ -12,13 +12,49 @@
  * a new PDA UI; you add a new PDA stylus Controller. This applies all the way
  * down to setting up the game, which is arguably overkill. */
 
+/** Where an interface rendering off-screen (see initOffscreen()) puts each
+ *  frame. The sink owns a few buffers, and the interface renders straight into
+ *  them, so that frames are handed over without being copied: it acquire()s
+ *  one, draws the next frame in it, and submit()s it, after which it won't
+ *  touch that buffer until acquire() gives it back again. Pixels are 32 bits,
+ *  0x00RRGGBB in the machine's byte order, in rows of exactly the width. */
+class FrameSink {
+public:
+	virtual ~FrameSink() {}
+	/** Frames will be this size. Return success. */
+	virtual bool open(uint16_t width, uint16_t height) = 0;
+	/** A buffer to draw the next frame in, waiting for one if need be. It
+	 *  holds whatever was last drawn in it, if anything. */
+	virtual uint32_t* acquire() = 0;
+	/** The buffer holds the next frame. */
+	virtual void submit(uint32_t* frame) = 0;
+};
+
 class UserInterface {
 public:
+	/// How to get each frame on to the display, where there's a choice
+	typedef enum {
+		PRESENT_RECTS, ///< Update just what has changed
+		PRESENT_FLIP,  ///< Double-buffer, and flip
+		PRESENT_AUTO,  ///< Whichever was faster here before, or...
+		PRESENT_TEST   ///< ...measure which is faster (and remember it)
+	} Presentation;
+
 	virtual ~UserInterface() {}
+	/// Before init(), if at all; the default is PRESENT_RECTS.
+	virtual void setPresentation(Presentation presentation) {}
 	/// Initialise audio and graphics as needed. Return success.
 	virtual bool init(bool fullscreen) = 0;
+	/** Instead of init(), initialise to render every frame into the sink,
+	 *  rather than on a display, and with no sound. Return success; false
+	 *  if this interface can't. */
+	virtual bool initOffscreen(FrameSink& frames) { return false; }
 	/// Toggle fullscreen, if that makes sense for this interface.
 	virtual void toggleFullscreen() {}
+	/// Toggle display of performance metrics, if the interface can.
+	virtual void toggleOverlay() {}
+	/// Toggle filtering, if the interface scales up what it draws.
+	virtual void toggleSmoothing() {}
 
 	/** Render the game, given that N ticks have passed since last render.
 	 * If the stage has changed, but the previous stage still has UI work
@@ -28,6 +64,9 @@ public:
 	 * NULL for some game stages. */
 	virtual bool render(GameStage::Type stage, GameSetup& setup, Game* game,
 		GameStageState& state, uint32_t ticks) = 0;
+	/** Hint that the logic expects to move to one of these stages soon, so
+	 * that the interface can get ready for them in the background. */
+	virtual void anticipate(GameStage::Mask stages) {}
 	
 	// TODO Determine if the player is touching a mountain, return which
 
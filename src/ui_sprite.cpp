@@ -1,20 +1,20 @@
 #include <string>
 #include <algorithm>
-#include <functional>
-#ifdef FPS_COUNTER
-# include <deque>
-# include <stdio.h>
-#endif
+#include <stdio.h>
 #include <assert.h>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_mixer.h>
 #include <SDL_ttf.h>
 #include "factory.hpp"
+#include "metrics.hpp"
 #include "platform.hpp"
+#include "tracezone.hpp"
 #include "ui.hpp"
 #include "ui_sprite.hpp"
 #include "ui_sprite_pointer.hpp"
+#include "ui_sprite_pool.hpp"
+#include "ui_sprite_scale.hpp"
 
 /* Yay for API changes on patchlevel versions! */
 #if SDL_IMAGE_MAJOR_VERSION >= 1
@@ -31,12 +31,38 @@
 class UserInterfaceSprite : public UserInterface {
 	bool fullscreen;
 	UserInterfaceSpriteResources resources;
-	UserInterfaceSpriteRenderer* renderer;
+	UserInterfaceSpriteTarget* screen; ///< Unless off-screen
+	UserInterfaceSpriteTarget* target; ///< Being drawn on; maybe screen
+	UserInterfaceSpritePool* pool;
+	UserInterfaceSpriteRenderer* renderer; ///< current; from the pool
 	GameStage::Type laststage;
+	int desktop_w, desktop_h; ///< As they were before we set a mode
+	bool smooth; ///< Scale up with filtering
+	Presentation presentation; ///< As asked for
+	bool flip; ///< As decided on: ask for a double-buffered mode
+
+public:
+	UserInterfaceSprite() : screen(NULL), target(NULL), pool(NULL),
+		renderer(NULL), desktop_w(0), desktop_h(0), smooth(false),
+		presentation(PRESENT_RECTS), flip(false), frames(NULL),
+		lastframe(-1), overlay(false), overlay_width(0),
+		overlay_ticks(0), overlay_frames(0) {
+
+		resources.ttflock = NULL;
+		overlay_text[0] = '\0';
+		for(int i = 0; i < 128 - 32; i++) { overlay_glyphs[i] = NULL; }
+	}
 
+private:
 	~UserInterfaceSprite() {
 		int dum1; Uint16 dum2; int dum3;
 		std::vector<char*> keys;
+		// Zap the renderers (first, as the pool may be using resources)
+		if(renderer) { renderer->leave(resources); renderer = 0; }
+		delete pool; pool = 0;
+		delete screen; screen = 0;
+		for(size_t b = 0; b < buffers.size(); b++)
+			{ delete buffers[b].target; }
 		// Free resources (can has C++0x type inference plz?)
 		TTF_CloseFont(resources.font_title);
 		TTF_CloseFont(resources.font_large);
@@ -47,6 +73,10 @@ class UserInterfaceSprite : public UserInterface {
 		}
 		for(int p = 0; p < PLAYERS; p++)
 			{ delete resources.playerpointers[p]; }
+		for(int i = 0; i < 128 - 32; i++) {
+			if(overlay_glyphs[i])
+				{ SDL_FreeSurface(overlay_glyphs[i]); }
+		}
 		/* See removeSuffix for why we're freeing the keys too. We have
 		 * to collect them up for later free(), else we'll pull them out
 		 * from under the hash iterator's operator++ (yay valgrind). */
@@ -63,8 +93,7 @@ class UserInterfaceSprite : public UserInterface {
 				SDL_FreeSurface(i->second); }
 		resources.textures.clear();
 		for_each(keys.begin(), keys.end(), free_functor());
-		// Zap the renderer
-		if(renderer) { delete renderer; renderer = 0; }
+		SDL_DestroyMutex(resources.ttflock);
 		// Shutdown Image, TTF and Mixer
 #ifdef IMG_NEEDS_INIT
 		IMG_Quit();
@@ -76,9 +105,134 @@ class UserInterfaceSprite : public UserInterface {
 	}
 
 private:
-#ifdef FPS_COUNTER
-	std::deque<int> fps_history;
-#endif
+	/* Off-screen, each frame is drawn in one of the sink's buffers, which
+	 * must first be brought up to date with the last frame. Only what has
+	 * been drawn since the buffer's own last frame needs copying, so we
+	 * keep a note of that for each. */
+	struct Buffer {
+		Uint32* pixels;
+		UserInterfaceSpriteTarget* target; ///< Drawing in the pixels
+		std::vector<SDL_Rect> stale; ///< Drawn on since its last frame
+	};
+	/// More stale rectangles than this, and we copy the lot
+	static const size_t MAX_STALE = 64;
+	FrameSink* frames;
+	std::vector<Buffer> buffers;
+	int lastframe; ///< Of buffers, or -1 before the first
+
+	/** Get the next buffer from the sink, and make it the target. */
+	bool nextFrame() {
+		const SDL_Rect all = {0, 0, 640, 480};
+		Uint32* pixels = frames->acquire();
+		size_t b;
+		for(b = 0; b < buffers.size(); b++)
+			{ if(buffers[b].pixels == pixels) { break; } }
+		// One new to us could hold anything
+		if(b == buffers.size()) {
+			Buffer fresh;
+			fresh.pixels = pixels;
+			fresh.target = UserInterfaceSpriteTarget::wrap(pixels,
+				all.w, all.h);
+			if(!fresh.target) { return false; }
+			SDL_FillRect(fresh.target->getSurface(), NULL, 0);
+			fresh.stale.assign(1, all);
+			buffers.push_back(fresh);
+		}
+		Buffer& buffer = buffers[b];
+		if(lastframe >= 0 && lastframe != (int) b) {
+			TRACE_ZONE("catch up frame");
+			SDL_Surface* from =
+				buffers[lastframe].target->getSurface();
+			for(std::vector<SDL_Rect>::iterator r =
+				buffer.stale.begin(); r != buffer.stale.end();
+				++r) {
+				SDL_Rect to = *r; // SDL_BlitSurface tramples
+				SDL_BlitSurface(from, &*r,
+					buffer.target->getSurface(), &to);
+			}
+		}
+		buffer.stale.clear();
+		target = buffer.target;
+		lastframe = b;
+		return true;
+	}
+
+	/** Pass the frame drawn in the target on to the sink. Returns how many
+	 *  pixels were drawn, as present() would. */
+	uint32_t submitFrame() {
+		const SDL_Rect all = {0, 0, 640, 480};
+		const std::vector<SDL_Rect>& drawn = target->getDirtyRects();
+		for(int b = 0; b < (int) buffers.size(); b++) {
+			if(b == lastframe) { continue; }
+			std::vector<SDL_Rect>& stale = buffers[b].stale;
+			stale.insert(stale.end(), drawn.begin(), drawn.end());
+			if(stale.size() > MAX_STALE) { stale.assign(1, all); }
+		}
+		const uint32_t pixels = target->present();
+		frames->submit(buffers[lastframe].pixels);
+		return pixels;
+	}
+
+	// Performance overlay; the glyphs are rendered once, on first use
+	bool overlay;
+	SDL_Surface* overlay_glyphs[128 - 32]; ///< Printable ASCII only
+	char overlay_text[64];
+	Uint16 overlay_width; ///< Of what was last drawn, to erase leftovers
+	uint32_t overlay_ticks;
+	uint32_t overlay_frames;
+
+	/** Draw the overlay text from the glyph cache, updating the numbers
+	 *  about once a second. Compared to TTF-rendering the whole string
+	 *  every frame, this is cheap enough not to distort what it shows. */
+	void drawOverlay(GameStage::Type stage, uint32_t ticks) {
+		overlay_ticks += ticks;
+		overlay_frames++;
+		if(overlay_ticks >= 100) {
+			const Metrics& m = Metrics::global();
+			const Histogram& render =
+				m.get(Metrics::RENDER_US, stage);
+			snprintf(overlay_text, sizeof overlay_text,
+				"%3u FPS  render %.1f/%.1fms  sim %uus",
+				(overlay_frames * 100) / overlay_ticks,
+				render.percentile(50) / 1000.0,
+				render.percentile(99) / 1000.0,
+				m.get(Metrics::SIMULATE_US, stage)
+					.percentile(50));
+			overlay_ticks = overlay_frames = 0;
+		}
+		const SDL_Color white = {255, 255, 255, 0};
+		SDL_Surface* surface = target->getSurface();
+		const Uint32 black =
+			target->mapRGB(UserInterfaceSpriteConstants::black);
+		SDL_Rect pos = {0, 0, 0, 0};
+		for(const char* c = overlay_text; *c; c++) {
+			if(*c < 32 || *c > 126) { continue; }
+			SDL_Surface*& glyph = overlay_glyphs[*c - 32];
+			if(!glyph) {
+				char str[2] = {*c, '\0'};
+				glyph = resources.renderText(
+					resources.font_small, str, white);
+				if(!glyph) { continue; }
+			}
+			SDL_Rect box = {pos.x, 0, static_cast<Uint16>(glyph->w),
+				static_cast<Uint16>(glyph->h)};
+			SDL_FillRect(surface, &box, black);
+			pos = box; // SDL_BlitSurface will trample
+			SDL_BlitSurface(glyph, NULL, surface, &pos);
+			pos.x = box.x + box.w;
+			if(box.h > pos.h) { pos.h = box.h; }
+		}
+		if(pos.x < overlay_width) { // Erase the tail of a longer line
+			SDL_Rect tail = {pos.x, 0,
+				static_cast<Uint16>(overlay_width - pos.x),
+				pos.h};
+			SDL_FillRect(surface, &tail, black);
+		}
+		target->updateRect(0, 0,
+			pos.x > overlay_width ? pos.x : overlay_width, pos.h);
+		overlay_width = pos.x;
+	}
+
 	const char* getDataDir() { return "data/"; }
 	const char* findFontFile() { return "data/mainfont.ttf"; }
 	const char* findThemeMusicFile() { return "data/theme.mp3"; }
@@ -125,18 +279,46 @@ private:
 		}
 	}
 
+	/* Everything is drawn at 640x480, and scaled up by the screen target
+	 * to fill the mode we get: fullscreen, the desktop's own, so that the
+	 * monitor needn't stretch it (blurrily, and out of shape); windowed,
+	 * as many times 640x480 as fits comfortably on the desktop. */
+	void chooseMode(int& w, int& h) const {
+		w = 640; h = 480;
+		if(fullscreen) {
+			if(desktop_w >= w && desktop_h >= h)
+				{ w = desktop_w; h = desktop_h; }
+		} else {
+			const int scale = std::min(
+				std::min(desktop_w * 9 / 10 / w,
+				desktop_h * 9 / 10 / h),
+				UserInterfaceSpriteScale::MAX_SCALE);
+			if(scale > 1) { w *= scale; h *= scale; }
+		}
+	}
+
+	/* Scaling needs 32bpp, which SDL will emulate if it must. Flipping
+	 * was a performance hit on Felix/Win98 (95 FPS -> 40), and may be a
+	 * help elsewhere; see choosePresentation(). */
 	bool setupVideo() {
-		if(SDL_SetVideoMode(640, 480, 0,
+		int w, h;
+		chooseMode(w, h);
+		if(SDL_SetVideoMode(w, h, (w == 640 && h == 480) ? 0 : 32,
 #ifdef __APPLE__ /* Without this, blitting in toggleFullscreen fails */
 			SDL_HWSURFACE |
 #endif
-#ifdef DOUBLE_BUFFER /* Performance hit on Felix/Win98; 95 FPS -> 40. */
-			SDL_HWSURFACE | SDL_DOUBLEBUF |
-#endif
+			(flip ? SDL_HWSURFACE | SDL_DOUBLEBUF : 0) |
 			SDL_HWPALETTE | (fullscreen ? SDL_FULLSCREEN : 0))) {
-			trace("Got %s video at %dbpp",
-				(fullscreen ? "fullscreen" : "windowed"),
-				SDL_GetVideoSurface()->format->BitsPerPixel);
+			delete screen;
+			screen = target =
+				UserInterfaceSpriteTarget::screen(640, 480);
+			if(!screen) { return false; }
+			screen->setSmooth(smooth);
+			trace("Got %s %dx%d video at %dbpp%s",
+				(fullscreen ? "fullscreen" : "windowed"), w, h,
+				screen->getFormat()->BitsPerPixel,
+				(SDL_GetVideoSurface()->flags & SDL_DOUBLEBUF) ?
+				", double-buffered" : "");
 			return true;
 		} else {
 			warn("Unable to set video mode: %s", SDL_GetError());
@@ -144,6 +326,141 @@ private:
 		}
 	}
 
+	/** Mean microseconds to present a frame, flipping or not, over a few
+	 *  like most: a couple of pointers moving, and a line of text every so
+	 *  often. They're drawn in black, on black, so there's nothing to see.
+	 *  (The most if there's no such video mode.) */
+	uint32_t measurePresentation(bool flip) {
+		static const int WARMUP = 5, FRAMES = 40;
+		this->flip = flip;
+		if(!setupVideo()) { return 0xffffffff; }
+		SDL_Surface* surface = screen->getSurface();
+		const Uint32 black =
+			screen->mapRGB(UserInterfaceSpriteConstants::black);
+		Histogram times;
+		for(int f = 0; f < WARMUP + FRAMES; f++) {
+			SDL_Rect drawn[3] = {
+				{static_cast<Sint16>(f * 8), 200, 32, 32},
+				{300, static_cast<Sint16>(f * 6), 32, 32},
+				{0, 440, 640, 24}};
+			for(int d = 0; d < (f % 4 ? 2 : 3); d++) {
+				SDL_FillRect(surface, &drawn[d], black);
+				screen->updateRect(drawn[d].x, drawn[d].y,
+					drawn[d].w, drawn[d].h);
+			}
+			const uint64_t start = platform_microseconds();
+			screen->present();
+			if(f >= WARMUP) {
+				times.record(platform_microseconds()
+					- start);
+			}
+		}
+		return (uint32_t) times.mean();
+	}
+
+	/** The video driver and the mode we'd ask for, as the cache of
+	 *  measurements (see choosePresentation()) knows them. */
+	void presentationKey(char* key, size_t size) const {
+		char driver[32];
+		if(!SDL_VideoDriverName(driver, sizeof driver))
+			{ strcpy(driver, "unknown"); }
+		int w, h;
+		chooseMode(w, h);
+		snprintf(key, size, "%s,%dx%d,%s", driver, w, h,
+			fullscreen ? "fullscreen" : "windowed");
+	}
+
+	bool readPresentation(const char* key, bool& flip, unsigned& rects_us,
+		unsigned& flip_us) const {
+
+		char path[512];
+		if(!platform_statefile("present.csv", path, sizeof path))
+			{ return false; }
+		FILE* in = fopen(path, "r");
+		if(!in) { return false; }
+		const size_t keylen = strlen(key);
+		char line[256];
+		bool found = false;
+		while(!found && fgets(line, sizeof line, in)) {
+			char how[8];
+			if(strncmp(line, key, keylen) || line[keylen] != ',')
+				{ continue; }
+			if(sscanf(line + keylen + 1, "%7[a-z],%u,%u", how,
+				&rects_us, &flip_us) == 3) {
+				flip = !strcmp(how, "flip");
+				found = true;
+			}
+		}
+		fclose(in);
+		return found;
+	}
+
+	/** Replace the key's line in the cache, keeping everyone else's. */
+	void writePresentation(const char* key, bool flip, unsigned rects_us,
+		unsigned flip_us) const {
+
+		char path[512];
+		if(!platform_statefile("present.csv", path, sizeof path))
+			{ return; }
+		std::vector<std::string> others;
+		if(FILE* in = fopen(path, "r")) {
+			const size_t keylen = strlen(key);
+			char line[256];
+			while(fgets(line, sizeof line, in)) {
+				if(strncmp(line, key, keylen)
+				|| line[keylen] != ',')
+					{ others.push_back(line); }
+			}
+			fclose(in);
+		}
+		FILE* out = fopen(path, "w");
+		if(!out) {
+			warn("Unable to write %s", path);
+			return;
+		}
+		for(size_t o = 0; o < others.size(); o++)
+			{ fputs(others[o].c_str(), out); }
+		fprintf(out, "%s,%s,%u,%u\n", key, flip ? "flip" : "rects",
+			rects_us, flip_us);
+		fclose(out);
+	}
+
+	/** Settle whether to flip: as asked, or as was faster when last
+	 *  measured for this driver and mode, or by measuring now (which takes
+	 *  a second or so, and is cached in present.csv in the settings
+	 *  directory). Note the choice and any timings in the metrics, and set
+	 *  the video mode. The choice stands if the mode is later toggled. */
+	bool choosePresentation() {
+		char key[64];
+		const char* why = "asked for";
+		unsigned rects_us = 0, flip_us = 0;
+		presentationKey(key, sizeof key);
+		switch(presentation) {
+			case PRESENT_RECTS: flip = false; break;
+			case PRESENT_FLIP:  flip = true;  break;
+			case PRESENT_AUTO:
+				if(readPresentation(key, flip, rects_us,
+					flip_us)) { why = "cached"; break; }
+				// Fall through
+			case PRESENT_TEST:
+				rects_us = measurePresentation(false);
+				flip_us  = measurePresentation(true);
+				flip = flip_us < rects_us;
+				why = "measured";
+				writePresentation(key, flip, rects_us, flip_us);
+				break;
+		}
+		Metrics& metrics = Metrics::global();
+		metrics.note("present", "%s (%s)", flip ? "flip" : "rects",
+			why);
+		metrics.note("present_mode", "%s", key);
+		if(rects_us || flip_us) {
+			metrics.note("present_rects_us", "%u", rects_us);
+			metrics.note("present_flip_us", "%u", flip_us);
+		}
+		return setupVideo();
+	}
+
 public:
 	bool init(bool fullscreen) {
 		// Initialise the SDL subsystems
@@ -154,9 +471,12 @@ public:
 		// Set up the window (icon must be done before video mode)
 		SDL_WM_SetCaption("M.E.W.L.", "M.E.W.L.");
 		// SDL_WM_SetIcon(...32x32 surface..., NULL); // TODO
-		// Set the video mode
+		// Set the video mode (noting the desktop's size first)
+		const SDL_VideoInfo* info = SDL_GetVideoInfo();
+		desktop_w = info->current_w;
+		desktop_h = info->current_h;
 		this->fullscreen = fullscreen;
-		if(!setupVideo()) { return false; }
+		if(!choosePresentation()) { return false; }
 		// Lose the mouse cursor
 		SDL_ShowCursor(SDL_DISABLE);
 		// Initialise mixer
@@ -164,6 +484,21 @@ public:
 			warn("Unable to initialise Mixer: %s", Mix_GetError());
 			return false;
 		}
+		return loadResources(true);
+	}
+
+	/* Needs no video or audio: everything is drawn in the sink's buffers,
+	 * which are software surfaces as far as SDL is concerned. */
+	bool initOffscreen(FrameSink& frames) {
+		if(!frames.open(640, 480)) { return false; }
+		this->frames = &frames;
+		return loadResources(false);
+	}
+
+private:
+	/** Everything but the display and mixer, which must be up first if
+	 *  wanted; without music, the renderers' Mix_ calls do nothing. */
+	bool loadResources(bool music) {
 		// Initialise TTF
 		if(TTF_Init() < 0) {
 			warn("Unable to initialise TTF: %s", TTF_GetError());
@@ -178,6 +513,10 @@ public:
 #endif
 		// Load font
 		const char* fontfile = findFontFile();
+		if(!(resources.ttflock = SDL_CreateMutex())) {
+			warn("Unable to create font lock: %s", SDL_GetError());
+			return false;
+		}
 		resources.font_title = TTF_OpenFont(fontfile, 64);
 		resources.font_large = TTF_OpenFont(fontfile, 24);
 		resources.font_small = TTF_OpenFont(fontfile, 16);
@@ -194,136 +533,94 @@ public:
 			) { return false; }
 		// Load audio samples TODO
 		// Load music (failure is nonfatal)
-		if(!(resources.music_theme = Mix_LoadMUS(findThemeMusicFile())))
+		resources.music_theme = NULL;
+		if(music && !(resources.music_theme =
+			Mix_LoadMUS(findThemeMusicFile())))
 			{ warn("Unable to load music: %s", Mix_GetError()); }
 		resources.music_theme_bpm = 120; // Correct for Mule-Funk-Shun
 		// Generate player pointers
 		for(int p = 0; p < PLAYERS; p++) {
 			resources.playerpointers[p] = new
-				UserInterfaceSpritePointer(resources,
+				UserInterfaceSpritePointer(
 				UserInterfaceSpriteConstants::col_player[p],
 				resources.textures["pointer-centre"],
 				resources.textures["pointer-north"],
 				resources.textures["pointer-northeast"]);
 		}
 		// Other initialisation
+		pool = new UserInterfaceSpritePool(resources);
 		renderer = NULL;
 		laststage = GameStage::SCOREBOARD; // carefully crafted lie
 		// Done
 		return true;
 	}
 
+public:
+	void anticipate(GameStage::Mask stages) { pool->anticipate(stages); }
+
+	void setPresentation(Presentation presentation)
+		{ this->presentation = presentation; }
+
+	void toggleOverlay() { overlay = !overlay; }
+
+	void toggleSmoothing() {
+		smooth = !smooth;
+		if(screen) { screen->setSmooth(smooth); }
+	}
+
 	void toggleFullscreen() {
+		if(!screen) { return; }
 		// Preserve the framebuffer, else we may lose e.g. background
-		SDL_Surface* screen = SDL_GetVideoSurface();
-		SDL_Surface* liferaft = SDL_CreateRGBSurface(SDL_HWSURFACE,
-			screen->w, screen->h, screen->format->BitsPerPixel,
-			screen->format->Rmask, screen->format->Gmask,
-			screen->format->Bmask, screen->format->Amask);
-		SDL_BlitSurface(screen, NULL, liferaft, NULL);
-		// Make the change
+		UserInterfaceSpriteTarget* liferaft =
+			UserInterfaceSpriteTarget::offscreen(screen->getWidth(),
+			screen->getHeight(), screen->getFormat());
+		if(!liferaft) { return; }
+		SDL_BlitSurface(screen->getSurface(), NULL,
+			liferaft->getSurface(), NULL);
+		// Make the change (which makes a new screen target)
 		fullscreen = !fullscreen;
 		setupVideo();
 		// Restore the framebuffer
-		SDL_BlitSurface(liferaft, NULL, screen, NULL);
-		SDL_FreeSurface(liferaft);
-		SDL_Flip(screen); // or SDL_UpdateRect(screen, 0, 0, 0, 0);
+		SDL_BlitSurface(liferaft->getSurface(), NULL,
+			screen->getSurface(), NULL);
+		delete liferaft;
+		screen->updateAll();
+		screen->present();
 	}
 
 	bool render(GameStage::Type stage, GameSetup& setup, Game* game,
 		GameStageState& state, uint32_t ticks) {
 
-		bool allowtransition = renderer ?
-			renderer->render(stage, setup, game, state, ticks,
-				resources)
-			: true;
+		bool allowtransition = true;
+		if(frames && !nextFrame()) { return true; }
+		if(renderer) {
+			TRACE_ZONE("Renderer::render",
+				Metrics::getStageName(laststage));
+			allowtransition = renderer->render(stage, setup, game,
+				state, ticks, resources, *target);
+		}
 		
 		if(allowtransition && (stage != laststage)) {
-			std::string rc("UserInterfaceSprite");
-			if(renderer) { delete renderer; renderer = NULL; }
-			switch(stage) {
-				case GameStage::TITLE: rc += "Title"; break;
-				case GameStage::COLOUR: rc += "Colour"; break;
-				case GameStage::SPECIES: rc += "Species"; break;
-				case GameStage::SCOREBOARD:
-					rc += "Scoreboard"; break;
-				case GameStage::LANDGRAB:
-					rc += "LandGrab"; break;
-				case GameStage::LANDAUCTION:
-					rc += "LandAuction"; break;
-				case GameStage::PREAUCTION:
-					rc += "PreAuction"; break;
-				case GameStage::AUCTIONDECLARE:
-					rc += "AuctionDeclare"; break;
-				case GameStage::AUCTION:
-					rc += "Auction"; break;
-				case GameStage::PREDEVELOP:
-					rc += "PreDevelop"; break;
-				case GameStage::DEVELOPHUMAN:
-					rc += "DevelopHuman"; break;
-				case GameStage::WAMPUS:
-					rc += "Wampus"; break;
-				case GameStage::DEVELOPCOMP:
-					rc += "DevelopComp"; break;
-				case GameStage::POSTDEVELOP:
-					rc += "PostDevelop"; break;
-				case GameStage::PREPRODUCT:
-					rc += "PreProduct"; break;
-				case GameStage::PRODUCT:
-					rc += "Product"; break;
-				case GameStage::POSTPRODUCT:
-					rc += "PostProduct"; break;
+			if(renderer) {
+				renderer->leave(resources);
+				pool->release(laststage);
 			}
-			renderer = FACTORY_FOR(UserInterfaceSpriteRenderer)
-				.create(rc.c_str());
-			if(!renderer) {
-				warn("Miscompiled: class '%s' missing from UI.",
-					rc.c_str());
-				die();
-			}
-			renderer->init(stage, setup, game, ticks, resources);
+			renderer = pool->acquire(stage);
+			TRACE_ZONE("Renderer::init",
+				Metrics::getStageName(stage));
+			renderer->init(stage, setup, game, ticks, resources,
+				*target);
 			laststage = stage;
 		}
 
-#ifdef FPS_COUNTER
-		{ // FPS counter for diagnostics
-			char str[8];
-			SDL_Color white = {255, 255, 255, 0};
-			SDL_Surface* screen = SDL_GetVideoSurface();
-			fps_history.push_back(100 / ticks);
-			if(fps_history.size() > 32) { fps_history.pop_front(); }
-			int sumfps = 0;
-			for(std::deque<int>::iterator i = fps_history.begin();
-				i < fps_history.end(); i++) { sumfps += *i; }
-			snprintf(str,7, "%3d",(int)(sumfps/fps_history.size()));
-			str[7] = '\0';
-			SDL_Surface* sur = resources.renderText(
-				resources.font_small, str, white);
-			SDL_Rect rect = {0, 0,
-				static_cast<Uint16>(sur->w), static_cast<Uint16>(sur->h)};
-			SDL_FillRect(screen, &rect,
-				SDL_MapRGB(screen->format, 0, 0, 0));
-			SDL_BlitSurface(sur, NULL, screen, NULL);
-			resources.updateRect(0, 0, sur->w, sur->h);
-			SDL_FreeSurface(sur);
-		}
-#endif
-#ifdef DOUBLE_BUFFER
-		SDL_Flip(SDL_GetVideoSurface());
-#else
-		/* Theoretically, the documentation suggests attempting to avoid
-		 * overdraw here. Realistically, there's not much we can do
-		 * about that without subdivision, and apparently SDL ships out
-		 * all the rectangles in one go to the graphics driver, so we'll
-		 * let that do it if it feels so inclined. (We _could_ remove
-		 * trivially subsumed rectangles, or replace them all with a
-		 * tight bounding rectangle, but neither fits our usage pattern
-		 * well.) */
-		SDL_UpdateRects(SDL_GetVideoSurface(),
-			resources.dirtyrects.size(),
-			&resources.dirtyrects[0]); /* docs imply this is safe */
-		resources.dirtyrects.clear();
-#endif
+		if(overlay) { drawOverlay(stage, ticks); }
+
+		Metrics& metrics = Metrics::global();
+		uint64_t start = platform_microseconds();
+		metrics.record(Metrics::DIRTY_PIXELS, stage,
+			frames ? submitFrame() : screen->present());
+		metrics.record(Metrics::UPDATE_US, stage,
+			platform_microseconds() - start);
 
 		return allowtransition;
 	}
@@ -331,75 +628,353 @@ public:
 /* Register with the factory */
 FACTORY_REGISTER_IMPL(UserInterface,UserInterfaceSprite)
 
-void UserInterfaceSpriteResources::updateRect(
+UserInterfaceSpriteTarget::UserInterfaceSpriteTarget(Kind kind,
+	SDL_Surface* surface, Uint8 shrink) : kind(kind), surface(surface),
+	shrink(shrink), alldirty(false), display(NULL), scale(1),
+	smooth(false), flipping(false) {
+
+	placement.x = placement.y = 0;
+	placement.w = placement.h = 0;
+}
+
+/* Our own surfaces are software ones: they are read back at least as often as
+ * they are drawn on, which is slow from video memory, and hardware surfaces
+ * may only be touched by the thread which set the video mode. */
+static SDL_Surface* createSurface(Uint16 w, Uint16 h,
+	const SDL_PixelFormat* format) {
+
+	SDL_Surface* surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h,
+		format->BitsPerPixel,
+		format->Rmask, format->Gmask, format->Bmask, format->Amask);
+	if(!surface) {
+		warn("Unable to create %dx%d surface: %s", w, h,
+			SDL_GetError());
+		return NULL;
+	}
+	if(format->palette) {
+		SDL_SetColors(surface, format->palette->colors, 0,
+			format->palette->ncolors);
+	}
+	return surface;
+}
+
+UserInterfaceSpriteTarget* UserInterfaceSpriteTarget::screen(Uint16 w,
+	Uint16 h) {
+
+	SDL_Surface* display = SDL_GetVideoSurface();
+	const bool flipping =
+		(display->flags & SDL_DOUBLEBUF) == SDL_DOUBLEBUF;
+	int scale = display->w / w < display->h / h ?
+		display->w / w : display->h / h;
+	if(scale > UserInterfaceSpriteScale::MAX_SCALE)
+		{ scale = UserInterfaceSpriteScale::MAX_SCALE; }
+	/* We can draw straight on the display if it's the size we draw at and
+	 * keeps what we draw; a double-buffered one shows each buffer in turn,
+	 * so then we keep the picture, and copy it all over for each flip. */
+	bool direct = (display->w == w && display->h == h && !flipping)
+		|| scale < 1;
+	if(!direct && scale > 1 && display->format->BitsPerPixel != 32) {
+		warn("Unable to scale up to %dbpp video",
+			display->format->BitsPerPixel);
+		direct = true;
+	}
+	UserInterfaceSpriteTarget* target;
+	if(direct) {
+		target = new UserInterfaceSpriteTarget(SCREEN, display, 1);
+	} else {
+		SDL_Surface* surface = createSurface(w, h, display->format);
+		if(!surface) { return NULL; }
+		target = new UserInterfaceSpriteTarget(SCREEN, surface, 1);
+		target->scale = scale;
+		target->placement.x = (display->w - w * scale) / 2;
+		target->placement.y = (display->h - h * scale) / 2;
+		target->placement.w = w * scale;
+		target->placement.h = h * scale;
+		// Black borders, which are never drawn again; in both buffers
+		SDL_FillRect(display, NULL, 0);
+		SDL_Flip(display);
+		SDL_FillRect(display, NULL, 0);
+	}
+	target->display = display;
+	target->flipping = flipping;
+	return target;
+}
+
+UserInterfaceSpriteTarget* UserInterfaceSpriteTarget::offscreen(Uint16 w,
+	Uint16 h, const SDL_PixelFormat* format) {
+
+	SDL_Surface* surface = createSurface(w, h, format);
+	if(!surface) { return NULL; }
+	return new UserInterfaceSpriteTarget(OFFSCREEN, surface, 1);
+}
+
+UserInterfaceSpriteTarget* UserInterfaceSpriteTarget::wrap(Uint32* pixels,
+	Uint16 w, Uint16 h) {
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(pixels, w, h, 32,
+		w * 4, 0xff0000, 0x00ff00, 0x0000ff, 0);
+	if(!surface) {
+		warn("Unable to create %dx%d surface: %s", w, h,
+			SDL_GetError());
+		return NULL;
+	}
+	return new UserInterfaceSpriteTarget(OFFSCREEN, surface, 1);
+}
+
+UserInterfaceSpriteTarget* UserInterfaceSpriteTarget::thumbnail(
+	const UserInterfaceSpriteTarget& source, Uint8 shrink) {
+
+	assert(shrink > 0);
+	SDL_Surface* surface = createSurface(source.getWidth() / shrink,
+		source.getHeight() / shrink, source.getFormat());
+	if(!surface) { return NULL; }
+	UserInterfaceSpriteTarget* target =
+		new UserInterfaceSpriteTarget(THUMBNAIL, surface, shrink);
+	// Catch up with whatever is already there
+	SDL_SoftStretch(source.surface, NULL, surface, NULL);
+	target->updateAll();
+	return target;
+}
+
+UserInterfaceSpriteTarget::~UserInterfaceSpriteTarget()
+	{ if(surface != display) { SDL_FreeSurface(surface); } }
+
+UserInterfaceSpriteTarget::Kind UserInterfaceSpriteTarget::getKind() const
+	{ return kind; }
+
+SDL_Surface* UserInterfaceSpriteTarget::getSurface() const
+	{ return surface; }
+
+const SDL_PixelFormat* UserInterfaceSpriteTarget::getFormat() const
+	{ return surface->format; }
+
+Uint16 UserInterfaceSpriteTarget::getWidth() const { return surface->w; }
+
+Uint16 UserInterfaceSpriteTarget::getHeight() const { return surface->h; }
+
+Uint32 UserInterfaceSpriteTarget::mapRGB(SDL_Color colour) const
+	{ return SDL_MapRGB(surface->format, colour.r, colour.g, colour.b); }
+
+void UserInterfaceSpriteTarget::updateRect(
 	Sint16 x, Sint16 y, Uint16 w, Uint16 h) {
-#ifndef DOUBLE_BUFFER /* Don't track what we don't use (or clear!) */
-	SDL_Surface* screen = SDL_GetVideoSurface();
-	Uint16 sw = screen->w - 1;
-	Uint16 sh = screen->h - 1;
-	SDL_Rect rect;
-	 // Offscreen sprites may clip away to nothing
-	if(x < 0) { w += x; x = 0; if(w <= 0) { return; }}
-	rect.x = x > sw ? sw : x; sw -= rect.x;
-	if(sw == 0) { return; }
-	if(y < 0) { h += y; y = 0; if(h <= 0) { return; }}
-	rect.y = y > sh ? sh : y; sh -= rect.y;
-	if(sh == 0) { return; }
-	rect.w = w > sw ? sw : w;
-	rect.h = h > sh ? sh : h;
+
+	if(alldirty) { return; }
+	// Offscreen sprites may clip away to nothing
+	const int left   = x < 0 ? 0 : x;
+	const int top    = y < 0 ? 0 : y;
+	const int right  = x + w > surface->w ? surface->w : x + w;
+	const int bottom = y + h > surface->h ? surface->h : y + h;
+	if(right <= left || bottom <= top) { return; }
+	SDL_Rect rect = {static_cast<Sint16>(left), static_cast<Sint16>(top),
+		static_cast<Uint16>(right - left),
+		static_cast<Uint16>(bottom - top)};
 	dirtyrects.push_back(rect);
-#endif
+}
+
+void UserInterfaceSpriteTarget::updateAll() {
+	SDL_Rect all = {0, 0, getWidth(), getHeight()};
+	dirtyrects.assign(1, all);
+	alldirty = true;
+}
+
+const std::vector<SDL_Rect>& UserInterfaceSpriteTarget::getDirtyRects() const
+	{ return dirtyrects; }
+
+void UserInterfaceSpriteTarget::follow(
+	const UserInterfaceSpriteTarget& source) {
+
+	assert(kind == THUMBNAIL);
+	for(std::vector<SDL_Rect>::const_iterator r =
+		source.dirtyrects.begin(); r != source.dirtyrects.end(); ++r) {
+		/* Widen each rectangle out to whole blocks of the source, so
+		 * that a block is always sampled from the same pixel, whichever
+		 * rectangles it is redrawn as part of. */
+		const int left = r->x / shrink;
+		const int top  = r->y / shrink;
+		int right  = (r->x + r->w + shrink - 1) / shrink;
+		int bottom = (r->y + r->h + shrink - 1) / shrink;
+		if(right  > surface->w) { right  = surface->w; }
+		if(bottom > surface->h) { bottom = surface->h; }
+		if(right <= left || bottom <= top) { continue; }
+		SDL_Rect to = {static_cast<Sint16>(left),
+			static_cast<Sint16>(top),
+			static_cast<Uint16>(right - left),
+			static_cast<Uint16>(bottom - top)};
+		SDL_Rect from = {static_cast<Sint16>(to.x * shrink),
+			static_cast<Sint16>(to.y * shrink),
+			static_cast<Uint16>(to.w * shrink),
+			static_cast<Uint16>(to.h * shrink)};
+		SDL_SoftStretch(source.surface, &from, surface, &to);
+		updateRect(to.x, to.y, to.w, to.h);
+	}
+}
+
+void UserInterfaceSpriteTarget::setSmooth(bool smooth) {
+	if(smooth == this->smooth) { return; }
+	this->smooth = smooth;
+	updateAll();
+}
+
+static inline Sint16 clamp(int i, int size)
+	{ return i < 0 ? 0 : (i >= size ? size - 1 : i); }
+
+void UserInterfaceSpriteTarget::fromDisplay(double x, double y,
+	Sint16& tx, Sint16& ty) const {
+
+	const SDL_Surface* shown = display ? display : surface;
+	tx = clamp((int) (x * shown->w - placement.x) / scale, surface->w);
+	ty = clamp((int) (y * shown->h - placement.y) / scale, surface->h);
+}
+
+/* Scale what has changed up on to the display, and make the dirty rectangles
+ * the display's, ready for updating. */
+void UserInterfaceSpriteTarget::upscale() {
+	TRACE_ZONE("upscale");
+	std::vector<SDL_Rect> rects;
+	if(flipping) {
+		// Each flip shows the other buffer, which missed the last
+		SDL_Rect all = {0, 0, getWidth(), getHeight()};
+		rects.assign(1, all);
+	} else {
+		rects = dirtyrects;
+	}
+	if(smooth && !flipping) {
+		for(std::vector<SDL_Rect>::iterator r = rects.begin();
+			r != rects.end(); ++r) {
+			const int left = r->x > 0 ? r->x - 1 : 0;
+			const int top  = r->y > 0 ? r->y - 1 : 0;
+			const int right  = r->x + r->w < surface->w ?
+				r->x + r->w + 1 : surface->w;
+			const int bottom = r->y + r->h < surface->h ?
+				r->y + r->h + 1 : surface->h;
+			r->x = left; r->y = top;
+			r->w = right - left; r->h = bottom - top;
+		}
+	}
+	UserInterfaceSpriteScale::merge(rects);
+	if(scale == 1) { // Just copying
+		for(std::vector<SDL_Rect>::iterator r = rects.begin();
+			r != rects.end(); ++r) {
+			SDL_Rect to = {static_cast<Sint16>(placement.x + r->x),
+				static_cast<Sint16>(placement.y + r->y),
+				r->w, r->h};
+			SDL_BlitSurface(surface, &*r, display, &to);
+			*r = to;
+		}
+		dirtyrects.swap(rects);
+		return;
+	}
+	if(SDL_LockSurface(display) < 0) {
+		warn("Unable to lock display: %s", SDL_GetError());
+		return;
+	}
+	for(std::vector<SDL_Rect>::iterator r = rects.begin();
+		r != rects.end(); ++r) {
+		const int x = placement.x + r->x * scale;
+		const int y = placement.y + r->y * scale;
+		if(smooth) {
+			UserInterfaceSpriteScale::smooth(surface, *r, display,
+				x, y, scale);
+		} else {
+			UserInterfaceSpriteScale::nearest(surface, *r, display,
+				x, y, scale);
+		}
+		r->x = x; r->y = y;
+		r->w *= scale; r->h *= scale;
+	}
+	SDL_UnlockSurface(display);
+	dirtyrects.swap(rects);
+}
+
+uint32_t UserInterfaceSpriteTarget::present() {
+	uint32_t pixels = 0;
+	for(std::vector<SDL_Rect>::const_iterator r = dirtyrects.begin();
+		r != dirtyrects.end(); ++r) { pixels += r->w * r->h; }
+	if(kind == SCREEN) {
+		if(surface != display) { upscale(); }
+		if(flipping) {
+			TRACE_ZONE("SDL_Flip");
+			SDL_Flip(display);
+			pixels = surface->w * surface->h;
+		} else {
+			/* Theoretically, the documentation suggests attempting
+			 * to avoid overdraw here. Realistically, there's not
+			 * much we can do about that without subdivision, and
+			 * apparently SDL ships out all the rectangles in one go
+			 * to the graphics driver, so we'll let that do it if it
+			 * feels so inclined. (We _could_ remove trivially
+			 * subsumed rectangles, or replace them all with a tight
+			 * bounding rectangle, but neither fits our usage
+			 * pattern well.) */
+			TRACE_ZONE("SDL_UpdateRects");
+			/* docs imply &dirtyrects[0] is safe even when empty */
+			SDL_UpdateRects(display, dirtyrects.size(),
+				&dirtyrects[0]);
+		}
+	}
+	dirtyrects.clear();
+	alldirty = false;
+	return pixels;
 }
 
 SDL_Surface* UserInterfaceSpriteResources::renderText(TTF_Font* font,
 	const char* text, SDL_Color colour) {
 
+	TRACE_ZONE("renderText");
 	SDL_Surface* s;
+	SDL_LockMutex(ttflock);
 	s = TTF_RenderUTF8_Blended(font, text, colour);
 	if(!s) { warn("TTF error: %s", TTF_GetError()); }
+	SDL_UnlockMutex(ttflock);
 	return s;
 }
 
-bool UserInterfaceSpriteResources::displayTextLine(TTF_Font* font,
-	const char* text, SDL_Color foreground, SDL_Color background, Sint16 y) {
+bool UserInterfaceSpriteResources::displayTextLine(
+	UserInterfaceSpriteTarget& target, TTF_Font* font, const char* text,
+	SDL_Color foreground, SDL_Color background, Sint16 y) {
 
-	SDL_Surface* screen = SDL_GetVideoSurface();
-	SDL_Rect bar = {0, y, 640, 0};
 	SDL_Surface* textpix = renderText(font, text, foreground);
 	if(!textpix) { return false; }
-	bar.h = textpix->h;
-	SDL_FillRect(screen, &bar, SDL_MapRGB(screen->format,
-		background.r, background.g, background.b));
-	bar.w = textpix->w;
-	bar.x = (screen->w - bar.w) / 2;
-	SDL_BlitSurface(textpix, NULL, screen, &bar);
+	displaySurfaceLine(target, textpix, background, y);
 	SDL_FreeSurface(textpix);
-	updateRect(0, y, 640, bar.h);
 	return true;
 }
 
+void UserInterfaceSpriteResources::displaySurfaceLine(
+	UserInterfaceSpriteTarget& target, SDL_Surface* textpix,
+	SDL_Color background, Sint16 y) {
+
+	SDL_Rect bar = {0, y, target.getWidth(),
+		static_cast<Uint16>(textpix->h)};
+	SDL_FillRect(target.getSurface(), &bar, target.mapRGB(background));
+	bar.w = textpix->w;
+	bar.x = (target.getWidth() - bar.w) / 2;
+	SDL_BlitSurface(textpix, NULL, target.getSurface(), &bar);
+	target.updateRect(0, y, target.getWidth(), bar.h);
+}
+
 void UserInterfaceSpriteResources::displaySprites(
+	UserInterfaceSpriteTarget& target,
 	const std::vector<UserInterfaceSpriteSprite*>& sprites) {
 	
-	SDL_Surface* screen = SDL_GetVideoSurface();
-	for_each(sprites.begin(), sprites.end(), std::bind2nd(
-		std::mem_fun(&UserInterfaceSpriteSprite::save), screen));
-	for_each(sprites.begin(), sprites.end(), std::bind2nd(
-		std::mem_fun(&UserInterfaceSpriteSprite::draw), screen));
+	std::vector<UserInterfaceSpriteSprite*>::const_iterator s;
+	for(s = sprites.begin(); s != sprites.end(); ++s)
+		{ (*s)->save(target); }
+	for(s = sprites.begin(); s != sprites.end(); ++s)
+		{ (*s)->draw(target); }
 }
 
 void UserInterfaceSpriteResources::eraseSprites(
+	UserInterfaceSpriteTarget& target,
 	const std::vector<UserInterfaceSpriteSprite*>& sprites) {
 	
-	SDL_Surface* screen = SDL_GetVideoSurface();
-	for_each(sprites.begin(), sprites.end(),
-		std::bind2nd(std::mem_fun(&UserInterfaceSpriteSprite::restore),
-			screen));
+	std::vector<UserInterfaceSpriteSprite*>::const_iterator s;
+	for(s = sprites.begin(); s != sprites.end(); ++s)
+		{ (*s)->restore(target); }
 }
 
-UserInterfaceSpriteSprite::UserInterfaceSpriteSprite(
-	UserInterfaceSpriteResources& resources, const SDL_Surface* pixmap)
-	: resources(resources), saved(false), visible(true), pixmap(pixmap) {
+UserInterfaceSpriteSprite::UserInterfaceSpriteSprite(const SDL_Surface* pixmap)
+	: saved(false), visible(true), pixmap(pixmap) {
 	
 	assert(pixmap);
 	SDL_PixelFormat* format = pixmap->format;
@@ -425,24 +1000,25 @@ void UserInterfaceSpriteSprite::showhide(bool visible) {
 	this->visible = visible;
 }
 	
-void UserInterfaceSpriteSprite::save(SDL_Surface* screen) {
+void UserInterfaceSpriteSprite::save(UserInterfaceSpriteTarget& target) {
 	if(!visible) { return; }
-	SDL_BlitSurface(screen, &pos, background, 0);
+	SDL_BlitSurface(target.getSurface(), &pos, background, 0);
 	saved = true;
 }
 
-void UserInterfaceSpriteSprite::draw(SDL_Surface* screen) {
+void UserInterfaceSpriteSprite::draw(UserInterfaceSpriteTarget& target) {
 	if(!visible) { return; }
 	SDL_Rect clip = pos; // SDL_BlitSurface will trample
-	SDL_BlitSurface(const_cast<SDL_Surface*>(pixmap), 0, screen, &clip);
-	resources.updateRect(pos.x, pos.y, pos.w, pos.h);
+	SDL_BlitSurface(const_cast<SDL_Surface*>(pixmap), 0,
+		target.getSurface(), &clip);
+	target.updateRect(pos.x, pos.y, pos.w, pos.h);
 }
 
-void UserInterfaceSpriteSprite::restore(SDL_Surface* screen) {	
+void UserInterfaceSpriteSprite::restore(UserInterfaceSpriteTarget& target) {
 	if(!saved || !visible) { return; }// Avoid restoring garbage first frame
 	SDL_Rect clip = pos;
-	SDL_BlitSurface(background, 0, screen, &clip);
-	resources.updateRect(pos.x, pos.y, pos.w, pos.h);
+	SDL_BlitSurface(background, 0, target.getSurface(), &clip);
+	target.updateRect(pos.x, pos.y, pos.w, pos.h);
 	/* This doesn't cause flicker, as the update is deferred until the same
 	 * time as the draw() update thanks to updateRect()'s coalescing. */
 }
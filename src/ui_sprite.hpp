@@ -25,7 +25,6 @@ using std::hash;
 #include <SDL_image.h>
 #include <SDL_mixer.h>
 #include <SDL_ttf.h>
-#include "factory.hpp"
 #include "game.hpp"
 #include "gamesetup.hpp"
 #include "util.hpp"
@@ -65,6 +64,89 @@ namespace UserInterfaceSpriteConstants {
 class UserInterfaceSpriteSprite;
 class UserInterfaceSpritePointer;
 
+/** Somewhere to render to: a surface, and which parts of it have been drawn on
+ *  since it was last presented. Renderers, sprites and the resources' helpers
+ *  draw only to the target they are handed, never to the video surface, so the
+ *  screen is just one kind of target:
+ *   - SCREEN wraps the video surface, and present() puts it on the display;
+ *   - OFFSCREEN is a surface of our own, which present() leaves as it is for
+ *     whoever wants the frame (and which any one thread may draw to);
+ *   - THUMBNAIL keeps a copy of another target, shrunk by a whole factor,
+ *     up to date with what has changed on it (see follow()).
+ *  The screen target must be made again after the video mode changes, as SDL
+ *  may replace the video surface. */
+class UserInterfaceSpriteTarget {
+public:
+	enum Kind { SCREEN, OFFSCREEN, THUMBNAIL };
+private:
+	Kind kind;
+	SDL_Surface* surface; ///< Ours to free, unless the screen's
+	Uint8 shrink; ///< Of a thumbnail, from its source's size
+	std::vector<SDL_Rect> dirtyrects;
+	bool alldirty; ///< updateAll() since present(), so stop collecting
+	// The screen's, when it is bigger than what we draw
+	SDL_Surface* display; ///< The video surface, if we're the screen
+	Uint8 scale;
+	SDL_Rect placement; ///< Of the scaled picture on the display
+	bool smooth;
+	bool flipping; ///< The display is double-buffered
+
+	UserInterfaceSpriteTarget(Kind kind, SDL_Surface* surface,
+		Uint8 shrink);
+	void upscale();
+	UserInterfaceSpriteTarget(const UserInterfaceSpriteTarget&);
+	UserInterfaceSpriteTarget& operator=(const UserInterfaceSpriteTarget&);
+public:
+	/** The video surface, as SDL_SetVideoMode last left it, drawn on at
+	 *  w x h: directly, if it's that size, else through a surface of our
+	 *  own, which present() scales up by the biggest whole factor that
+	 *  fits, centred. NULL, having warn()ed, if there's no memory. */
+	static UserInterfaceSpriteTarget* screen(Uint16 w, Uint16 h);
+	/** A blank surface in memory, in the given format (which is copied,
+	 *  palette and all). NULL, having warn()ed, if there's no memory. */
+	static UserInterfaceSpriteTarget* offscreen(Uint16 w, Uint16 h,
+		const SDL_PixelFormat* format);
+	/** A target drawing straight into someone else's pixels: 32 bits each,
+	 *  0x00RRGGBB, in rows of exactly the width. They aren't freed with
+	 *  it. NULL, having warn()ed, if there's no memory. */
+	static UserInterfaceSpriteTarget* wrap(Uint32* pixels, Uint16 w,
+		Uint16 h);
+	/** A copy of source at 1/shrink of its size, kept up to date by
+	 *  follow(). NULL, having warn()ed, if there's no memory. */
+	static UserInterfaceSpriteTarget* thumbnail(
+		const UserInterfaceSpriteTarget& source, Uint8 shrink);
+	~UserInterfaceSpriteTarget();
+
+	Kind getKind() const;
+	SDL_Surface* getSurface() const;
+	const SDL_PixelFormat* getFormat() const;
+	Uint16 getWidth() const;
+	Uint16 getHeight() const;
+	/** The pixel value of a colour on this target. */
+	Uint32 mapRGB(SDL_Color colour) const;
+	/** Register a changed rectangle. Use this rather than updating the
+	 *  display directly so that they can be coalesced into a single update.
+	 *  This also provides clipping, which SDL_UpdateRect does not. */
+	void updateRect(Sint16 x, Sint16 y, Uint16 w, Uint16 h);
+	/** The whole target has changed (e.g. a renderer's init()). */
+	void updateAll();
+	/** What has changed since present(), clipped to the target. */
+	const std::vector<SDL_Rect>& getDirtyRects() const;
+	/** Bring a thumbnail up to date with what has changed on its source.
+	 *  Call it before the source's present(), which forgets that. */
+	void follow(const UserInterfaceSpriteTarget& source);
+	/** Scale up (if the screen is) with filtering, rather than blocks. */
+	void setSmooth(bool smooth);
+	/** Where a point on the display is on the target, given as a fraction
+	 *  of the display's width and height (as controllers give it), and
+	 *  kept to the target if it's on a border. */
+	void fromDisplay(double x, double y, Sint16& tx, Sint16& ty) const;
+	/** Show what has changed, if this is the screen, and start collecting
+	 *  changes afresh. If the display is double-buffered, that's a flip,
+	 *  and everything is shown. Returns how many pixels were changed. */
+	uint32_t present();
+};
+
 struct UserInterfaceSpriteResources {
 	TTF_Font* font_title;
 	TTF_Font* font_large;
@@ -78,31 +160,31 @@ struct UserInterfaceSpriteResources {
 	samples_type samples;
 	textures_type textures;
 	UserInterfaceSpritePointer* playerpointers[PLAYERS];
-	// Dynamic resources which the UI core will read and reset
-	std::vector<SDL_Rect> dirtyrects;
+	/** SDL_ttf is not thread-safe, and renderers may be prepared on the
+	 *  pool's thread; hold this around any direct use of the fonts. */
+	SDL_mutex* ttflock;
 
-	/** Register a new update rectangle. Use this instead of UpdateRect
-	 *  directly so that they can be coalesced into a single update. This
-	 *  mechanism also provides clipping, which SDL_UpdateRect does not. */
-	void updateRect(Sint16 x, Sint16 y, Uint16 w, Uint16 h);
-	/** Render some text in a sprite to a new surface. */
+	/** Render some text in a sprite to a new surface. Thread-safe. */
 	SDL_Surface* renderText(TTF_Font* font, const char* text,
 		SDL_Color colour);
-	/** Render a full-width line of text to the screen. */
-	bool displayTextLine(TTF_Font* font, const char* text,
-		SDL_Color foreground, SDL_Color background, Sint16 y);
+	/** Render a full-width line of text to the target. */
+	bool displayTextLine(UserInterfaceSpriteTarget& target, TTF_Font* font,
+		const char* text, SDL_Color foreground, SDL_Color background,
+		Sint16 y);
+	/** As displayTextLine, for text already rendered with renderText. */
+	void displaySurfaceLine(UserInterfaceSpriteTarget& target,
+		SDL_Surface* textpix, SDL_Color background, Sint16 y);
 	/** Render a set of sprites in the correct order (all save, all draw).*/
-	void displaySprites(
+	void displaySprites(UserInterfaceSpriteTarget& target,
 		const std::vector<UserInterfaceSpriteSprite*>& sprites);
 	/** Erase a set of sprites, to match the above. */
-	void eraseSprites(
+	void eraseSprites(UserInterfaceSpriteTarget& target,
 		const std::vector<UserInterfaceSpriteSprite*>& sprites);
 	// TODO Make sprite for species + dir + anim frame + ID (recolour)
 };
 
 class UserInterfaceSpriteSprite {
 private:
-	UserInterfaceSpriteResources& resources;
 	SDL_Surface* background;
 	bool saved;
 	bool visible;
@@ -110,10 +192,8 @@ protected:
 	const SDL_Surface* pixmap;
 	SDL_Rect pos;
 public:
-	/** Create a sprite using the given surface. Does NOT copy or own it.
-	 *  Uses the resources pointer for updateRects after screen updates. */
-	UserInterfaceSpriteSprite(UserInterfaceSpriteResources& resources,
-		const SDL_Surface* pixmap);
+	/** Create a sprite using the given surface. Does NOT copy or own it. */
+	UserInterfaceSpriteSprite(const SDL_Surface* pixmap);
 	virtual ~UserInterfaceSpriteSprite();
 	/** Position the sprite. Do not do this while drawn! */
 	virtual void move(Sint16 x, Sint16 y);
@@ -121,28 +201,80 @@ public:
 	 * Invisible sprites dirty their buffers and no-op save/draw/restore. */
 	void showhide(bool visible);
 	/** Save the background. */
-	void save(SDL_Surface* screen);
+	void save(UserInterfaceSpriteTarget& target);
 	/** Draw the sprite, and update this and erased region. */
-	void draw(SDL_Surface* screen);
+	void draw(UserInterfaceSpriteTarget& target);
 	/** Restore the background. */
-	void restore(SDL_Surface* screen);
+	void restore(UserInterfaceSpriteTarget& target);
 };
 
+/** Renderers are pooled: one is constructed the first time its stage is
+ *  reached, and then kept for the lifetime of the UI. Going back to a stage
+ *  calls prepare() and init() again on the same object, so they must reset any
+ *  per-visit state, and anything expensive which doesn't change between visits
+ *  should be kept rather than rebuilt.
+ *
+ *  prepare() is where the expensive work goes. It is usually run ahead of time
+ *  on the pool's thread (see ui_sprite_pool.hpp), so it must NOT touch the
+ *  screen or any renderer but its own, and should take resources.ttflock around
+ *  any font use (renderText does this for you). init() then only has to blit
+ *  what was prepared, to the target it is given. That may be a different
+ *  target for each render(), but it always starts with what the last one was
+ *  left with, so draw only what has changed, as if it were the same one. */
 class UserInterfaceSpriteRenderer {
 public:
 	virtual inline ~UserInterfaceSpriteRenderer() {}
-	/// Init after construction (factory pattern); can do initial render
+	/// Get ready for the next init(), off-screen; maybe on another thread
+	virtual inline void prepare(GameStage::Type stage,
+		UserInterfaceSpriteResources& resources) {}
+	/// Entering the stage (again?); reset, and can do initial render
 	virtual inline void init(GameStage::Type stage, GameSetup& setup, Game*
-		game, uint32_t ticks, UserInterfaceSpriteResources& resources){}
+		game, uint32_t ticks, UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {}
 	/// Normal rendering (passthrough of UI-level render())
 	virtual bool render(GameStage::Type stage, GameSetup& setup, Game* game,
 		GameStageState& state, uint32_t ticks,
-		UserInterfaceSpriteResources& resources) = 0;
-
-	/* It's time for that delicious factory pattern again, folks. */
-	FACTORY_REGISTER_IF(UserInterfaceSpriteRenderer)
+		UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) = 0;
+	/// Leaving the stage; do what you would have done in the destructor
+	virtual inline void leave(UserInterfaceSpriteResources& resources) {}
 };
 
+/** Construct the renderer for a stage. Each renderer's source file specialises
+ *  this, via UI_SPRITE_RENDERER, for the stage(s) it draws. Every stage's
+ *  specialisation is declared below, so that ui_sprite_pool.cpp can build its
+ *  dispatch table from them without instantiating the (undefined) template
+ *  itself; a stage with no renderer is then a link error rather than a
+ *  runtime death. A new stage needs a line here, as well as a renderer. */
+template <GameStage::Type stage>
+UserInterfaceSpriteRenderer* UserInterfaceSpriteRenderer_create();
+
+#define UI_SPRITE_RENDERER_DECLARE(stage) \
+	template <> UserInterfaceSpriteRenderer* \
+	UserInterfaceSpriteRenderer_create<stage>();
+UI_SPRITE_RENDERER_DECLARE(GameStage::TITLE)
+UI_SPRITE_RENDERER_DECLARE(GameStage::COLOUR)
+UI_SPRITE_RENDERER_DECLARE(GameStage::SPECIES)
+UI_SPRITE_RENDERER_DECLARE(GameStage::SCOREBOARD)
+UI_SPRITE_RENDERER_DECLARE(GameStage::LANDGRAB)
+UI_SPRITE_RENDERER_DECLARE(GameStage::LANDAUCTION)
+UI_SPRITE_RENDERER_DECLARE(GameStage::PREAUCTION)
+UI_SPRITE_RENDERER_DECLARE(GameStage::AUCTIONDECLARE)
+UI_SPRITE_RENDERER_DECLARE(GameStage::AUCTION)
+UI_SPRITE_RENDERER_DECLARE(GameStage::PREDEVELOP)
+UI_SPRITE_RENDERER_DECLARE(GameStage::DEVELOPHUMAN)
+UI_SPRITE_RENDERER_DECLARE(GameStage::WAMPUS)
+UI_SPRITE_RENDERER_DECLARE(GameStage::DEVELOPCOMP)
+UI_SPRITE_RENDERER_DECLARE(GameStage::POSTDEVELOP)
+UI_SPRITE_RENDERER_DECLARE(GameStage::PREPRODUCT)
+UI_SPRITE_RENDERER_DECLARE(GameStage::PRODUCT)
+UI_SPRITE_RENDERER_DECLARE(GameStage::POSTPRODUCT)
+
+/* Use this one OUTSIDE the class scope, as with FACTORY_REGISTER_IMPL. */
+#define UI_SPRITE_RENDERER(stage,klass) \
+	template <> UserInterfaceSpriteRenderer* \
+	UserInterfaceSpriteRenderer_create<stage>() { return new klass; }
+
 namespace Difficulty { // UI-specific difficulty information
 	const char* getName(Difficulty::Type self);
 }
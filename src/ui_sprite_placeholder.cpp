@@ -0,0 +1,88 @@
+#include "ui_sprite.hpp"
+
+/* Stages which don't have a proper renderer yet get this one, so that the
+ * dispatch table is complete and the game can be played through (if not
+ * enjoyed). It just says where we are. When writing a real renderer for one of
+ * these, remove its line from the bottom of this file. */
+
+static const char* stage_name(GameStage::Type stage) {
+	switch(stage) {
+		case GameStage::TITLE:          return "Title";
+		case GameStage::COLOUR:         return "Colour";
+		case GameStage::SPECIES:        return "Species";
+		case GameStage::SCOREBOARD:     return "Scoreboard";
+		case GameStage::LANDGRAB:       return "Land Grab";
+		case GameStage::LANDAUCTION:    return "Land Auction";
+		case GameStage::PREAUCTION:     return "Pre-Auction";
+		case GameStage::AUCTIONDECLARE: return "Auction Declare";
+		case GameStage::AUCTION:        return "Auction";
+		case GameStage::PREDEVELOP:     return "Pre-Develop";
+		case GameStage::DEVELOPHUMAN:   return "Develop (Human)";
+		case GameStage::WAMPUS:         return "Wampus";
+		case GameStage::DEVELOPCOMP:    return "Develop (Computer)";
+		case GameStage::POSTDEVELOP:    return "Post-Develop";
+		case GameStage::PREPRODUCT:     return "Pre-Production";
+		case GameStage::PRODUCT:        return "Production";
+		case GameStage::POSTPRODUCT:    return "Post-Production";
+	}
+	return "?"; // shush, g++
+}
+
+class UserInterfaceSpritePlaceholder : public UserInterfaceSpriteRenderer {
+	// There's one of us per stage, so these needn't be re-rendered
+	SDL_Surface* heading;
+	SDL_Surface* apology;
+public:
+	UserInterfaceSpritePlaceholder() : heading(0), apology(0) {}
+	~UserInterfaceSpritePlaceholder() {
+		if(heading) { SDL_FreeSurface(heading); }
+		if(apology) { SDL_FreeSurface(apology); }
+	}
+
+	void prepare(GameStage::Type stage,
+		UserInterfaceSpriteResources& resources) {
+
+		using namespace UserInterfaceSpriteConstants;
+		if(!heading) { heading = resources.renderText(
+			resources.font_large, stage_name(stage),
+			col_text_gold); }
+		if(!apology) { apology = resources.renderText(
+			resources.font_small, "(not yet implemented)",
+			col_text_gray); }
+	}
+
+	void init(GameStage::Type stage, GameSetup& setup, Game* game,
+		uint32_t ticks, UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {
+
+		using namespace UserInterfaceSpriteConstants;
+		// Blank the screen
+		SDL_FillRect(target.getSurface(), 0, target.mapRGB(black));
+		if(heading) { resources.displaySurfaceLine(target, heading,
+			black, 64); }
+		if(apology) { resources.displaySurfaceLine(target, apology,
+			black, 384); }
+		// Repaint everything to clear the screen
+		target.updateAll();
+	}
+
+	bool render(GameStage::Type stage, GameSetup& setup, Game* game,
+		GameStageState& state, uint32_t ticks,
+		UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) { return true; }
+};
+/* Register with the dispatch table */
+UI_SPRITE_RENDERER(GameStage::SCOREBOARD,    UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::LANDGRAB,      UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::LANDAUCTION,   UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::PREAUCTION,    UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::AUCTIONDECLARE,UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::AUCTION,       UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::PREDEVELOP,    UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::DEVELOPHUMAN,  UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::WAMPUS,        UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::DEVELOPCOMP,   UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::POSTDEVELOP,   UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::PREPRODUCT,    UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::PRODUCT,       UserInterfaceSpritePlaceholder)
+UI_SPRITE_RENDERER(GameStage::POSTPRODUCT,   UserInterfaceSpritePlaceholder)
@@ -3,10 +3,9 @@
 #include "ui_sprite_pointer.hpp"
 #include "platform.hpp"
 
-UserInterfaceSpritePointer::UserInterfaceSpritePointer(
-	UserInterfaceSpriteResources& resources, SDL_Color player,
+UserInterfaceSpritePointer::UserInterfaceSpritePointer(SDL_Color player,
 	SDL_Surface* centre, SDL_Surface* north, SDL_Surface* northeast) :
-	UserInterfaceSpriteSprite(resources, centre) {
+	UserInterfaceSpriteSprite(centre) {
 	
 	// Validate that images are same size, or this will go VERY wrong
 	assert(centre && north && northeast);
@@ -137,14 +136,14 @@ SDL_Surface* UserInterfaceSpritePointer::copyRotated(SDL_Surface* source) {
 	return dest;
 }
 
-void UserInterfaceSpritePointer_byController(SDL_Surface* screen,
+void UserInterfaceSpritePointer_byController(
+	const UserInterfaceSpriteTarget& target,
 	UserInterfaceSpritePointer& uisp, Controller* controller) {
 
 	if(controller && controller->hasPosition()) {
 		Sint16 x, y;
 		std::pair<double, double> position = controller->getPosition();
-		x = (Sint16) (position.first  * screen->w);
-		y = (Sint16) (position.second * screen->h);
+		target.fromDisplay(position.first, position.second, x, y);
 		uisp.move(x, y);
 		uisp.direction(controller->getDirection());
 		uisp.showhide(true);
@@ -30,9 +30,8 @@ private:
 	SDL_Surface* copyRotated(SDL_Surface* source);
 
 public:
-	UserInterfaceSpritePointer(UserInterfaceSpriteResources& resources,
-		SDL_Color player, SDL_Surface* centre, SDL_Surface* north,
-		SDL_Surface* northeast);
+	UserInterfaceSpritePointer(SDL_Color player, SDL_Surface* centre,
+		SDL_Surface* north, SDL_Surface* northeast);
 	virtual ~UserInterfaceSpritePointer();
 
 	/** Update the direction of the player's controller so that the correct
@@ -42,8 +41,9 @@ public:
 	virtual void move(Sint16 x, Sint16 y);
 };
 
-/// Set up a UISP based on controller state. Needs screen for co-ord scaling.
-void UserInterfaceSpritePointer_byController(SDL_Surface* screen,
+/// Set up a UISP based on controller state. Needs target for co-ord mapping.
+void UserInterfaceSpritePointer_byController(
+	const UserInterfaceSpriteTarget& target,
 	UserInterfaceSpritePointer& uisp, Controller* controller);
 
 #endif
@@ -0,0 +1,130 @@
+#include <assert.h>
+#include "metrics.hpp"
+#include "platform.hpp"
+#include "tracezone.hpp"
+#include "ui_sprite_pool.hpp"
+
+/* Build the stage-to-renderer dispatch table at compile time. RendererTable<N>
+ * peels off stage numbers into a parameter pack until it reaches zero, at which
+ * point the pack is every stage, in order, and can be expanded into an array.
+ * Slightly dark magic, but it means the table can neither be out of order nor
+ * miss a stage (which then fails to link; see UI_SPRITE_RENDERER_DECLARE). */
+typedef UserInterfaceSpriteRenderer* (*renderer_creator_t)();
+template <int N, int... I> struct RendererTable
+	: RendererTable<N - 1, N - 1, I...> {};
+template <int... I> struct RendererTable<0, I...> {
+	static constexpr renderer_creator_t creators[] = {
+		&UserInterfaceSpriteRenderer_create<
+			static_cast<GameStage::Type>(I)>... };
+};
+template <int... I> constexpr renderer_creator_t
+	RendererTable<0, I...>::creators[];
+typedef RendererTable<GameStage::COUNT> renderer_table;
+static_assert(GameStage::COUNT <= 32, "GameStage::Mask is too narrow");
+
+UserInterfaceSpritePool::UserInterfaceSpritePool(
+	UserInterfaceSpriteResources& resources) : resources(resources),
+	anticipated(0), quit(false) {
+
+	for(int i = 0; i < GameStage::COUNT; i++)
+		{ renderers[i] = NULL; status[i] = IDLE; }
+	lock = SDL_CreateMutex();
+	changed = SDL_CreateCond();
+	if(!lock || !changed) {
+		warn("Unable to create pool lock: %s", SDL_GetError());
+		die();
+	}
+	/* Failing to get a thread is survivable: everything is just prepared
+	 * on demand in acquire(), as if every guess had been wrong. */
+	worker = SDL_CreateThread(workerMain, this);
+	if(!worker) { warn("No preloader thread: %s", SDL_GetError()); }
+}
+
+UserInterfaceSpritePool::~UserInterfaceSpritePool() {
+	SDL_LockMutex(lock);
+	quit = true;
+	SDL_CondBroadcast(changed);
+	SDL_UnlockMutex(lock);
+	if(worker) { SDL_WaitThread(worker, NULL); }
+	SDL_DestroyCond(changed);
+	SDL_DestroyMutex(lock);
+	for(int i = 0; i < GameStage::COUNT; i++) { delete renderers[i]; }
+}
+
+void UserInterfaceSpritePool::prepare(GameStage::Type stage) {
+	TRACE_ZONE("Renderer::prepare", Metrics::getStageName(stage));
+	// Nobody else touches a PREPARING renderer, so no need for the lock
+	if(!renderers[stage]) {
+		renderers[stage] = renderer_table::creators[stage]();
+	}
+	renderers[stage]->prepare(stage, resources);
+}
+
+int UserInterfaceSpritePool::workerMain(void* self) {
+	UserInterfaceSpritePool* pool =
+		static_cast<UserInterfaceSpritePool*>(self);
+	TraceZone::nameThread("preloader");
+	SDL_LockMutex(pool->lock);
+	while(!pool->quit) {
+		int next;
+		for(next = 0; next < GameStage::COUNT; next++)
+			{ if(pool->status[next] == QUEUED) { break; } }
+		if(next == GameStage::COUNT) {
+			SDL_CondWait(pool->changed, pool->lock);
+			continue;
+		}
+		GameStage::Type stage = static_cast<GameStage::Type>(next);
+		pool->status[stage] = PREPARING;
+		SDL_UnlockMutex(pool->lock);
+		pool->prepare(stage);
+		SDL_LockMutex(pool->lock);
+		pool->status[stage] = READY;
+		SDL_CondBroadcast(pool->changed);
+	}
+	SDL_UnlockMutex(pool->lock);
+	return 0;
+}
+
+void UserInterfaceSpritePool::anticipate(GameStage::Mask stages) {
+	if(stages == anticipated || !worker) { return; }
+	anticipated = stages;
+	SDL_LockMutex(lock);
+	for(int i = 0; i < GameStage::COUNT; i++) {
+		if((stages & GameStage::mask(static_cast<GameStage::Type>(i)))
+			&& status[i] == IDLE) { status[i] = QUEUED; }
+	}
+	SDL_CondBroadcast(changed);
+	SDL_UnlockMutex(lock);
+}
+
+UserInterfaceSpriteRenderer* UserInterfaceSpritePool::acquire(
+	GameStage::Type stage) {
+
+	bool ours = false;
+	SDL_LockMutex(lock);
+	assert(status[stage] != ACTIVE);
+	// A queued stage the worker hasn't started on is quicker done here
+	if(status[stage] == IDLE || status[stage] == QUEUED) {
+		status[stage] = PREPARING;
+		ours = true;
+	} else {
+		while(status[stage] == PREPARING)
+			{ SDL_CondWait(changed, lock); }
+	}
+	SDL_UnlockMutex(lock);
+	if(ours) { prepare(stage); }
+	SDL_LockMutex(lock);
+	status[stage] = ACTIVE;
+	SDL_UnlockMutex(lock);
+	// Re-anticipating the stage we've just left should queue it again
+	anticipated = 0;
+	return renderers[stage];
+}
+
+void UserInterfaceSpritePool::release(GameStage::Type stage) {
+	SDL_LockMutex(lock);
+	assert(status[stage] == ACTIVE);
+	status[stage] = IDLE;
+	SDL_UnlockMutex(lock);
+}
+
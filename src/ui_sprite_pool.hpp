@@ -0,0 +1,47 @@
+#ifndef UI_SPRITE_POOL_HPP_
+#define UI_SPRITE_POOL_HPP_
+#include <SDL.h>
+#include "ui_sprite.hpp"
+
+/** \file
+ * \brief Renderer pool and background preloader */
+
+/** Owns one renderer per stage, and prepares them ahead of time.
+ *
+ * The logic tells us (via anticipate()) which stages it expects to go to next;
+ * a worker thread then constructs and prepare()s those renderers while the
+ * current stage is still running, so that by the time the stage changes all
+ * that is left for the render path is init()'s blitting. If the guess was
+ * wrong, or the worker hasn't got there yet, acquire() does (or finishes) the
+ * work itself, so a bad guess costs no more than no guess at all.
+ *
+ * All methods are for the main thread; the worker is entirely internal. */
+class UserInterfaceSpritePool {
+	/// Where each stage's renderer is in its lifecycle
+	enum Status { IDLE, QUEUED, PREPARING, READY, ACTIVE };
+	UserInterfaceSpriteResources& resources;
+	UserInterfaceSpriteRenderer* renderers[GameStage::COUNT];
+	Status status[GameStage::COUNT];
+	GameStage::Mask anticipated; ///< Last hint, to skip locking on repeats
+	bool quit;
+	SDL_mutex* lock; ///< Guards status and quit
+	SDL_cond* changed; ///< Signalled on any status change
+	SDL_Thread* worker;
+
+	/// Create (if need be) and prepare. Call with the stage PREPARING.
+	void prepare(GameStage::Type stage);
+	static int workerMain(void* self);
+public:
+	UserInterfaceSpritePool(UserInterfaceSpriteResources& resources);
+	~UserInterfaceSpritePool();
+	/** Queue these stages for preparation, unless they already are. */
+	void anticipate(GameStage::Mask stages);
+	/** Get the prepared renderer for the stage we're entering, waiting for
+	 *  or doing the preparation if needs be. It's yours until release(). */
+	UserInterfaceSpriteRenderer* acquire(GameStage::Type stage);
+	/** Hand back a renderer after its leave(), ready to prepare again. */
+	void release(GameStage::Type stage);
+};
+
+#endif
+
@@ -0,0 +1,156 @@
+#include <string.h>
+#include <assert.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+#include "ui_sprite_scale.hpp"
+
+static bool overlap(const SDL_Rect& a, const SDL_Rect& b) {
+	return a.x < b.x + b.w && b.x < a.x + a.w
+		&& a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+void UserInterfaceSpriteScale::merge(std::vector<SDL_Rect>& rects) {
+	bool merged;
+	do {
+		merged = false;
+		for(size_t i = 0; i < rects.size(); i++) {
+			for(size_t j = i + 1; j < rects.size(); j++) {
+				SDL_Rect& a = rects[i];
+				const SDL_Rect& b = rects[j];
+				if(!overlap(a, b)) { continue; }
+				const int left = a.x < b.x ? a.x : b.x;
+				const int top  = a.y < b.y ? a.y : b.y;
+				const int right  = a.x + a.w > b.x + b.w ?
+					a.x + a.w : b.x + b.w;
+				const int bottom = a.y + a.h > b.y + b.h ?
+					a.y + a.h : b.y + b.h;
+				a.x = left; a.y = top;
+				a.w = right - left; a.h = bottom - top;
+				rects[j] = rects.back();
+				rects.pop_back();
+				merged = true;
+				// The bigger box may catch ones passed over
+				j = i;
+			}
+		}
+	} while(merged); // ...or ones before it
+}
+
+static const Uint32* row(const SDL_Surface* surface, int y) {
+	return (const Uint32*) ((const Uint8*) surface->pixels
+		+ y * surface->pitch);
+}
+
+static Uint32* row(SDL_Surface* surface, int y)
+	{ return (Uint32*) ((Uint8*) surface->pixels + y * surface->pitch); }
+
+/** Repeat each of w pixels scale times. The common factors go four pixels at
+ *  a time, shuffled into whole registers, which leaves the stores to bound
+ *  it; at 1920x1440 a full frame is 11MB of them. */
+static void nearestRow(const Uint32* in, Uint32* out, int w, int scale) {
+#ifdef __SSE2__
+	if(scale == 2) {
+		for(; w >= 4; w -= 4, in += 4, out += 8) {
+			const __m128i v = _mm_loadu_si128((const __m128i*) in);
+			_mm_storeu_si128((__m128i*) out,
+				_mm_unpacklo_epi32(v, v));
+			_mm_storeu_si128((__m128i*) (out + 4),
+				_mm_unpackhi_epi32(v, v));
+		}
+	} else if(scale == 3) {
+		for(; w >= 4; w -= 4, in += 4, out += 12) {
+			const __m128i v = _mm_loadu_si128((const __m128i*) in);
+			_mm_storeu_si128((__m128i*) out, _mm_shuffle_epi32(v,
+				_MM_SHUFFLE(1, 0, 0, 0)));
+			_mm_storeu_si128((__m128i*) (out + 4),
+				_mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+			_mm_storeu_si128((__m128i*) (out + 8),
+				_mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+		}
+	} else if(scale == 4) {
+		for(; w >= 4; w -= 4, in += 4, out += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i*) in);
+			_mm_storeu_si128((__m128i*) out,
+				_mm_shuffle_epi32(v, 0x00));
+			_mm_storeu_si128((__m128i*) (out + 4),
+				_mm_shuffle_epi32(v, 0x55));
+			_mm_storeu_si128((__m128i*) (out + 8),
+				_mm_shuffle_epi32(v, 0xaa));
+			_mm_storeu_si128((__m128i*) (out + 12),
+				_mm_shuffle_epi32(v, 0xff));
+		}
+	}
+#endif
+	// Whatever's left over, and every other factor
+	for(; w > 0; w--, in++) {
+		for(int i = 0; i < scale; i++) { *out++ = *in; }
+	}
+}
+
+void UserInterfaceSpriteScale::nearest(const SDL_Surface* from,
+	const SDL_Rect& rect, SDL_Surface* to, int x, int y, int scale) {
+
+	const size_t bytes = rect.w * scale * sizeof(Uint32);
+	for(int sy = 0; sy < rect.h; sy++) {
+		Uint32* out = row(to, y + sy * scale) + x;
+		nearestRow(row(from, rect.y + sy) + rect.x, out, rect.w,
+			scale);
+		// The rest of the block's rows are the same
+		for(int py = 1; py < scale; py++)
+			{ memcpy(row(to, y + sy * scale + py) + x, out, bytes); }
+	}
+}
+
+/** Blend two pixels, weight/256 of the way from a to b, a byte at a time
+ *  (two at once, where there's room for the products between them). */
+static inline Uint32 lerp(Uint32 a, Uint32 b, Uint32 weight) {
+	const Uint32 rb = (((a & 0xff00ff) * (256 - weight)
+		+ (b & 0xff00ff) * weight) >> 8) & 0xff00ff;
+	const Uint32 g = (((a & 0x00ff00) * (256 - weight)
+		+ (b & 0x00ff00) * weight) >> 8) & 0x00ff00;
+	return rb | g;
+}
+
+static inline int clamp(int i, int size)
+	{ return i < 0 ? 0 : (i >= size ? size - 1 : i); }
+
+void UserInterfaceSpriteScale::smooth(const SDL_Surface* from,
+	const SDL_Rect& rect, SDL_Surface* to, int x, int y, int scale) {
+
+	assert(scale > 0 && scale <= MAX_SCALE);
+	/* Each pixel out of a block sits a fraction of a pixel off the centre
+	 * of the one it came from, to one side, and is blended with that
+	 * side's neighbour by that fraction. Every block is the same. */
+	int step[MAX_SCALE];
+	Uint32 weight[MAX_SCALE];
+	for(int p = 0; p < scale; p++) {
+		const int offset = 2 * p + 1 - scale; // In 1/(2 * scale)ths
+		step[p] = offset < 0 ? -1 : 1;
+		weight[p] = (offset < 0 ? -offset : offset) * 128 / scale;
+	}
+	/* Blend down first, a row of the block at a time, then across; the
+	 * row has a pixel more either side, for the edges' neighbours. */
+	std::vector<Uint32> blended(rect.w + 2);
+	for(int sy = 0; sy < rect.h; sy++) {
+		const Uint32* here = row(from, rect.y + sy);
+		for(int py = 0; py < scale; py++) {
+			const Uint32* there = row(from,
+				clamp(rect.y + sy + step[py], from->h));
+			for(int i = 0; i < rect.w + 2; i++) {
+				const int sx = clamp(rect.x - 1 + i, from->w);
+				blended[i] = lerp(here[sx], there[sx],
+					weight[py]);
+			}
+			Uint32* out = row(to, y + sy * scale + py) + x;
+			for(int i = 1; i <= rect.w; i++) {
+				for(int px = 0; px < scale; px++) {
+					*out++ = lerp(blended[i],
+						blended[i + step[px]],
+						weight[px]);
+				}
+			}
+		}
+	}
+}
+
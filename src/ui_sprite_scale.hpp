@@ -0,0 +1,34 @@
+#ifndef UI_SPRITE_SCALE_HPP_
+#define UI_SPRITE_SCALE_HPP_
+#include <vector>
+#include <SDL.h>
+
+/** \file
+ * \brief Scaling the 640x480 picture up by a whole factor, a part at a time
+ *
+ * Everything is drawn at 640x480 and, on a bigger display, scaled up only as
+ * it is shown, and only where it has changed; which is usually a pointer or
+ * two and a line of text, so a few thousand pixels of a million. Both
+ * surfaces must be 32 bits per pixel, in the same layout, with the top byte
+ * unused (which is what we ask SDL_SetVideoMode for when scaling), and
+ * locked if they need to be. */
+namespace UserInterfaceSpriteScale {
+	const int MAX_SCALE = 16;
+
+	/** Replace any rectangles which overlap with their bounding box, until
+	 *  none do, so that no pixel is scaled twice. */
+	void merge(std::vector<SDL_Rect>& rects);
+	/** Scale rect of from up by scale to (x, y) on to, each pixel becoming
+	 *  a scale x scale block. Uses SSE2 where there is any. */
+	void nearest(const SDL_Surface* from, const SDL_Rect& rect,
+		SDL_Surface* to, int x, int y, int scale);
+	/** As nearest, but filtered (bilinearly), so edges are soft rather than
+	 *  blocky. Each pixel out depends on those around the one it came
+	 *  from, so rect should have grown by one all round to cover a
+	 *  change. */
+	void smooth(const SDL_Surface* from, const SDL_Rect& rect,
+		SDL_Surface* to, int x, int y, int scale);
+}
+
+#endif
+
@@ -70,47 +70,59 @@ static const char** species_desc(Species::Type s) {
 class UserInterfaceSpriteColour : public UserInterfaceSpriteRenderer {
 private:
 	GameStageState::Colour last_state;
+	SDL_Surface* heading;
+	SDL_Surface* instructions;
 
 public:
+	UserInterfaceSpriteColour() : heading(0), instructions(0) {}
+
+	void prepare(GameStage::Type stage,
+		UserInterfaceSpriteResources& resources) {
+
+		using namespace UserInterfaceSpriteConstants;
+		if(!heading) { heading = resources.renderText(
+			resources.font_large, "Colour Choice", col_text_gold); }
+		if(!instructions) { instructions = resources.renderText(
+			resources.font_small, "Press your button to select",
+			col_text_gold); }
+	}
+
 	void init(GameStage::Type stage, GameSetup& setup, Game* game,
-		uint32_t ticks, UserInterfaceSpriteResources& resources) {
+		uint32_t ticks, UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {
 
 		// Fudge this to force first-frame repaint
 		last_state.offer = -1;
 
 		using namespace UserInterfaceSpriteConstants;
-		SDL_Surface* screen = SDL_GetVideoSurface();
 		// Blank the screen
-		SDL_FillRect(screen, 0,
-			SDL_MapRGB(screen->format, 0, 0, 0));
+		SDL_FillRect(target.getSurface(), 0, target.mapRGB(black));
 		// Show the static text
-		const SDL_Color black = {0, 0, 0, 0};
-		resources.displayTextLine(resources.font_large, "Colour Choice",
-				col_text_gold, black, 64);
-		resources.displayTextLine(resources.font_small,
-				"Press your button to select",
-				col_text_gold, black, 384);
+		if(heading) { resources.displaySurfaceLine(target, heading,
+			black, 64); }
+		if(instructions) { resources.displaySurfaceLine(target,
+			instructions, black, 384); }
 		// Repaint everything to clear the screen
-		SDL_Flip(screen);
+		target.updateAll();
 	}
 
-	~UserInterfaceSpriteColour() { }
+	~UserInterfaceSpriteColour() {
+		if(heading) { SDL_FreeSurface(heading); }
+		if(instructions) { SDL_FreeSurface(instructions); }
+	}
 
 	bool render(GameStage::Type stage, GameSetup& setup, Game* game,
 		GameStageState& state, uint32_t ticks,
-		UserInterfaceSpriteResources& resources) {
+		UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {
 
 		// Nice and easy
 		if(state.colour.offer != last_state.offer) {
 			using namespace UserInterfaceSpriteConstants;
 			SDL_Rect box = { 320 - 32, 192, 64, 64 };
-			SDL_Surface* screen = SDL_GetVideoSurface();
-			SDL_FillRect(screen, &box,
-				SDL_MapRGB(screen->format,
-					col_player[state.colour.offer].r,
-					col_player[state.colour.offer].g,
-					col_player[state.colour.offer].b));
-			resources.updateRect(box.x, box.y, box.w, box.h);
+			SDL_FillRect(target.getSurface(), &box,
+				target.mapRGB(col_player[state.colour.offer]));
+			target.updateRect(box.x, box.y, box.w, box.h);
 		}
 		
 		// Draw claims (controller name in colour)
@@ -126,7 +138,8 @@ public:
 				int claim = state.colour.claim[p];
 			
 				using namespace UserInterfaceSpriteConstants;	
-				resources.displayTextLine(resources.font_small,
+				resources.displayTextLine(target,
+					resources.font_small,
 					description,
 					claim == -1
 						? (ps->computer
@@ -143,50 +156,68 @@ public:
 		return true;
 	}
 };
-/* Register with the factory */
-FACTORY_REGISTER_IMPL(UserInterfaceSpriteRenderer,UserInterfaceSpriteColour)
+/* Register with the dispatch table */
+UI_SPRITE_RENDERER(GameStage::COLOUR, UserInterfaceSpriteColour)
 
 class UserInterfaceSpriteSpecies : public UserInterfaceSpriteRenderer {
 private:
 	GameStageState::Species last_state;
 	Species::Type last_species;
 	std::vector<UserInterfaceSpriteSprite*> sprites;
+	SDL_Surface* heading;
+	SDL_Surface* instructions;
 
 public:
+	UserInterfaceSpriteSpecies() : heading(0), instructions(0) {}
+
+	void prepare(GameStage::Type stage,
+		UserInterfaceSpriteResources& resources) {
+
+		using namespace UserInterfaceSpriteConstants;
+		if(!heading) { heading = resources.renderText(
+			resources.font_large, "Species Choice", col_text_gold);}
+		if(!instructions) { instructions = resources.renderText(
+			resources.font_small, "Push direction and press button",
+			col_text_gold); }
+	}
+
 	void init(GameStage::Type stage, GameSetup& setup, Game* game,
-		uint32_t ticks, UserInterfaceSpriteResources& resources) {
+		uint32_t ticks, UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {
 
 		last_state.player = -1; // first frame fudge
 		last_species = Species::COMPUTER;
+		sprites.clear(); // in case we're revisiting
 
 		using namespace UserInterfaceSpriteConstants;
-		SDL_Surface* screen = SDL_GetVideoSurface();
 		// Blank the screen
-		SDL_FillRect(screen, 0,
-			SDL_MapRGB(screen->format, 0, 0, 0));
+		SDL_FillRect(target.getSurface(), 0, target.mapRGB(black));
 		// Show the static text TODO placeholder
-		resources.displayTextLine(resources.font_large,
-				"Species Choice", col_text_gold, black, 64);
-		resources.displayTextLine(resources.font_small,
-				"Push direction and press button",
-				col_text_gold, black, 384);
+		if(heading) { resources.displaySurfaceLine(target, heading,
+			black, 64); }
+		if(instructions) { resources.displaySurfaceLine(target,
+			instructions, black, 384); }
 		// Repaint everything to clear the screen
-		SDL_Flip(screen);
+		target.updateAll();
 	}
 
-	~UserInterfaceSpriteSpecies() { }
+	~UserInterfaceSpriteSpecies() {
+		if(heading) { SDL_FreeSurface(heading); }
+		if(instructions) { SDL_FreeSurface(instructions); }
+	}
 
 	bool render(GameStage::Type stage, GameSetup& setup, Game* game,
 		GameStageState& state, uint32_t ticks,
-		UserInterfaceSpriteResources& resources) {
+		UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {
 
 		// Remove cursor of the last player we drew (also animation)
-		resources.eraseSprites(sprites);
+		resources.eraseSprites(target, sprites);
 		sprites.clear(); // pointer may change
 		// Show pointer (if the player has one)
 		sprites.push_back(
 			resources.playerpointers[state.species.player]);
-		UserInterfaceSpritePointer_byController(SDL_GetVideoSurface(),
+		UserInterfaceSpritePointer_byController(target,
 			*resources.playerpointers[state.species.player],
 			setup.playersetup[state.species.player].controller);
 
@@ -198,20 +229,22 @@ public:
 				setup.playersetup[state.species.player].species;
 			if(species != last_species || !last_state.defined) {
 				using namespace UserInterfaceSpriteConstants;
-				resources.displayTextLine(resources.font_small,
+				resources.displayTextLine(target,
+					resources.font_small,
 					state.species.defined
 						? species_name(species) : " ",
 					col_text_gold, black, 400);
 				const char** desc = species_desc(species);
 				for(int line = 0; line < 3; ++line) {
-					resources.displayTextLine(
+					resources.displayTextLine(target,
 						resources.font_small,
 						desc[line],
 						col_text_gold, black,
 						416 + line*16);
 				}
 				// TODO Check colour for this
-				resources.displayTextLine(resources.font_small,
+				resources.displayTextLine(target,
+					resources.font_small,
 					species==Species::ADVANCED?
 					"Expert Species"
 					:species==Species::BEGINNER?
@@ -225,7 +258,7 @@ public:
 		// TODO Animate any defined species
 
 		// Draw the sprites
-		resources.displaySprites(sprites);
+		resources.displaySprites(target, sprites);
 		
 		// Update last state
 		last_state = state.species;
@@ -234,6 +267,6 @@ public:
 		return true;
 	}
 };
-/* Register with the factory */
-FACTORY_REGISTER_IMPL(UserInterfaceSpriteRenderer,UserInterfaceSpriteSpecies)
+/* Register with the dispatch table */
+UI_SPRITE_RENDERER(GameStage::SPECIES, UserInterfaceSpriteSpecies)
 
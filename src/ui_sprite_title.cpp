@@ -44,6 +44,7 @@ static const char* messages[] = { /* "max length " <- ends there */
 class UserInterfaceSpriteTitle : public UserInterfaceSpriteRenderer {
 private:
 	SDL_Surface* title_text;
+	SDL_Surface* title_outline; ///< Kept between visits; never changes
 	std::vector<unsigned int> title_pixels;
 	SDL_Rect title_pos;
 	int title_wmult;
@@ -59,22 +60,17 @@ private:
 	int message_idx;
 
 public:
-	void init(GameStage::Type stage, GameSetup& setup, Game* game,
-		uint32_t ticks, UserInterfaceSpriteResources& resources) {
+	UserInterfaceSpriteTitle() : title_text(0), title_outline(0) {}
 
-		const SDL_Color black = {0, 0, 0, 0};
-		last_difficulty = Difficulty::BEGINNER;
-		for(int player = 0; player < PLAYERS; player++)
-			{ last_playerready[player] = false; }
-		first_frame = true;
-		message_idx = 0;
+	void prepare(GameStage::Type stage,
+		UserInterfaceSpriteResources& resources) {
 
-		SDL_Surface* screen = SDL_GetVideoSurface();
-		// Blank the screen
-		SDL_FillRect(screen, 0,
-			SDL_MapRGB(screen->format,
-				background.r, background.g, background.b));
+		const SDL_Color black = {0, 0, 0, 0};
+		// We may be coming back from a previous game
+		if(title_text) { SDL_FreeSurface(title_text); title_text = 0; }
+		title_pixels.clear();
 		// Generate the inner title text
+		SDL_LockMutex(resources.ttflock);
 #ifdef WORKAROUND_SOLID
 		title_text = TTF_RenderUTF8_Shaded(resources.font_title,
 			" M.E.W.L.", background, black);
@@ -86,29 +82,17 @@ public:
 		title_text = TTF_RenderUTF8_Solid(resources.font_title,
 			" M.E.W.L.", background);
 #endif
+		SDL_UnlockMutex(resources.ttflock);
 		if(!title_text)
 			{warn("TTF error (title): %s", TTF_GetError()); die();}
 		title_pos.y = 32;
-		title_pos.x = (screen->w - title_text->w) / 2;
 		title_pos.w = title_text->w; title_pos.h = title_text->h;
-		// Draw the outline
-		SDL_Rect border_pos;
-		SDL_Surface* title_soft;
-		title_soft = resources.renderText(resources.font_title,
-			" M.E.W.L.", black);
-		border_pos.w = title_pos.w; border_pos.h = title_pos.h;
-		for(Sint16 x = title_pos.x-3; x <= title_pos.x+3; x++) {
-			border_pos.x = x;
-			for(Sint16 y = title_pos.y-3; y <= title_pos.y+3; y++) {
-				border_pos.y = y;
-				SDL_BlitSurface(title_soft, NULL, screen,
-					&border_pos);
-			}
+		// The outline never changes, so only needs rendering once
+		if(!title_outline) {
+			title_outline = resources.renderText(
+				resources.font_title, " M.E.W.L.", black);
+			if(!title_outline) { die(); }
 		}
-		SDL_Flip(screen); //SDL_UpdateRect(screen, 0, 0, 0, 0);
-		SDL_FreeSurface(title_soft);
-		// Draw the inner text
-		SDL_BlitSurface(title_text, NULL, screen, &title_pos);
 		// Find the pixels to colourise later
 		title_pixels.reserve(title_text->w * title_text->h);
 		if(title_text->format->BytesPerPixel == 1) {
@@ -151,6 +135,37 @@ public:
 			default: title_wmult = 0; title_hmult = 0;
 		}
 		title_cycledir = random_uniform(0, 1);
+	}
+
+	void init(GameStage::Type stage, GameSetup& setup, Game* game,
+		uint32_t ticks, UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {
+
+		sprites.clear();
+		last_difficulty = Difficulty::BEGINNER;
+		for(int player = 0; player < PLAYERS; player++)
+			{ last_playerready[player] = false; }
+		first_frame = true;
+		message_idx = 0;
+
+		SDL_Surface* screen = target.getSurface();
+		// Blank the screen
+		SDL_FillRect(screen, 0, target.mapRGB(background));
+		title_pos.x = (target.getWidth() - title_text->w) / 2;
+		// Draw the outline
+		SDL_Rect border_pos;
+		border_pos.w = title_pos.w; border_pos.h = title_pos.h;
+		for(Sint16 x = title_pos.x-3; x <= title_pos.x+3; x++) {
+			border_pos.x = x;
+			for(Sint16 y = title_pos.y-3; y <= title_pos.y+3; y++) {
+				border_pos.y = y;
+				SDL_BlitSurface(title_outline, NULL, screen,
+					&border_pos);
+			}
+		}
+		target.updateAll();
+		// Draw the inner text (not yet colourised, so all background)
+		SDL_BlitSurface(title_text, NULL, screen, &title_pos);
 		
 		// Activate all pointer sprites
 		// FIXME Nice pattern demo for later stages, but overkill here
@@ -161,7 +176,10 @@ public:
 
 	~UserInterfaceSpriteTitle() {
 		if(title_text) { SDL_FreeSurface(title_text); }
-		
+		if(title_outline) { SDL_FreeSurface(title_outline); }
+	}
+
+	void leave(UserInterfaceSpriteResources& resources) {
 		// Do NOT delete sprites' contents; union of subset of others
 		sprites.clear();
 
@@ -173,12 +191,13 @@ public:
 
 	bool render(GameStage::Type stage, GameSetup& setup, Game* game,
 		GameStageState& state, uint32_t ticks,
-		UserInterfaceSpriteResources& resources) {
+		UserInterfaceSpriteResources& resources,
+		UserInterfaceSpriteTarget& target) {
 		
 		bool beat = false;
-		SDL_Surface* screen = SDL_GetVideoSurface();
+		SDL_Surface* screen = target.getSurface();
 		
-		resources.eraseSprites(sprites);
+		resources.eraseSprites(target, sprites);
 		
 		// Colourise some random pixels
 		int k = title_hmult ?
@@ -210,7 +229,7 @@ public:
 		// Blit, because we don't write directly to screen (it's 32-bit)
 		SDL_BlitSurface(title_text, NULL, screen, &title_pos);
 		// Redraw the title area
-		resources.updateRect(title_pos.x, title_pos.y,
+		target.updateRect(title_pos.x, title_pos.y,
 			title_pos.w, title_pos.h);
 
 		// Let there be music
@@ -259,7 +278,7 @@ public:
 			}
 			message_idx++;			
 
-			resources.displayTextLine(resources.font_small,
+			resources.displayTextLine(target, resources.font_small,
 				message, textcolour, background, 384);
 		}
 
@@ -268,7 +287,7 @@ public:
 			std::string difftext(ARROW_LEFT " ");
 			difftext += Difficulty::getName(setup.difficulty);
 			difftext += " " ARROW_RIGHT;
-			resources.displayTextLine(resources.font_small,
+			resources.displayTextLine(target, resources.font_small,
 				difftext.c_str(), textcolour, background, 408);
 		}
 		for(int player = 0; player < PLAYERS; player++) {
@@ -298,9 +317,9 @@ public:
 				if(textpix) {
 					bar.x = player * playw;
 					bar.h = textpix->h;
-					SDL_FillRect(screen, &bar, SDL_MapRGB(
-						screen->format,bg.r,bg.g,bg.b));
-					resources.updateRect(bar.x, bar.y,
+					SDL_FillRect(screen, &bar,
+						target.mapRGB(bg));
+					target.updateRect(bar.x, bar.y,
 						bar.w, bar.h);
 					bar.w = textpix->w;
 					if(bar.w > playw) { bar.w = playw; }
@@ -318,17 +337,17 @@ public:
 			last_playerready[player] =
 				state.title.playerready[player];
 			// While looping, update the player pointers
-			UserInterfaceSpritePointer_byController(screen,
+			UserInterfaceSpritePointer_byController(target,
 				*resources.playerpointers[player],
 				setup.playersetup[player].controller);
 		}
 		
-		resources.displaySprites(sprites);
+		resources.displaySprites(target, sprites);
 		first_frame = false;
 
 		return true; // TODO Fade screen?
 	}
 };
-/* Register with the factory */
-FACTORY_REGISTER_IMPL(UserInterfaceSpriteRenderer,UserInterfaceSpriteTitle)
+/* Register with the dispatch table */
+UI_SPRITE_RENDERER(GameStage::TITLE, UserInterfaceSpriteTitle)
 
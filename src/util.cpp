@@ -1,3 +1,4 @@
+#include <assert.h>
 #include "platform.hpp"
 #include "util.hpp"
 
@@ -7,8 +8,34 @@ static double phi(double x, double stddev) {
 	return 0.5 * (1 + platform_erf(x / (stddev * ROOT_2)));
 }
 
-int random_normal(int min, int max, double stddev) {
-	double r = platform_random();
+/* splitmix64, to spread a seed of any quality over the whole state; this is
+ * what the xoshiro authors recommend. */
+static uint64_t splitmix64(uint64_t& x) {
+	uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k)
+	{ return (x << k) | (x >> (64 - k)); }
+
+Random::Random(uint64_t seed)
+	{ for(int i = 0; i < 4; i++) { s[i] = splitmix64(seed); } }
+
+uint64_t Random::next() {
+	const uint64_t result = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+	s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+}
+
+double Random::fraction() { return (next() >> 11) * (1.0 / (1ull << 53)); }
+
+int Random::normal(int min, int max, double stddev) {
+	double r = fraction();
 	for(int bound = min; bound < max; bound++) {
 		if(r < phi(bound + 0.5, stddev))
 			{ return bound; }
@@ -16,13 +43,80 @@ int random_normal(int min, int max, double stddev) {
 	return max;
 }
 
-int random_uniform(int min, int max) {
-	int r;
-	do {
-		r = (int) (platform_random() * ((max + 1) - min)) + min;
-	} while(r > max); // 1/RAND_MAX chance of this happening
-	return r;
+int Random::uniform(int min, int max)
+	{ return (int) (fraction() * ((max + 1) - min)) + min; }
+
+Sampler::Sampler(const uint16_t weight[], int count) : count(count),
+	all(count < 32 ? (1u << count) - 1 : ~0u) {
+
+	assert(count > 0 && count <= MAX);
+	uint32_t total = 0;
+	for(int i = 0; i < count; i++)
+		{ this->weight[i] = weight[i]; total += weight[i]; }
+	assert(total);
+	/* Scale so the average column is 1, then pair each outcome with less
+	 * than a column's worth with one that has more, to fill it up. */
+	double scaled[MAX];
+	uint8_t small[MAX], large[MAX];
+	int smalls = 0, larges = 0;
+	for(int i = 0; i < count; i++) {
+		scaled[i] = (double) weight[i] * count / total;
+		if(scaled[i] < 1) { small[smalls++] = i; }
+		else { large[larges++] = i; }
+	}
+	while(smalls && larges) {
+		const uint8_t less = small[--smalls];
+		const uint8_t more = large[--larges];
+		keep[less] = scaled[less];
+		alias[less] = more;
+		scaled[more] -= 1 - scaled[less];
+		if(scaled[more] < 1) { small[smalls++] = more; }
+		else { large[larges++] = more; }
+	}
+	// Whatever's left is full, give or take rounding
+	while(larges) { keep[large[--larges]] = 1; }
+	while(smalls) { keep[small[--smalls]] = 1; }
+	for(int i = 0; i < count; i++) { if(keep[i] >= 1) { alias[i] = i; } }
 }
 
+int Sampler::sample(Random& rng, uint32_t allowed) const {
+	allowed &= all;
+	if(!allowed) { return -1; }
+	const int column = rng.uniform(0, count - 1);
+	const int drawn = rng.fraction() < keep[column]
+		? column : alias[column];
+	if(allowed & (1u << drawn)) { return drawn; }
+	/* Missed, so draw again among the allowed alone. Either way, each
+	 * allowed outcome ends up with its weight's share of their total. */
+	uint32_t total = 0;
+	for(int i = 0; i < count; i++)
+		{ if(allowed & (1u << i)) { total += weight[i]; } }
+	if(!total) { return -1; }
+	int32_t ticket = rng.uniform(0, total - 1);
+	for(int i = 0; i < count; i++) {
+		if(!(allowed & (1u << i))) { continue; }
+		ticket -= weight[i];
+		if(ticket < 0) { return i; }
+	}
+	return -1; // Unreachable
+}
+
+/* The UI's titles sparkle on the main thread while the preloader prepares the
+ * next stage, so each thread gets its own default stream. */
+static Random& default_stream() {
+	static thread_local Random stream(
+		((uint64_t) (platform_random() * 4294967296.0) << 32)
+		^ (uint64_t) (platform_random() * 4294967296.0));
+	return stream;
+}
+
+int random_normal(int min, int max, double stddev)
+	{ return default_stream().normal(min, max, stddev); }
+
+int random_uniform(int min, int max)
+	{ return default_stream().uniform(min, max); }
+
+uint64_t random_seed() { return default_stream().next(); }
+
 bool hash_eqcstr::operator()(const char* one, const char* two) const
 	{ return strcmp(one, two) == 0; }
@@ -1,23 +1,75 @@
 #ifndef UTIL_HPP_
 #define UTIL_HPP_
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
 /** \file
  * \brief Platform-agnostic utility functions */
 
+/** Game time, as a count of the logic's ticks. It is whole numbers so that a
+ *  clock runs down the same way on every compiler and machine. */
+typedef int32_t ticks_t;
+static const ticks_t SECOND = 100; ///< In ticks; main runs the logic at 100Hz
+
+/** A small, fast pseudo-random number generator (xoshiro256**). Each Game has
+ *  its own, so that a game is reproducible from its seed, and so that games
+ *  running side-by-side on different threads neither share nor fight over the
+ *  state. Not thread-safe: one per game, or per thread. */
+class Random {
+	uint64_t s[4];
+public:
+	/** Any seed is fine, including zero; it gets stirred first. */
+	explicit Random(uint64_t seed);
+	/** The next raw 64 bits. */
+	uint64_t next();
+	/** A fraction in [0, 1). */
+	double fraction();
+	/** As random_normal, but from this stream. */
+	int normal(int min, int max, double stddev);
+	/** As random_uniform, but from this stream. */
+	int uniform(int min, int max);
+};
+
+/** Draws one of up to MAX outcomes, in proportion to fixed weights, from among
+ *  those a mask allows, such as the events that could happen to a player.
+ *
+ *  The weights go into an alias table (Vose's method) when it's made, so a
+ *  draw over all of them is one column and one coin. With a mask, a draw that
+ *  lands on an allowed outcome stands; otherwise it is redrawn once, by weight,
+ *  from the allowed ones alone. Together, each allowed outcome comes up in
+ *  proportion to its weight, and a draw costs the same however many are
+ *  masked out. Immutable once made, so one can be shared between threads. */
+class Sampler {
+public:
+	static const int MAX = 32;
+	Sampler(const uint16_t weight[], int count);
+	/** An outcome whose bit is set in allowed, or -1 if there's none with
+	 *  any weight. */
+	int sample(Random& rng, uint32_t allowed) const;
+private:
+	int count;
+	uint32_t all; ///< Mask of every outcome
+	uint16_t weight[MAX];
+	double keep[MAX];   ///< Chance of column i's own outcome, else alias[i]
+	uint8_t alias[MAX];
+};
+
 /** Generate a random integer in the inclusive range given with probability
  *  given by the normal distribution with mean zero and standard deviation
- *  provided. In future, this could perhaps be implemented using C++ TR1's
- *  normal_distribution malarky in <random>, but at the time of writing that
- *  appears to be somewhat on the new side of stable and well-documented. */
+ *  provided. This, and random_uniform, draw from a default stream belonging to
+ *  the calling thread, seeded from platform_random() on first use; they are for
+ *  the UI and other cosmetics. The game itself uses Game::rng. */
 int random_normal(int min, int max, double stddev);
 
 /** Generate a random number in the inclusive range given with a uniform
- *  probability distribution. Again, C++ TR1 is a future possibility here.
+ *  probability distribution.
  *  IMPORTANT: unlike simplistic modulo-rand, max is a possible value! */
 int random_uniform(int min, int max);
 
+/** A seed for a new Random, drawn from the calling thread's default stream. */
+uint64_t random_seed();
+
 /** A functor that simply calls delete, for emptying vectors of pointers.
  *  Remember to clear() too. Amazing that STL doesn't contain such a beast.
  *  (Boost apparently does, as boost::lambda::delete_ptr().)
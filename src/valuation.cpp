@@ -0,0 +1,35 @@
+#include "valuation.hpp"
+
+static const int32_t LAND_VALUE = 500; ///< Per plot, before workers
+
+uint32_t Valuation::land(const Game& game, int player) {
+	return game.terrain.getPlots(player) * LAND_VALUE
+		+ game.terrain.getWorked(player) * game.prices.workers;
+}
+
+uint32_t Valuation::goods(const Game& game, int player) {
+	const Stock& stock = game.players[player].stock;
+	return stock.food    * game.prices.food
+	     + stock.energy  * game.prices.energy
+	     + stock.ore     * game.prices.ore
+	     + stock.crystal * game.prices.crystal;
+}
+
+uint32_t Valuation::score(const Game& game, int player) {
+	return game.players[player].money + land(game, player)
+		+ goods(game, player);
+}
+
+bool Valuation::consistent(const Game& game) {
+	Stock all;
+	all.food = all.energy = all.ore = all.crystal = all.workers = 1;
+	Stock working = all;
+	working.workers = 0;
+	for(int p = 0; p < PLAYERS; p++) {
+		if(countTilesOfType(game, p, all) != game.terrain.getPlots(p)
+		|| countTilesOfType(game, p, working)
+			!= game.terrain.getWorked(p)) { return false; }
+	}
+	return true;
+}
+
@@ -0,0 +1,29 @@
+#ifndef VALUATION_HPP_
+#define VALUATION_HPP_
+#include <stdint.h>
+#include "game.hpp"
+
+/** \file
+ * \brief What each player's holdings are worth, for scores and rankings */
+
+/** Values players' land and goods, as the scoreboard shows them.
+ *
+ * Land is worth a fixed amount a plot, plus the price of a worker for each
+ * one that is worked; the Terrain keeps count of both as plots change hands,
+ * so this never looks over the map. Goods are worth their stock at the store's
+ * prices, which is a handful of multiplications, so stock and prices can move
+ * as they like with nothing to keep up to date. Either way, a player's value
+ * is a few reads, cheap enough to ask for in every step of every rollout.
+ *
+ * consistent() works it all out again the slow way, for assertions. */
+namespace Valuation {
+	uint32_t land(const Game& game, int player);
+	uint32_t goods(const Game& game, int player);
+	/** Money, land and goods: the player's standing. */
+	uint32_t score(const Game& game, int player);
+	/** Do the kept counts agree with the map? */
+	bool consistent(const Game& game);
+}
+
+#endif
+
@@ -0,0 +1,547 @@
+/** \file
+ * \brief Renders a game to video frames, as fast as it will go
+ *
+ * This is its own programme, 'mewl-export', linked against everything except
+ * main.cpp. It plays a game between computer players from its seed, exactly as
+ * mewl-batch does, so any row of a batch's output can be turned into a
+ * highlight reel. There is no replay file; a seed, difficulty and the players'
+ * options are the whole replay.
+ *
+ * The user interface renders every frame off-screen, straight into one of a
+ * few buffers of ours (see FrameSink), with no waiting for the clock. Each
+ * buffer is then queued whole for a pool of encoder threads, which write it as
+ * a PNG or raw RGB file of its own, or add it to a YUV4MPEG2 stream. Encoders
+ * put frames into the stream in order, but convert them in any order, so the
+ * conversion is spread across them too. The renderer only waits when every
+ * buffer is queued or being encoded, so rendering and encoding overlap, and
+ * more encoder threads go faster until the renderer is the bottleneck.
+ *
+ * Experimental: the queue and encoders have been checked on frames made up
+ * for the purpose, but the whole path, with the user interface rendering off
+ * screen against a real SDL, and how it scales with encoder threads, are yet
+ * to be tried and measured. */
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include <zlib.h>
+#include "factory.hpp"
+#include "game.hpp"
+#include "gamelogic.hpp"
+#include "planner.hpp"
+#include "platform.hpp"
+#include "ui.hpp"
+
+/// Gives up on a game that hasn't ended after this many ticks, as a bug
+static const uint32_t max_ticks = 1000000;
+/// Of the final scoreboard, after the game has finished
+static const ticks_t hold_ticks = 3 * SECOND;
+
+static const char* const difficulty_names[] =
+	{ "beginner", "standard", "tournament" };
+static const char* const format_names[] = { "png", "raw", "y4m" };
+
+struct ExportOptions {
+	enum Format { PNG, RAW, Y4M };
+	uint64_t seed;
+	int difficulty;
+	bool mixed; ///< Random species, rather than all Mechtrons
+	PlayerSetup::Strategy strategies[PLAYERS];
+	uint32_t playouts; ///< Per search
+	Format format;
+	const char* output; ///< A file name pattern, or the stream's file
+	int threads; ///< Encoders
+	ticks_t step; ///< Ticks per frame
+};
+
+/* PNG ----------------------------------------------------------------------*/
+
+static void put32(std::vector<uint8_t>& out, uint32_t value) {
+	for(int shift = 24; shift >= 0; shift -= 8)
+		{ out.push_back(value >> shift); }
+}
+
+/** Append a chunk, whose data is already at the end of out, behind a gap of
+ *  eight bytes left for its length and type. */
+static void pngChunk(std::vector<uint8_t>& out, size_t start,
+	const char* type) {
+
+	const uint32_t length = out.size() - start - 8;
+	for(int i = 0; i < 4; i++) {
+		out[start + i] = length >> (24 - 8 * i);
+		out[start + 4 + i] = type[i];
+	}
+	put32(out, crc32(0, &out[start + 4], length + 4));
+}
+
+/** As RGB, each row Sub-filtered (as the difference from the pixel to its
+ *  left), which is cheap and compresses flat colour to almost nothing. The
+ *  compression is zlib's fastest; these are a step on the way to a video. */
+static bool encodePng(const uint32_t* frame, uint16_t width, uint16_t height,
+	std::vector<uint8_t>& rows, std::vector<uint8_t>& out) {
+
+	static const uint8_t signature[8] =
+		{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	rows.resize((1 + width * 3) * height);
+	uint8_t* row = &rows[0];
+	for(int y = 0; y < height; y++) {
+		*row++ = 1; // Sub
+		uint32_t left = 0;
+		for(int x = 0; x < width; x++) {
+			const uint32_t pixel = frame[y * width + x];
+			*row++ = (pixel >> 16) - (left >> 16);
+			*row++ = (pixel >> 8) - (left >> 8);
+			*row++ = pixel - left;
+			left = pixel;
+		}
+	}
+	out.assign(signature, signature + sizeof(signature));
+	size_t start = out.size();
+	out.resize(start + 8);
+	put32(out, width);
+	put32(out, height);
+	const uint8_t header[5] = { 8, 2, 0, 0, 0 }; // 8-bit RGB, no interlace
+	out.insert(out.end(), header, header + sizeof(header));
+	pngChunk(out, start, "IHDR");
+	start = out.size();
+	uLongf packed = compressBound(rows.size());
+	out.resize(start + 8 + packed);
+	if(compress2(&out[start + 8], &packed, &rows[0], rows.size(),
+		Z_BEST_SPEED) != Z_OK) { return false; }
+	out.resize(start + 8 + packed);
+	pngChunk(out, start, "IDAT");
+	start = out.size();
+	out.resize(start + 8);
+	pngChunk(out, start, "IEND");
+	return true;
+}
+
+/* Raw and YUV4MPEG2 --------------------------------------------------------*/
+
+static void encodeRaw(const uint32_t* frame, uint16_t width, uint16_t height,
+	std::vector<uint8_t>& out) {
+
+	out.resize(width * height * 3);
+	uint8_t* rgb = &out[0];
+	for(int i = 0; i < width * height; i++) {
+		*rgb++ = frame[i] >> 16;
+		*rgb++ = frame[i] >> 8;
+		*rgb++ = frame[i];
+	}
+}
+
+/** A FRAME of 4:2:0 YCbCr, in BT.601's studio range, each chroma sample from
+ *  the average of its four pixels. Needs an even width and height. */
+static void encodeY4m(const uint32_t* frame, uint16_t width, uint16_t height,
+	std::vector<uint8_t>& out) {
+
+	static const char marker[] = "FRAME\n";
+	const size_t luma = width * height;
+	out.resize(sizeof(marker) - 1 + luma * 3 / 2);
+	memcpy(&out[0], marker, sizeof(marker) - 1);
+	uint8_t* y = &out[sizeof(marker) - 1];
+	uint8_t* cb = y + luma;
+	uint8_t* cr = cb + luma / 4;
+	for(size_t i = 0; i < luma; i++) {
+		const int r = (frame[i] >> 16) & 0xff;
+		const int g = (frame[i] >> 8) & 0xff;
+		const int b = frame[i] & 0xff;
+		y[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+	}
+	for(int row = 0; row < height; row += 2) {
+		for(int col = 0; col < width; col += 2) {
+			int r = 0, g = 0, b = 0;
+			for(int i = 0; i < 4; i++) {
+				const uint32_t pixel = frame[(row + i / 2)
+					* width + col + i % 2];
+				r += (pixel >> 16) & 0xff;
+				g += (pixel >> 8) & 0xff;
+				b += pixel & 0xff;
+			}
+			r /= 4; g /= 4; b /= 4;
+			*cb++ = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+			*cr++ = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+		}
+	}
+}
+
+/* The queue ----------------------------------------------------------------*/
+
+/** The buffers frames are rendered in, and the encoders they are queued for.
+ *
+ *  There are two more buffers than encoders: one for each encoder to work
+ *  on, one being rendered in, and one queued, so that an encoder finishing
+ *  has another frame to start on straight away. A frame is encoded into the
+ *  encoder's own memory, and its buffer freed, before it is written, so a
+ *  slow disk or pipe holds up the writing but not the rendering. */
+class FrameQueue : public FrameSink {
+	struct Job {
+		uint32_t* frame;
+		uint32_t number;
+	};
+	const ExportOptions& options;
+	uint16_t width, height;
+	std::vector<uint32_t*> buffers;
+	std::vector<uint32_t*> idle; ///< Free for acquire()
+	std::deque<Job> queued;
+	uint32_t submitted;
+	uint32_t written; ///< To the stream, which takes them in order
+	bool closing; ///< No more frames are coming
+	bool failed;
+	FILE* stream; ///< If writing YUV4MPEG2
+	std::vector<std::thread> encoders;
+	std::mutex lock; ///< Guards idle to stream
+	std::condition_variable changed; ///< Signalled on any change to those
+
+	void encoderMain();
+	bool write(const Job& job, const std::vector<uint8_t>& out);
+	FrameQueue(const FrameQueue&);
+	FrameQueue& operator=(const FrameQueue&);
+public:
+	FrameQueue(const ExportOptions& options);
+	~FrameQueue();
+	bool open(uint16_t width, uint16_t height);
+	uint32_t* acquire();
+	void submit(uint32_t* frame);
+	/** Wait for every frame to be written, and return whether they all
+	 *  were. No more may be submitted. */
+	bool finish();
+};
+
+FrameQueue::FrameQueue(const ExportOptions& options) : options(options),
+	width(0), height(0), submitted(0), written(0), closing(false),
+	failed(false), stream(NULL) {}
+
+FrameQueue::~FrameQueue() {
+	finish();
+	for(size_t b = 0; b < buffers.size(); b++) { delete[] buffers[b]; }
+	if(stream && stream != stdout) { fclose(stream); }
+}
+
+bool FrameQueue::open(uint16_t width, uint16_t height) {
+	this->width = width;
+	this->height = height;
+	if(options.format == ExportOptions::Y4M) {
+		stream = strcmp(options.output, "-")
+			? fopen(options.output, "wb") : stdout;
+		if(!stream) {
+			warn("Unable to write %s", options.output);
+			return false;
+		}
+		fprintf(stream, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg\n",
+			width, height, SECOND, options.step);
+	}
+	for(int b = 0; b < options.threads + 2; b++) {
+		buffers.push_back(new uint32_t[width * height]);
+		idle.push_back(buffers.back());
+	}
+	for(int e = 0; e < options.threads; e++)
+		{ encoders.push_back(std::thread(&FrameQueue::encoderMain,
+			this)); }
+	return true;
+}
+
+uint32_t* FrameQueue::acquire() {
+	std::unique_lock<std::mutex> guard(lock);
+	while(idle.empty()) { changed.wait(guard); }
+	uint32_t* frame = idle.back();
+	idle.pop_back();
+	return frame;
+}
+
+void FrameQueue::submit(uint32_t* frame) {
+	std::lock_guard<std::mutex> guard(lock);
+	Job job = { frame, submitted++ };
+	queued.push_back(job);
+	changed.notify_all();
+}
+
+bool FrameQueue::finish() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closing = true;
+		changed.notify_all();
+	}
+	for(size_t e = 0; e < encoders.size(); e++) { encoders[e].join(); }
+	encoders.clear();
+	if(stream && fflush(stream) != 0) { failed = true; }
+	return !failed;
+}
+
+void FrameQueue::encoderMain() {
+	std::vector<uint8_t> scratch, out;
+	std::unique_lock<std::mutex> guard(lock);
+	for(;;) {
+		while(queued.empty() && !closing) { changed.wait(guard); }
+		if(queued.empty()) { return; }
+		const Job job = queued.front();
+		queued.pop_front();
+		guard.unlock();
+
+		bool ok = true;
+		switch(options.format) {
+			case ExportOptions::PNG:
+				ok = encodePng(job.frame, width, height,
+					scratch, out);
+				break;
+			case ExportOptions::RAW:
+				encodeRaw(job.frame, width, height, out);
+				break;
+			case ExportOptions::Y4M:
+				encodeY4m(job.frame, width, height, out);
+				break;
+		}
+		guard.lock();
+		idle.push_back(job.frame);
+		changed.notify_all();
+		// The stream takes frames in order, so wait our turn
+		while(stream && written != job.number) { changed.wait(guard); }
+		guard.unlock();
+
+		ok = ok && write(job, out);
+		guard.lock();
+		if(!ok) { failed = true; }
+		if(stream) { written++; changed.notify_all(); }
+	}
+}
+
+bool FrameQueue::write(const Job& job, const std::vector<uint8_t>& out) {
+	if(stream) { return fwrite(&out[0], out.size(), 1, stream) == 1; }
+	char name[1024];
+	snprintf(name, sizeof(name), options.output, job.number);
+	FILE* file = fopen(name, "wb");
+	if(!file) { warn("Unable to write %s", name); return false; }
+	bool ok = fwrite(&out[0], out.size(), 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+	if(!ok) { warn("Unable to finish writing %s", name); }
+	return ok;
+}
+
+/* The game -----------------------------------------------------------------*/
+
+/** Play the game through, rendering a frame every step ticks, and then hold
+ *  the final scoreboard for a moment. Returns how many frames there were.
+ *  The setup must be made exactly as mewl-batch's play() makes it. */
+static uint32_t play(const ExportOptions& options, UserInterface* ui) {
+	Random rng(options.seed);
+	GameSetup setup;
+	setup.difficulty = static_cast<Difficulty::Type>(options.difficulty);
+	for(int p = 0; p < PLAYERS; p++) {
+		setup.playersetup[p].computerPlayer();
+		setup.playersetup[p].strategy = options.strategies[p];
+		setup.playersetup[p].species = options.mixed
+			? static_cast<Species::Type>(rng.uniform(
+				Species::FIRST, Species::LAST))
+			: Species::COMPUTER;
+	}
+
+	Game* game = new Game(setup, rng.next());
+	GameStageState state;
+	Planner planner(0, 0, options.playouts, NULL);
+	GameLogicJumps jumps(&game, ui, NULL, &planner);
+	GameLogic* logic = GameLogic::getNewGameState(&jumps, state);
+	bool transitionok = true;
+	uint32_t ticks = 0, frames = 0;
+	ticks_t held = 0;
+	while(held < hold_ticks && ticks < max_ticks) {
+		// As main's loop, but the clock is ours
+		for(ticks_t t = 0; t < options.step; t++, ticks++) {
+			if(jumps.isFinished()) { held++; continue; }
+			if(!transitionok) { continue; }
+			GameLogic* next = logic->simulate(setup, game);
+			if(next) {
+				delete logic;
+				logic = next;
+				transitionok = false;
+			}
+		}
+		ui->anticipate(logic->predictNextStages(setup));
+		transitionok = ui->render(logic->getStage(), setup, game,
+			state, options.step);
+		frames++;
+	}
+	if(!jumps.isFinished()) {
+		warn("Game (seed %llu) never finished",
+			(unsigned long long) options.seed);
+	}
+	delete logic;
+	delete game;
+	return frames;
+}
+
+/** A file name pattern needs one number in it, and nothing else for printf. */
+static bool isPattern(const char* pattern) {
+	int numbers = 0;
+	for(const char* c = pattern; *c; c++) {
+		if(*c != '%') { continue; }
+		if(*++c == '%') { continue; }
+		while(*c >= '0' && *c <= '9') { c++; }
+		if(*c != 'u') { return false; }
+		numbers++;
+	}
+	return numbers == 1;
+}
+
+int main(int argc, char** argv) {
+	ExportOptions options;
+	options.seed = 0;
+	options.difficulty = Difficulty::STANDARD;
+	options.mixed = true;
+	for(int p = 0; p < PLAYERS; p++)
+		{ options.strategies[p] = PlayerSetup::RULES; }
+	options.playouts = 64;
+	options.format = ExportOptions::PNG;
+	options.output = NULL;
+	options.threads = std::thread::hardware_concurrency() - 1;
+	options.step = 4;
+	bool seeded = false;
+	for(int a = 1; a < argc; a++) {
+		const char* arg = argv[a];
+		if(!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+			puts("mewl-export is experimental; "
+				"expect rough edges.\n");
+			puts("Usage: mewl-export -s SEED [-d DIFFICULTY] "
+				"[-m MIX] [-a AIS] [-p PLAYOUTS]\n"
+				"                   [-f FORMAT] [-o OUTPUT] "
+				"[-j THREADS] [-r TICKS]\n");
+			puts("  -s --seed       : the game's, as in "
+				"mewl-batch's output");
+			puts("  -d --difficulty : beginner, standard "
+				"(default) or tournament");
+			puts("  -m --mix        : species, 'random' (default) "
+				"or 'computer' for all Mechtrons");
+			puts("  -a --ai         : each seat's strategy, 'r' "
+				"for rules or 's' for search");
+			puts("                    (default rrrr)");
+			puts("  -p --playouts   : per search decision "
+				"(default 64)");
+			puts("  -f --format     : png (default), raw (RGB) "
+				"or y4m (YUV4MPEG2)");
+			puts("  -o --output     : for png and raw, a file name "
+				"with one %u for the frame");
+			puts("                    number (default "
+				"frame%06u.png or .rgb); for y4m,");
+			puts("                    a file, or - for stdout "
+				"(default)");
+			puts("  -j --threads    : encoders (default one per "
+				"processor, less one)");
+			puts("  -r --rate       : ticks per frame (default 4, "
+				"for 25 frames a second)");
+			return 0;
+		} else if(a + 1 >= argc) {
+			warn("Unknown or incomplete option %s", arg);
+			return EXIT_FAILURE;
+		} else if(!strcmp(arg, "-s") || !strcmp(arg, "--seed")) {
+			options.seed = strtoull(argv[++a], NULL, 0);
+			seeded = true;
+		} else if(!strcmp(arg, "-d") || !strcmp(arg, "--difficulty")) {
+			const char* name = argv[++a];
+			options.difficulty = -1;
+			for(int d = Difficulty::FIRST; d <= Difficulty::LAST;
+				d++) {
+
+				if(!strcmp(name, difficulty_names[d]))
+					{ options.difficulty = d; }
+			}
+			if(options.difficulty == -1) {
+				warn("Unknown difficulty %s", name);
+				return EXIT_FAILURE;
+			}
+		} else if(!strcmp(arg, "-m") || !strcmp(arg, "--mix")) {
+			const char* mix = argv[++a];
+			if(!strcmp(mix, "random")) { options.mixed = true; }
+			else if(!strcmp(mix, "computer"))
+				{ options.mixed = false; }
+			else {
+				warn("Unknown mix %s", mix);
+				return EXIT_FAILURE;
+			}
+		} else if(!strcmp(arg, "-a") || !strcmp(arg, "--ai")) {
+			const char* ais = argv[++a];
+			if(strspn(ais, "rs") != PLAYERS || ais[PLAYERS]) {
+				warn("Need %d of 'r' or 's', not %s", PLAYERS,
+					ais);
+				return EXIT_FAILURE;
+			}
+			for(int p = 0; p < PLAYERS; p++) {
+				options.strategies[p] = ais[p] == 's'
+					? PlayerSetup::SEARCH
+					: PlayerSetup::RULES;
+			}
+		} else if(!strcmp(arg, "-p") || !strcmp(arg, "--playouts")) {
+			options.playouts = atoi(argv[++a]);
+			if(!options.playouts) {
+				warn("Need at least one playout");
+				return EXIT_FAILURE;
+			}
+		} else if(!strcmp(arg, "-f") || !strcmp(arg, "--format")) {
+			const char* name = argv[++a];
+			int f;
+			for(f = ExportOptions::PNG; f <= ExportOptions::Y4M;
+				f++) {
+
+				if(!strcmp(name, format_names[f])) { break; }
+			}
+			if(f > ExportOptions::Y4M) {
+				warn("Unknown format %s", name);
+				return EXIT_FAILURE;
+			}
+			options.format = static_cast<ExportOptions::Format>(f);
+		} else if(!strcmp(arg, "-o") || !strcmp(arg, "--output")) {
+			options.output = argv[++a];
+		} else if(!strcmp(arg, "-j") || !strcmp(arg, "--threads")) {
+			options.threads = atoi(argv[++a]);
+		} else if(!strcmp(arg, "-r") || !strcmp(arg, "--rate")) {
+			options.step = atoi(argv[++a]);
+			if(!options.step) {
+				warn("Need at least one tick per frame");
+				return EXIT_FAILURE;
+			}
+		} else {
+			warn("Unknown option %s", arg);
+			return EXIT_FAILURE;
+		}
+	}
+	if(!seeded) {
+		warn("Which game? Give its seed with -s (see mewl-batch)");
+		return EXIT_FAILURE;
+	}
+	if(!options.output) {
+		options.output = options.format == ExportOptions::PNG
+			? "frame%06u.png" : options.format == ExportOptions::RAW
+			? "frame%06u.rgb" : "-";
+	} else if(options.format != ExportOptions::Y4M
+		&& !isPattern(options.output)) {
+		warn("%s needs one %%u in it, for the frame number",
+			options.output);
+		return EXIT_FAILURE;
+	}
+	if(options.threads < 1) { options.threads = 1; }
+
+	platform_init();
+	// For the renderer pool's thread; there is no video or audio
+	if(SDL_Init(0) < 0)
+		{ warn("Unable to initialise SDL: %s", SDL_GetError()); die(); }
+	UserInterface* ui =
+		FACTORY_FOR(UserInterface).create("UserInterface" USERINTF);
+	FrameQueue queue(options);
+	if(!ui || !ui->initOffscreen(queue)) {
+		warn("Unable to initialise user interface off-screen");
+		delete ui; SDL_Quit(); die();
+	}
+
+	uint64_t start = platform_microseconds();
+	uint32_t frames = play(options, ui);
+	int status = queue.finish() ? EXIT_SUCCESS : EXIT_FAILURE;
+	double seconds = (platform_microseconds() - start) / 1e6;
+	warn("%u frames with %d encoders in %.2fs (%.0f frames/s)", frames,
+		options.threads, seconds, seconds > 0 ? frames / seconds : 0);
+	delete ui;
+	SDL_Quit();
+	return status;
+}
@@ -0,0 +1,107 @@
+#include "workpool.hpp"
+
+static int workersFor(int workers) {
+	if(workers <= 0) { workers = std::thread::hardware_concurrency(); }
+	if(workers <= 0) { workers = 1; } // Couldn't tell; be safe
+	return workers;
+}
+
+WorkPool::WorkPool(int workers) : ranges(workersFor(workers)),
+	generation(0), idle(0), quit(false) {
+
+	for(size_t w = 0; w < ranges.size(); w++)
+		{ ranges[w].begin = ranges[w].end = 0; }
+	// Worker zero is whoever calls run()
+	for(int w = 1; w < size(); w++)
+		{ threads.emplace_back(&WorkPool::threadMain, this, w); }
+}
+
+WorkPool::~WorkPool() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = true;
+		start.notify_all();
+	}
+	for(size_t t = 0; t < threads.size(); t++) { threads[t].join(); }
+}
+
+int WorkPool::size() const { return ranges.size(); }
+
+bool WorkPool::take(int worker, int& index) {
+	Range& range = ranges[worker];
+	std::lock_guard<std::mutex> guard(range.lock);
+	bool got = range.begin < range.end;
+	if(got) { index = range.begin++; }
+	return got;
+}
+
+bool WorkPool::steal(int worker) {
+	const int workers = ranges.size();
+	for(int i = 1; i < workers; i++) {
+		Range& victim = ranges[(worker + i) % workers];
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> guard(victim.lock);
+			int left = victim.end - victim.begin;
+			if(left <= 0) { continue; }
+			// Round up, so that the last job left can be stolen too
+			end = victim.end;
+			victim.end -= (left + 1) / 2;
+			begin = victim.end;
+		}
+		// Ours is empty, and only we refill it, so no race here
+		Range& range = ranges[worker];
+		std::lock_guard<std::mutex> guard(range.lock);
+		range.begin = begin;
+		range.end = end;
+		return true;
+	}
+	return false;
+}
+
+void WorkPool::work(int worker) {
+	int index;
+	do {
+		while(take(worker, index)) { job(index, worker); }
+	} while(steal(worker));
+	/* Nothing left anywhere. Others may still be busy, but only with jobs
+	 * they've already taken; they'll come here themselves when done. */
+	std::lock_guard<std::mutex> guard(lock);
+	idle++;
+	done.notify_one();
+}
+
+void WorkPool::threadMain(int worker) {
+	unsigned seen = 0;
+	std::unique_lock<std::mutex> guard(lock);
+	while(!quit) {
+		if(generation == seen) {
+			start.wait(guard);
+			continue;
+		}
+		seen = generation;
+		guard.unlock();
+		work(worker);
+		guard.lock();
+	}
+}
+
+void WorkPool::run(int count, const job_t& job) {
+	const int workers = ranges.size();
+	/* Workers are all waiting for the next generation, so nobody else is
+	 * looking at the ranges until we broadcast. */
+	for(int w = 0; w < workers; w++) {
+		ranges[w].begin = (int64_t) count *  w      / workers;
+		ranges[w].end   = (int64_t) count * (w + 1) / workers;
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		this->job = job;
+		idle = 0;
+		generation++;
+		start.notify_all();
+	}
+	work(0);
+	std::unique_lock<std::mutex> guard(lock);
+	while(idle < workers) { done.wait(guard); }
+}
@@ -0,0 +1,61 @@
+#ifndef WORKPOOL_HPP_
+#define WORKPOOL_HPP_
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** \file
+ * \brief Work-stealing thread pool for batches of independent jobs */
+
+/** Runs numbered jobs across a fixed set of worker threads.
+ *
+ * Each run() deals the job numbers out as one contiguous range per worker.
+ * Workers take from the front of their own range; one which runs dry steals
+ * the back half of whichever other range it finds first. Whole games vary a
+ * lot in length, so this keeps every core busy to the end without a shared
+ * queue for them all to fight over.
+ *
+ * The calling thread is worker zero, so a pool of one is plain serial code.
+ * run() is not reentrant, and is for one thread (the pool's owner) at a time;
+ * jobs must not throw. The threads are the standard library's, not SDL's, so
+ * that the learning environment library, which has no SDL, can use it too. */
+class WorkPool {
+public:
+	/** A job; given its number, and which worker (0 to size()-1) it's on,
+	 *  for indexing per-worker scratch space. */
+	typedef std::function<void(int index, int worker)> job_t;
+private:
+	/// A worker's share of the current run: [begin, end)
+	struct Range {
+		std::mutex lock;
+		int begin;
+		int end;
+	};
+	std::vector<Range> ranges;
+	std::vector<std::thread> threads;
+	job_t job;
+	unsigned generation; ///< Bumped for each run()
+	int idle; ///< Workers which have run out during this run()
+	bool quit;
+	std::mutex lock; ///< Guards everything not in a Range
+	std::condition_variable start; ///< Signalled for a new run, or to quit
+	std::condition_variable done; ///< Signalled when a worker runs out
+
+	bool take(int worker, int& index);
+	bool steal(int worker);
+	void work(int worker);
+	void threadMain(int worker);
+public:
+	/** Zero or fewer workers means one per processor. */
+	explicit WorkPool(int workers);
+	~WorkPool();
+	int size() const;
+	/** Run job for every index from 0 to count-1, returning when all are
+	 *  done. */
+	void run(int count, const job_t& job);
+};
+
+#endif
+
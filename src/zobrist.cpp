@@ -0,0 +1,93 @@
+#include "zobrist.hpp"
+#include "stagefields.hpp"
+
+/// Kinds of thing with keys, so that no two things share one
+enum Thing { PLOT, MOUNTAINS, CRYSTAL, MONEY, STOCK, STORE, PRICES, GAME,
+	STAGE, FIELD };
+
+/** splitmix64's finaliser: every bit in stirs every bit out. */
+static uint64_t mix(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+/** The key for the value of the which'th of a kind of thing. */
+static uint64_t key(Thing thing, uint32_t which, uint32_t value) {
+	if(!value) { return 0; }
+	return mix(((uint64_t) thing << 56) ^ ((uint64_t) which << 32)
+		^ value);
+}
+
+static uint64_t stock(Thing thing, int which, const Stock& stock) {
+	uint64_t hash = 0;
+	for(int r = Resource::NONE; r <= Resource::CRYSTAL; r++) {
+		hash ^= key(thing, which * (Resource::CRYSTAL + 1) + r,
+			stock[static_cast<Resource::Type>(r)]);
+	}
+	return hash;
+}
+
+uint64_t Zobrist::plot(int index, const Tile& tile) {
+	if(!tile.owned()) { return 0; }
+	return key(PLOT, index,
+		1 + tile.owner() * (Resource::CRYSTAL + 1) + tile.equipment());
+}
+
+uint64_t Zobrist::mountains(int index, uint8_t mountains)
+	{ return key(MOUNTAINS, index, mountains); }
+
+uint64_t Zobrist::crystal(int index, uint8_t crystal)
+	{ return key(CRYSTAL, index, crystal); }
+
+uint64_t Zobrist::terrain(const Terrain& terrain) {
+	uint64_t hash = 0;
+	for(uint8_t y = 0; y < terrain.getSizeY(); y++) {
+		for(uint8_t x = 0; x < terrain.getSizeX(); x++) {
+			const Tile& tile = terrain.tile(x, y);
+			const int index = x + y * terrain.getSizeX();
+			hash ^= plot(index, tile)
+				^ mountains(index, tile.mountains())
+				^ crystal(index, tile.crystal());
+		}
+	}
+	return hash;
+}
+
+uint64_t Zobrist::game(const Game& game) {
+	uint64_t hash = game.terrain.getHash();
+	for(int p = 0; p < PLAYERS; p++) {
+		hash ^= key(MONEY, p, game.players[p].money)
+			^ stock(STOCK, p, game.players[p].stock)
+			^ key(GAME, 2 + p, 1 + game.turnorder[p]);
+	}
+	return hash ^ stock(STORE, 0, game.store)
+		^ stock(PRICES, 0, game.prices)
+		^ key(GAME, 0, game.month)
+		^ key(GAME, 1, game.playerevents);
+}
+
+/** Hashes the fields of a stage's state, numbering them as they come. */
+class Fields {
+	uint64_t hash;
+	uint32_t count;
+public:
+	Fields() : hash(0), count(0) {}
+	template <typename T> void operator()(const T& value)
+		{ hash ^= key(FIELD, count++, (uint32_t) value); }
+	uint64_t get() const { return hash; }
+};
+
+uint64_t Zobrist::stage(GameStage::Type stage, const GameStageState& state) {
+	Fields fields;
+	StageFields::walk(stage, state, fields);
+	return fields.get() ^ key(STAGE, 0, 1 + stage);
+}
+
+uint64_t Zobrist::hash(const Game& game, GameStage::Type stage,
+	const GameStageState& state) {
+
+	return Zobrist::game(game) ^ Zobrist::stage(stage, state);
+}
+
@@ -0,0 +1,46 @@
+#ifndef ZOBRIST_HPP_
+#define ZOBRIST_HPP_
+#include <stdint.h>
+#include "game.hpp"
+
+/** \file
+ * \brief Hashes of the whole logical state, to spot repeats and divergence */
+
+/** 64-bit Zobrist hashes of a game and the state of the stage it is at.
+ *
+ * Every (thing, value) pair has its own random-looking key, and a state's
+ * hash is the XOR of the keys of everything in it, so a change is an XOR out
+ * of the old key and in of the new one. The map, which is most of a game, is
+ * kept hashed this way by the Terrain as each plot changes, so costs nothing
+ * to read. The rest (the players' money and stock, the store, its prices, the
+ * month, and the stage's state) is a few dozen numbers, which are mixed in
+ * afresh each time; they change all over the logic, and so many times a tick
+ * in an auction, that keeping them up to date would cost more than it saves.
+ *
+ * Keys are worked out from the thing and value by a mixing function rather
+ * than looked up, so there is no table to set up or share, and hashes match
+ * across builds and machines. A thing at zero (an empty plot, a flat one) has
+ * a zero key, so a blank map hashes to zero.
+ *
+ * Equal hashes mean, all but certainly, equal games: searches can use them to
+ * key transpositions, and two runs which should be in lockstep can compare
+ * them each tick, to find the very tick on which they parted. */
+namespace Zobrist {
+	/** A plot's ownership, as its owner and what it's outfitted for. */
+	uint64_t plot(int index, const Tile& tile);
+	uint64_t mountains(int index, uint8_t mountains);
+	uint64_t crystal(int index, uint8_t crystal);
+
+	/** The map's, worked out from scratch; what the Terrain keeps. */
+	uint64_t terrain(const Terrain& terrain);
+	/** The game's, with its map's kept hash. */
+	uint64_t game(const Game& game);
+	/** What's in the state that the stage uses, and the stage itself. */
+	uint64_t stage(GameStage::Type stage, const GameStageState& state);
+	/** All of it: what to compare tick by tick. */
+	uint64_t hash(const Game& game, GameStage::Type stage,
+		const GameStageState& state);
+}
+
+#endif
+